@@ -6,11 +6,13 @@
 #include <unistd.h>
 #include <sys/uio.h>
 #include <vector>
-#include <atomic>
 #include <assert.h>
+#include "Buffer/bufferpool.hpp"
 // 这个Buffer类就是将char存放在了vector中，这样可以方便地实现原地扩容
 // 但是在具体使用时，是配合read和write的index和首个char字符的地址得到char*来使用的
 // 可以说结合了vector和传统数组的用法
+// initBuffSize为0时，Buffer在需要写入时才从BufferPool取一块，数据取完就还回去
+// Buffer同一时刻只会被一个线程使用，读写下标都是普通变量；需要跨线程使用时用SyncBuffer
 class Buffer {
 public:
     Buffer(int initBuffSize = 1024);
@@ -41,16 +43,22 @@ public:
     ssize_t ReadFd(int fd, int* Errno);
     ssize_t WriteFd(int fd, int* Errno);
 
-    void show();
+    void Release();
+
+    void Adopt(std::vector<char> &&chunk, size_t readPos, size_t writePos);
+
+    size_t Capacity() const { return buffer_.size(); }
 
 private:
     char* BeginPtr_();
     const char* BeginPtr_() const;
     void MakeSpace_(size_t len);
+    void Attach_();
 
+    bool pooled_;
     std::vector<char> buffer_;
-    std::atomic<std::size_t> readPos_;
-    std::atomic<std::size_t> writePos_;
+    std::size_t readPos_;
+    std::size_t writePos_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <vector>
+#include <mutex>
+#include <assert.h>
+
+/*
+固定大小的缓冲块池，所有连接共享
+Buffer在真正需要读写时才从池中取出一块，数据取完之后就还回来，
+这样空闲的长连接不会占着缓冲区
+只有大小等于CHUNK_SIZE的块才会回收，扩容过的块直接释放
+*/
+class BufferPool {
+public:
+    static constexpr size_t CHUNK_SIZE = 4096;
+
+    static BufferPool *Instance();
+
+    std::vector<char> Acquire();
+
+    void AcquireBatch(size_t n, std::vector<std::vector<char>> &out);
+
+    void Release(std::vector<char> &&chunk);
+
+    void ReleaseBatch(std::vector<std::vector<char>> &chunks);
+
+    void SetMaxFree(size_t maxFree);
+
+    size_t FreeCount();
+
+private:
+    BufferPool() : maxFree_(4096) {}
+    ~BufferPool() = default;
+
+    size_t maxFree_;
+    std::vector<std::vector<char>> free_;
+    std::mutex mtx_;
+};
+
+#endif // BUFFER_POOL_H
@@ -0,0 +1,80 @@
+#ifndef CHAIN_BUFFER_H
+#define CHAIN_BUFFER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <assert.h>
+#include "Buffer/buffer.hpp"
+#include "Buffer/bufferpool.hpp"
+
+/*
+由多个缓冲块组成的链式Buffer，数据不要求连续
+1. ReadFd用readv直接读到缓冲块里，不经过栈上的临时缓冲，大数据只拷贝一次
+2. WriteFd用writev一次写出整条链
+3. Splice把另一条链的缓冲块直接挂到当前链的末尾，不拷贝数据
+4. MoveInto把数据交给连续的Buffer，只有一个块时直接交出缓冲块
+5. AppendString直接接管一个较大的string作为一块，不拷贝（比如kv的value）
+6. Find/Substr跨块查找和取出数据，解析请求时不需要先把数据拼成连续的
+缓冲块都来自BufferPool，用完就还回去；每个线程留一批空闲块，用完了才向池里批量取，反复读写时不用加锁
+*/
+class ChainBuffer {
+public:
+    static constexpr int MAX_IOV = 16;
+    // 比这个短的string直接拷贝，不单独占一块
+    static constexpr size_t MIN_ADOPT = 256;
+    static constexpr size_t npos = std::string::npos;
+
+    ChainBuffer() : readable_(0) {}
+    ~ChainBuffer();
+
+    ChainBuffer(const ChainBuffer &) = delete;
+    ChainBuffer &operator=(const ChainBuffer &) = delete;
+
+    size_t ReadableBytes() const { return readable_; }
+    size_t BlockCount() const { return blocks_.size(); }
+
+    void Append(const char *data, size_t len);
+    void Append(const std::string &str);
+    void AppendBlock(std::vector<char> &&block, size_t len);
+    void AppendString(std::string &&str);
+
+    void Splice(ChainBuffer &other);
+
+    void Retrieve(size_t len);
+    void RetrieveAll();
+    std::string RetrieveAllToStr();
+
+    void MoveInto(Buffer &buff);
+
+    size_t Find(const char *pattern, size_t len, size_t from = 0) const;
+    std::string Substr(size_t offset, size_t len) const;
+
+    int ExportIov(struct iovec *iov, int maxIov) const;
+
+    ssize_t ReadFd(int fd, int *saveErrno);
+    ssize_t WriteFd(int fd, int *saveErrno);
+
+private:
+    struct Block {
+        std::vector<char> data; // 来自BufferPool的缓冲块
+        std::string str;        // AppendString接管的字符串，这时data为空
+        size_t readPos;
+        size_t writePos;
+
+        char *Base() { return data.empty() ? &str[0] : data.data(); }
+        const char *Base() const { return data.empty() ? str.data() : data.data(); }
+        // 还能写入的空间，接管的字符串不再写入
+        size_t Room() const { return data.empty() ? 0 : data.size() - writePos; }
+    };
+
+    void PopFront_();
+    bool MatchAt_(size_t block, size_t pos, const char *pattern, size_t len) const;
+
+    std::deque<Block> blocks_;
+    size_t readable_;
+};
+
+#endif // CHAIN_BUFFER_H
@@ -0,0 +1,75 @@
+#ifndef SYNC_BUFFER_H
+#define SYNC_BUFFER_H
+
+#include <mutex>
+#include <string>
+#include <string.h>
+#include "Buffer/buffer.hpp"
+
+/*
+带锁的Buffer，用于真正需要跨线程读写的地方（比如多个线程写，一个线程读出来）
+每个操作都在锁内完成，不暴露内部指针，连接上的读写仍然使用不加锁的Buffer
+*/
+class SyncBuffer {
+public:
+    explicit SyncBuffer(int initBuffSize = 1024) : buff_(initBuffSize) {}
+    ~SyncBuffer() = default;
+
+    size_t ReadableBytes() {
+        std::lock_guard<std::mutex> locker(mtx_);
+        return buff_.ReadableBytes();
+    }
+
+    void Append(const char *str, size_t len) {
+        std::lock_guard<std::mutex> locker(mtx_);
+        buff_.Append(str, len);
+    }
+
+    void Append(const std::string &str) { Append(str.data(), str.size()); }
+
+    // 追加之后如果超过maxBytes，就从头部按整行丢弃，直到不超过maxBytes
+    void AppendBounded(const char *str, size_t len, size_t maxBytes) {
+        std::lock_guard<std::mutex> locker(mtx_);
+        buff_.Append(str, len);
+        size_t readable = buff_.ReadableBytes();
+        if (readable <= maxBytes) {
+            return;
+        }
+        const char *begin = buff_.Peek();
+        const char *cut = begin + (readable - maxBytes);
+        const char *eol = static_cast<const char *>(memchr(cut, '\n', begin + readable - cut));
+        buff_.Retrieve(eol ? eol - begin + 1 : readable);
+    }
+
+    std::string RetrieveAllToStr() {
+        std::lock_guard<std::mutex> locker(mtx_);
+        return buff_.RetrieveAllToStr();
+    }
+
+    // 拷贝出全部可读数据，不移动读指针
+    std::string PeekAllToStr() {
+        std::lock_guard<std::mutex> locker(mtx_);
+        return std::string(buff_.Peek(), buff_.ReadableBytes());
+    }
+
+    void Retrieve(size_t len) {
+        std::lock_guard<std::mutex> locker(mtx_);
+        buff_.Retrieve(len);
+    }
+
+    void RetrieveAll() {
+        std::lock_guard<std::mutex> locker(mtx_);
+        buff_.RetrieveAll();
+    }
+
+    ssize_t WriteFd(int fd, int *saveErrno) {
+        std::lock_guard<std::mutex> locker(mtx_);
+        return buff_.WriteFd(fd, saveErrno);
+    }
+
+private:
+    Buffer buff_;
+    std::mutex mtx_;
+};
+
+#endif // SYNC_BUFFER_H
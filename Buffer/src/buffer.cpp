@@ -1,6 +1,7 @@
 #include "Buffer/buffer.hpp"
 
-Buffer::Buffer(int initBuffSize) : buffer_(initBuffSize), readPos_(0), writePos_(0) {}
+Buffer::Buffer(int initBuffSize)
+    : pooled_(initBuffSize == 0), buffer_(initBuffSize), readPos_(0), writePos_(0) {}
 
 size_t Buffer::ReadableBytes() const { return writePos_ - readPos_; }
 size_t Buffer::WritableBytes() const { return buffer_.size() - writePos_; }
@@ -10,10 +11,13 @@ size_t Buffer::PrependableBytes() const { return readPos_; }
 // 指向未读取位置的指针，即通过char*+len得到指针
 const char *Buffer::Peek() const { return BeginPtr_() + readPos_; }
 
-// 标记读出len字节的数据
+// 标记读出len字节的数据，读完了就把读写指针归零（池化的Buffer顺便还回缓冲块）
 void Buffer::Retrieve(size_t len) {
     assert(len <= ReadableBytes());
     readPos_ += len;
+    if (readPos_ == writePos_) {
+        RetrieveAll();
+    }
 }
 
 // 一直读到指针到end为止
@@ -22,9 +26,45 @@ void Buffer::RetrieveUntil(const char *end) {
     Retrieve(end - Peek());
 }
 
-// 设置标志位，代表将所有东西都取完
+// 设置标志位，代表将所有东西都取完，不需要清空内存
 void Buffer::RetrieveAll() {
-    bzero(&buffer_[0], buffer_.size());
+    readPos_ = 0;
+    writePos_ = 0;
+    if (pooled_) {
+        Release();
+    }
+}
+
+// 把缓冲块还给BufferPool，只有没有可读数据时才能还
+void Buffer::Release() {
+    if (buffer_.empty() || ReadableBytes() > 0) {
+        return;
+    }
+    std::vector<char> chunk;
+    chunk.swap(buffer_);
+    readPos_ = 0;
+    writePos_ = 0;
+    BufferPool::Instance()->Release(std::move(chunk));
+}
+
+// 直接接管一块已经写好数据的缓冲（来自ChainBuffer），不需要拷贝
+void Buffer::Adopt(std::vector<char> &&chunk, size_t readPos, size_t writePos) {
+    assert(ReadableBytes() == 0);
+    assert(readPos <= writePos && writePos <= chunk.size());
+    if (!buffer_.empty()) {
+        std::vector<char> old;
+        old.swap(buffer_);
+        BufferPool::Instance()->Release(std::move(old));
+    }
+    buffer_ = std::move(chunk);
+    readPos_ = readPos;
+    writePos_ = writePos;
+}
+
+// 从BufferPool取一块缓冲
+void Buffer::Attach_() {
+    assert(buffer_.empty() && ReadableBytes() == 0);
+    buffer_ = BufferPool::Instance()->Acquire();
     readPos_ = 0;
     writePos_ = 0;
 }
@@ -67,6 +107,9 @@ void Buffer::Append(const Buffer &buff) { Append(buff.Peek(), buff.ReadableBytes
 
 // 确保能写这么多个字节，不够的话就扩展空间
 void Buffer::EnsureWriteable(size_t len) {
+    if (pooled_ && buffer_.empty()) {
+        Attach_();
+    }
     if (WritableBytes() < len) {
         MakeSpace_(len);
     }
@@ -78,6 +121,10 @@ void Buffer::EnsureWriteable(size_t len) {
 // 2. 在只调用一次readv的情况下，也可以保证Buffer的vector不会太大，如果每个Buffer都很大，资源开销就大
 // 之所以可以实现1,2，就是利用了分散读取，具体来说，是利用了局部空间栈做了一个暂时的缓冲
 ssize_t Buffer::ReadFd(int fd, int *saveErrno) {
+    // 有数据可读时才取缓冲块
+    if (pooled_ && buffer_.empty()) {
+        Attach_();
+    }
     char buff[65535];
     struct iovec iov[2];
     const size_t writable = WritableBytes();
@@ -90,6 +137,12 @@ ssize_t Buffer::ReadFd(int fd, int *saveErrno) {
     const ssize_t len = readv(fd, iov, 2);
     if (len < 0) {
         *saveErrno = errno;
+    }
+    // 什么都没读到（EAGAIN或者对方关闭），刚取的缓冲块马上还回去，空闲连接不占缓冲
+    if (len <= 0) {
+        if (pooled_) {
+            Release();
+        }
     } else if (static_cast<size_t>(len) <= writable) {
         writePos_ += len;
     } else {
@@ -99,15 +152,6 @@ ssize_t Buffer::ReadFd(int fd, int *saveErrno) {
     return len;
 }
 
-void Buffer::show() {
-    printf("--------------show begin=---------\n");
-    for (int i = readPos_; i < writePos_; i++) {
-        printf("%c", buffer_[i]);
-    }
-    printf("\n");
-    printf("--------------show end=---------\n");
-}
-
 ssize_t Buffer::WriteFd(int fd, int *saveErrno) {
     size_t readSize = ReadableBytes();
     ssize_t len = write(fd, Peek(), readSize);
@@ -115,15 +159,15 @@ ssize_t Buffer::WriteFd(int fd, int *saveErrno) {
         *saveErrno = errno;
         return len;
     }
-    readPos_ += len;
+    Retrieve(len);
     return len;
 }
 
-// 返回缓冲区的起始位置
-char *Buffer::BeginPtr_() { return &*buffer_.begin(); }
+// 返回缓冲区的起始位置，池化的Buffer没有缓冲块时为nullptr
+char *Buffer::BeginPtr_() { return buffer_.data(); }
 
 // 返回缓冲区的起始位置（常量版）
-const char *Buffer::BeginPtr_() const { return &*buffer_.begin(); }
+const char *Buffer::BeginPtr_() const { return buffer_.data(); }
 
 // 扩展空间，要么是调整读写指针，要么是直接给vector扩容
 void Buffer::MakeSpace_(size_t len) {
@@ -0,0 +1,72 @@
+#include "Buffer/bufferpool.hpp"
+
+// 单例模式，局部静态变量实现
+BufferPool *BufferPool::Instance() {
+    static BufferPool pool;
+    return &pool;
+}
+
+// 取出一个缓冲块，池里没有就新分配
+std::vector<char> BufferPool::Acquire() {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        if (!free_.empty()) {
+            std::vector<char> chunk = std::move(free_.back());
+            free_.pop_back();
+            return chunk;
+        }
+    }
+    return std::vector<char>(CHUNK_SIZE);
+}
+
+// 一次加锁取出n个缓冲块，追加到out后面
+void BufferPool::AcquireBatch(size_t n, std::vector<std::vector<char>> &out) {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        while (n > 0 && !free_.empty()) {
+            out.push_back(std::move(free_.back()));
+            free_.pop_back();
+            n--;
+        }
+    }
+    for (; n > 0; n--) {
+        out.emplace_back(CHUNK_SIZE);
+    }
+}
+
+// 归还缓冲块，池满了或者块被扩容过就直接释放
+void BufferPool::Release(std::vector<char> &&chunk) {
+    if (chunk.size() != CHUNK_SIZE) {
+        return;
+    }
+    std::lock_guard<std::mutex> locker(mtx_);
+    if (free_.size() < maxFree_) {
+        free_.push_back(std::move(chunk));
+    }
+}
+
+// 一次加锁归还多个缓冲块，chunks会被清空
+void BufferPool::ReleaseBatch(std::vector<std::vector<char>> &chunks) {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        for (auto &chunk : chunks) {
+            if (chunk.size() == CHUNK_SIZE && free_.size() < maxFree_) {
+                free_.push_back(std::move(chunk));
+            }
+        }
+    }
+    chunks.clear();
+}
+
+void BufferPool::SetMaxFree(size_t maxFree) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    maxFree_ = maxFree;
+    while (free_.size() > maxFree_) {
+        free_.pop_back();
+    }
+}
+
+size_t BufferPool::FreeCount() {
+    std::lock_guard<std::mutex> locker(mtx_);
+    return free_.size();
+}
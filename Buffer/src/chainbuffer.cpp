@@ -0,0 +1,280 @@
+#include "Buffer/chainbuffer.hpp"
+#include <string.h>
+
+// ReadFd用的空闲缓冲块，每个线程一份，线程退出时还给池
+// 静态对象（比如连接表）中的ChainBuffer可能在它之后才析构，这时不再使用，直接走池
+static thread_local bool spareGone = false;
+struct SpareChunks {
+    std::vector<std::vector<char>> chunks;
+    ~SpareChunks() {
+        BufferPool::Instance()->ReleaseBatch(chunks);
+        spareGone = true;
+    }
+};
+static thread_local SpareChunks spare;
+
+static std::vector<std::vector<char>> *Spare() { return spareGone ? nullptr : &spare.chunks; }
+
+// 取一个缓冲块，先用本线程的空闲块
+static std::vector<char> TakeChunk() {
+    std::vector<std::vector<char>> *chunks = Spare();
+    if (chunks && !chunks->empty()) {
+        std::vector<char> chunk = std::move(chunks->back());
+        chunks->pop_back();
+        return chunk;
+    }
+    return BufferPool::Instance()->Acquire();
+}
+
+ChainBuffer::~ChainBuffer() { RetrieveAll(); }
+
+// 拷贝数据到链尾，最后一块写满了就再取一块
+void ChainBuffer::Append(const char *data, size_t len) {
+    assert(data || len == 0);
+    while (len > 0) {
+        if (blocks_.empty() || blocks_.back().Room() == 0) {
+            blocks_.push_back({TakeChunk(), {}, 0, 0});
+        }
+        Block &tail = blocks_.back();
+        size_t n = std::min(len, tail.Room());
+        std::copy(data, data + n, tail.data.data() + tail.writePos);
+        tail.writePos += n;
+        readable_ += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::Append(const std::string &str) { Append(str.data(), str.size()); }
+
+// 直接把一块写好len字节数据的缓冲挂到链尾，不拷贝
+void ChainBuffer::AppendBlock(std::vector<char> &&block, size_t len) {
+    assert(len <= block.size());
+    if (len == 0) {
+        return;
+    }
+    blocks_.push_back({std::move(block), {}, 0, len});
+    readable_ += len;
+}
+
+// 接管一个string作为单独的一块，不拷贝；短的string拷贝到最后一块中，不值得单独占一块
+void ChainBuffer::AppendString(std::string &&str) {
+    if (str.size() < MIN_ADOPT) {
+        Append(str);
+        return;
+    }
+    size_t len = str.size();
+    blocks_.push_back({{}, std::move(str), 0, len});
+    readable_ += len;
+}
+
+// 把other的所有缓冲块挂到当前链的末尾，other变为空
+void ChainBuffer::Splice(ChainBuffer &other) {
+    if (&other == this) {
+        return;
+    }
+    for (auto &block : other.blocks_) {
+        blocks_.push_back(std::move(block));
+    }
+    readable_ += other.readable_;
+    other.blocks_.clear();
+    other.readable_ = 0;
+}
+
+// 弹出第一块，先补充本线程的空闲块，满了再还给池（接管的string直接释放）
+void ChainBuffer::PopFront_() {
+    assert(!blocks_.empty());
+    std::vector<char> &data = blocks_.front().data;
+    std::vector<std::vector<char>> *chunks = Spare();
+    if (chunks && data.size() == BufferPool::CHUNK_SIZE && chunks->size() < MAX_IOV - 1) {
+        chunks->push_back(std::move(data));
+    } else {
+        BufferPool::Instance()->Release(std::move(data));
+    }
+    blocks_.pop_front();
+}
+
+// 标记读出len字节的数据，读完的块直接还回去
+void ChainBuffer::Retrieve(size_t len) {
+    assert(len <= readable_);
+    readable_ -= len;
+    while (len > 0) {
+        Block &head = blocks_.front();
+        size_t n = std::min(len, head.writePos - head.readPos);
+        head.readPos += n;
+        len -= n;
+        if (head.readPos == head.writePos) {
+            PopFront_();
+        }
+    }
+}
+
+void ChainBuffer::RetrieveAll() {
+    while (!blocks_.empty()) {
+        PopFront_();
+    }
+    readable_ = 0;
+}
+
+std::string ChainBuffer::RetrieveAllToStr() {
+    std::string str;
+    str.reserve(readable_);
+    for (auto &block : blocks_) {
+        str.append(block.Base() + block.readPos, block.writePos - block.readPos);
+    }
+    RetrieveAll();
+    return str;
+}
+
+// 把数据交给连续的Buffer，Buffer为空并且只有一个缓冲块时直接交出，否则逐块拷贝
+void ChainBuffer::MoveInto(Buffer &buff) {
+    if (blocks_.size() == 1 && !blocks_.front().data.empty() && buff.ReadableBytes() == 0) {
+        Block &head = blocks_.front();
+        buff.Adopt(std::move(head.data), head.readPos, head.writePos);
+        blocks_.pop_front();
+        readable_ = 0;
+        return;
+    }
+    for (auto &block : blocks_) {
+        buff.Append(block.Base() + block.readPos, block.writePos - block.readPos);
+    }
+    RetrieveAll();
+}
+
+// 从第block块的pos位置开始是否和pattern一致，pattern可以跨块
+bool ChainBuffer::MatchAt_(size_t block, size_t pos, const char *pattern, size_t len) const {
+    while (len > 0 && block < blocks_.size()) {
+        const Block &cur = blocks_[block];
+        size_t n = std::min(len, cur.writePos - pos);
+        if (memcmp(cur.Base() + pos, pattern, n) != 0) {
+            return false;
+        }
+        pattern += n;
+        len -= n;
+        block++;
+        pos = block < blocks_.size() ? blocks_[block].readPos : 0;
+    }
+    return len == 0;
+}
+
+// 从可读数据的第from个字节开始查找pattern，返回相对于可读数据开头的位置，找不到返回npos
+size_t ChainBuffer::Find(const char *pattern, size_t len, size_t from) const {
+    if (len == 0 || from + len > readable_) {
+        return npos;
+    }
+    size_t base = 0;
+    for (size_t b = 0; b < blocks_.size(); b++) {
+        const Block &cur = blocks_[b];
+        const char *begin = cur.Base() + cur.readPos;
+        size_t n = cur.writePos - cur.readPos;
+        size_t i = from > base ? from - base : 0;
+        while (i < n) {
+            const char *hit = static_cast<const char *>(memchr(begin + i, pattern[0], n - i));
+            if (!hit) {
+                break;
+            }
+            i = hit - begin;
+            if (MatchAt_(b, cur.readPos + i, pattern, len)) {
+                return base + i;
+            }
+            i++;
+        }
+        base += n;
+    }
+    return npos;
+}
+
+// 拷贝出从offset开始的len个字节，不移动读指针
+std::string ChainBuffer::Substr(size_t offset, size_t len) const {
+    assert(offset + len <= readable_);
+    std::string str;
+    str.reserve(len);
+    for (auto it = blocks_.begin(); it != blocks_.end() && len > 0; ++it) {
+        size_t n = it->writePos - it->readPos;
+        if (offset >= n) {
+            offset -= n;
+            continue;
+        }
+        size_t take = std::min(len, n - offset);
+        str.append(it->Base() + it->readPos + offset, take);
+        offset = 0;
+        len -= take;
+    }
+    return str;
+}
+
+// 导出最多maxIov个iovec，用于writev
+int ChainBuffer::ExportIov(struct iovec *iov, int maxIov) const {
+    int cnt = 0;
+    for (auto it = blocks_.begin(); it != blocks_.end() && cnt < maxIov; ++it) {
+        iov[cnt].iov_base = const_cast<char *>(it->Base() + it->readPos);
+        iov[cnt].iov_len = it->writePos - it->readPos;
+        cnt++;
+    }
+    return cnt;
+}
+
+// 分散读，先填满最后一块剩余的空间，再读到本线程的空闲块中，读到数据的块挂到链尾
+// 空闲块用完了才向池里批量取，没用到的留给下一次读；读完还回来的块也先放回空闲块
+ssize_t ChainBuffer::ReadFd(int fd, int *saveErrno) {
+    struct iovec iov[MAX_IOV];
+    int cnt = 0;
+    bool useTail = !blocks_.empty() && blocks_.back().Room() > 0;
+    if (useTail) {
+        Block &tail = blocks_.back();
+        iov[cnt].iov_base = tail.data.data() + tail.writePos;
+        iov[cnt].iov_len = tail.Room();
+        cnt++;
+    }
+    std::vector<std::vector<char>> local;
+    std::vector<std::vector<char>> *chunks = Spare();
+    std::vector<std::vector<char>> &fresh = chunks ? *chunks : local;
+    if (fresh.empty()) {
+        BufferPool::Instance()->AcquireBatch(MAX_IOV - 1, fresh);
+    }
+    // 从末尾开始用，用掉的直接pop_back
+    for (size_t i = fresh.size(); i > 0 && cnt < MAX_IOV; i--) {
+        iov[cnt].iov_base = fresh[i - 1].data();
+        iov[cnt].iov_len = fresh[i - 1].size();
+        cnt++;
+    }
+
+    const ssize_t len = readv(fd, iov, cnt);
+    if (len < 0) {
+        *saveErrno = errno;
+        BufferPool::Instance()->ReleaseBatch(local);
+        return len;
+    }
+    size_t left = len;
+    if (useTail) {
+        Block &tail = blocks_.back();
+        size_t n = std::min(left, tail.Room());
+        tail.writePos += n;
+        left -= n;
+    }
+    while (left > 0) {
+        size_t n = std::min(left, fresh.back().size());
+        blocks_.push_back({std::move(fresh.back()), {}, 0, n});
+        fresh.pop_back();
+        left -= n;
+    }
+    BufferPool::Instance()->ReleaseBatch(local);
+    readable_ += len;
+    return len;
+}
+
+// 集中写，一次writev写出整条链
+ssize_t ChainBuffer::WriteFd(int fd, int *saveErrno) {
+    struct iovec iov[MAX_IOV];
+    int cnt = ExportIov(iov, MAX_IOV);
+    if (cnt == 0) {
+        return 0;
+    }
+    ssize_t len = writev(fd, iov, cnt);
+    if (len < 0) {
+        *saveErrno = errno;
+        return len;
+    }
+    Retrieve(len);
+    return len;
+}
@@ -0,0 +1,76 @@
+#ifndef CREDENTIAL_CACHE_H
+#define CREDENTIAL_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include "Http/sha256.hpp"
+
+/*
+登录验证用的进程内缓存，按用户名查找，挡在MySQL前面
+1. 只保存加盐的SHA-256摘要，不保存明文密码，比较摘要时用常数时间的比较
+2. 不存在的用户也会缓存（负缓存），有效期比正常的条目短
+3. 条目数量有上限，超过时按LRU淘汰最久没有用过的
+4. 注册时先Erase这个用户名，注册成功之后再Put，不会因为负缓存把刚注册的用户挡在外面
+多个工作线程和DB线程同时访问，用一把锁保护
+*/
+class CredentialCache {
+public:
+    enum Result { MISS = 0, MATCH, MISMATCH, UNKNOWN_USER };
+
+    using Clock = std::chrono::steady_clock;
+
+    CredentialCache(size_t capacity, Clock::duration ttl, Clock::duration negativeTtl);
+
+    // 用缓存验证密码：MISS表示没有缓存或者已经过期，需要查数据库
+    Result Check(const std::string &name, const std::string &pwd);
+
+    // 数据库中查到的用户和密码
+    void Put(const std::string &name, const std::string &pwd);
+    // 数据库中没有这个用户
+    void PutUnknown(const std::string &name);
+    void Erase(const std::string &name);
+    void Clear();
+    // 运行时修改容量和有效期，容量变小时淘汰最久没有用过的，已有条目的过期时间不变
+    void SetLimits(size_t capacity, Clock::duration ttl, Clock::duration negativeTtl);
+
+    size_t Size();
+    size_t Hits() { return hits_.load(std::memory_order_relaxed); }
+    size_t Misses() { return misses_.load(std::memory_order_relaxed); }
+
+    // 比较两个密码的摘要，比较时间和内容无关
+    static bool SecretEqual(const std::string &a, const std::string &b);
+
+private:
+    static const size_t SALT_LEN = 16;
+
+    struct Entry {
+        std::string name;
+        bool exists;
+        uint8_t salt[SALT_LEN];
+        Sha256::Digest digest;
+        Clock::time_point expire;
+    };
+
+    Sha256::Digest Digest_(const uint8_t *salt, const std::string &pwd);
+    Entry &Insert_(const std::string &name);
+    static bool DigestEqual_(const Sha256::Digest &a, const Sha256::Digest &b);
+
+    size_t capacity_;
+    Clock::duration ttl_;
+    Clock::duration negativeTtl_;
+
+    // 链表头是最近用过的
+    std::list<Entry> lru_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    std::mt19937_64 rng_;
+    std::atomic<size_t> hits_;
+    std::atomic<size_t> misses_;
+    std::mutex mtx_;
+};
+
+#endif // CREDENTIAL_CACHE_H
@@ -9,22 +9,28 @@
 #include "Log/log.hpp"
 #include "Pool/sqlconnRALL.hpp"
 #include "Buffer/buffer.hpp"
+#include "Buffer/chainbuffer.hpp"
 #include "Http/httprequest.hpp"
 #include "Http/httpresponse.hpp"
+#include "Http/tlscontext.hpp"
 #include "SkipList/kvstore.hpp"
 
 /*
 使用逻辑
 1. 调用init
-2. 调用read从fd将http请求读到readBuff_
-3. 调用process，从readBuff_解析，然后准备好了writeBuff_（可能还有mmap，iov机制）
-4. 调用write，将http回复发送出去
+2. 调用read从fd将http请求直接读到readChain_的缓冲块中
+3. 调用process，直接在readChain_上解析，然后准备好了writeBuff_（回复头部）和bodyChain_（回复内容），
+   value和路由生成的内容直接移动到bodyChain_中，不拷贝
+4. 调用write，用一次writev将http回复发送出去
+HTTPS连接在init之后StartTls，主循环完成握手之后才开始读写；没有用上kTLS的方向经过SSL_read/SSL_write
 */
 
 class HttpConn {
 public:
     HttpConn();
 
+    explicit HttpConn(std::shared_ptr<KvStore> kv);
+
     ~HttpConn();
 
     void init(int sockFd, const sockaddr_in &addr);
@@ -33,6 +39,7 @@ public:
 
     ssize_t write(int *saveErrno);
 
+    // 会释放SSL，只能在没有工作线程读写这个连接的时候调用（见WebServer::CloseConn_）
     void Close();
 
     int GetFd() const;
@@ -43,11 +50,31 @@ public:
 
     sockaddr_in GetAddr() const;
 
-    bool process();
+    // admit见HttpRequest::parse，被拒绝的请求回复429，发送完之后关闭连接
+    bool process(const HttpRequest::Admission &admit = nullptr);
+
+    // 这个连接是HTTPS，握手还没有开始
+    void StartTls(ssl_st *ssl) { tls_.Start(ssl); }
+    TlsConn &Tls() { return tls_; }
+    // 在主循环中直接回复一段固定的内容（比如拒绝请求），不等待，写不完就算了
+    void WriteNow(const char *data, size_t len);
+
+    // 当前请求是否在等待数据库验证，以及验证完成之后准备回复
+    bool IsVerifying() const { return request_.NeedVerify(); }
+    std::string VerifyUser() const { return request_.GetPost("username"); }
+    std::string VerifyPwd() const { return request_.GetPost("password"); }
+    bool VerifyIsLogin() const { return request_.IsLogin(); }
+    void FinishVerify(bool ok);
 
-    int ToWriteBytes() { return iov_[0].iov_len + iov_[1].iov_len; }
+    int ToWriteBytes() { return writeBuff_.ReadableBytes() + bodyChain_.ReadableBytes(); }
+    // 没有读到一半的请求，也没有没发完的回复，只在连接不在工作线程手上时调用
+    bool Idle() { return ToWriteBytes() == 0 && readChain_.ReadableBytes() == 0; }
 
-    bool IsKeepAlive() const { return request_.IsKeepAlive(); }
+    // 刚准备好的回复是否保持连接（错误和拒绝的回复都会关闭连接）
+    bool IsKeepAlive() const { return response_.IsKeepAlive(); }
+
+    // 当前请求的追踪打点，最后一个字节写出去时结束
+    RequestTrace &Trace() { return trace_; }
 
     static bool isET;
     static const char *srcDir;
@@ -55,19 +82,23 @@ public:
     std::shared_ptr<KvStore> kv;
 
 private:
+    void MakeResponse_();
+    bool Route_();
+
     int fd_;
     struct sockaddr_in addr_;
+    char ip_[INET_ADDRSTRLEN]; // init时转换好，inet_ntoa返回的是静态缓冲，多线程下不安全
 
     bool isClose_;
 
-    int iovCnt_;
-    struct iovec iov_[2];
-
-    Buffer readBuff_;  // 读缓冲区
-    Buffer writeBuff_; // 写缓冲区
+    Buffer writeBuff_;      // 写缓冲区（回复头部）
+    ChainBuffer readChain_; // 从fd读到的数据，也就是读缓冲区
+    ChainBuffer bodyChain_; // 回复内容
 
     HttpRequest request_;
     HttpResponse response_;
+    RequestTrace trace_;
+    TlsConn tls_;
 };
 
 #endif //HTTP_CONN_H
\ No newline at end of file
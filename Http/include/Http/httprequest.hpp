@@ -6,14 +6,19 @@
 #include <string>
 #include <regex>
 #include <errno.h>
+#include <strings.h>
+#include <arpa/inet.h>
 #include <mysql/mysql.h>
 #include <iostream>
+#include <functional>
 
 #include "Buffer/buffer.hpp"
+#include "Buffer/chainbuffer.hpp"
 #include "Log/log.hpp"
 #include "Pool/sqlconnpool.hpp"
 #include "Pool/sqlconnRALL.hpp"
 #include "SkipList/kvstore.hpp"
+#include "Metrics/tracer.hpp"
 
 class HttpRequest {
 public:
@@ -33,13 +38,18 @@ public:
         FILE_REQUEST,
         INTERNAL_ERROR,
         CLOSED_CONNECTION,
+        REFUSED_REQUEST, // 请求完整，但没有通过admit检查，已经从缓冲区中取走，没有执行
     };
 
+    // 请求完整之后、执行（kv操作、登录验证）之前调用，返回false表示拒绝
+    using Admission = std::function<bool(const HttpRequest &request)>;
+
     HttpRequest(std::shared_ptr<KvStore> kv) : kv_req(kv) { Init(); }
     ~HttpRequest() = default;
 
     void Init();
-    bool parse(Buffer &buff);
+    // 返回GET_REQUEST表示取走了一个完整的请求，NO_REQUEST表示还没读全，BAD_REQUEST表示格式错误
+    HTTP_CODE parse(ChainBuffer &buff, const Admission &admit = nullptr);
 
     std::string path() const;
     std::string &path();
@@ -49,8 +59,24 @@ public:
     std::string GetPost(const char *key) const;
 
     bool IsKeepAlive() const;
+    // 原样的请求行（不含\r\n），path()已经被改写过，按请求行匹配规则时用这个
+    const std::string &RequestLine() const { return line_; }
+
+    // 对端的地址跟着连接走，Init不会清掉；IsLocal表示对端是本机（127.0.0.0/8）
+    void SetPeer(const sockaddr_in &addr) { peerIp_ = addr.sin_addr.s_addr; }
+    uint32_t PeerIp() const { return peerIp_; }
+    bool IsLocal() const { return (ntohl(peerIp_) >> 24) == 127; }
+
+    // 登录/注册请求需要异步验证，验证完成之后调用FinishVerify
+    bool NeedVerify() const { return needVerify_; }
+    bool IsLogin() const { return verifyLogin_; }
+    void FinishVerify(bool ok);
 
-    void ParseKv();
+    // 解析完请求体（kv操作之前）时打点
+    void SetTrace(RequestTrace *trace) { trace_ = trace; }
+
+    // 执行请求体中的kv操作（set k v / get k / del k），参数个数不对时返回false
+    bool ParseKv();
     std::vector<std::string> kvOp;
     std::shared_ptr<KvStore> kv_req;
     std::string value;
@@ -64,19 +90,26 @@ public:
 private:
     bool ParseRequestLine_(const std::string &line);
     void ParseHeader_(const std::string &line);
-    void ParseBody_(const std::string &line);
+    bool ParseBody_(std::string &&body);
+    size_t ContentLength_() const;
 
     void ParsePath_();
     void ParsePost_();
     void ParseFromUrlencoded_();
 
-    static bool UserVerify(const std::string &name, const std::string &pwd, bool isLogin);
-
     PARSE_STATE state_;
-    std::string method_, path_, version_, body_;
+    size_t bodyLen_ = 0;
+    bool needVerify_ = false;
+    bool verifyLogin_ = false;
+    uint32_t peerIp_ = 0; // 网络字节序
+    RequestTrace *trace_ = nullptr;
+    std::string line_, method_, path_, version_, body_;
     std::unordered_map<std::string, std::string> header_;
     std::unordered_map<std::string, std::string> post_;
 
+    // 头部和请求体的上限，超过直接当作错误请求，避免一直攒着数据等不完整的请求
+    static const size_t MAX_HEAD_SIZE = 64 * 1024;
+    static const size_t MAX_BODY_SIZE = 16 * 1024 * 1024;
     static const std::unordered_set<std::string> DEFAULT_HTML;
     static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
     static int ConverHex(char ch);
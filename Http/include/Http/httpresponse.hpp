@@ -18,15 +18,19 @@ public:
     void Init(const std::string& srcDir, std::string& path, bool isKeepAlive = false, int code = -1);
     // 关键函数，根据Init函数提供的路径构造出Http回复报文
     void MakeResponse(Buffer& buff);
+    // 服务器生成内容时只写状态行和头部
+    void MakeHead(Buffer& buff, const std::string& contentType);
     void UnmapFile();
     char* File();
     size_t FileLen() const;
     void ErrorContent(Buffer& buff, std::string message);
     int Code() const { return code_; }
+    bool IsKeepAlive() const { return isKeepAlive_; }
 
 private:
     void AddStateLine_(Buffer &buff);
     void AddHeader_(Buffer &buff);
+    void AddHeader_(Buffer &buff, const std::string &contentType);
     void AddContent_(Buffer &buff);
 
     void ErrorHtml_();
@@ -0,0 +1,52 @@
+#ifndef HTTP_ROUTER_H
+#define HTTP_ROUTER_H
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+class HttpRequest;
+
+/*
+服务器自己生成内容的路径（比如/metrics），不对应resources中的文件
+1. Handler在工作线程中执行，返回状态码，填好回复内容和Content-type
+2. 注册很少（一般在启动时），查找在每个请求上都会发生：
+   注册时复制一份新的路由表再原子地替换，查找只需要一次acquire load，不加锁
+3. 旧的路由表保留到进程结束，正在查找的线程不会读到已经释放的内存
+4. 管理用的路径可以限制只接受本机（loopback）的请求，会修改状态的路径可以限制只接受POST，
+   不满足时不执行Handler，分别回复403和405
+*/
+class HttpRouter {
+public:
+    using Handler =
+        std::function<int(const HttpRequest &request, std::string &body, std::string &contentType)>;
+
+    enum Flag {
+        LOCAL_ONLY = 1, // 只接受来自本机的请求
+        POST_ONLY = 2,  // 只接受POST
+    };
+
+    // 同一个路径再次注册会覆盖之前的Handler，flags是Flag的组合
+    static void Register(const std::string &path, Handler handler, int flags = 0);
+
+    // 找到路径对应的Handler并执行，没有注册过返回false
+    static bool Dispatch(const HttpRequest &request, int *code, std::string *body,
+                         std::string *contentType);
+
+private:
+    struct Route {
+        Handler handler;
+        int flags;
+    };
+    using Routes = std::map<std::string, Route>;
+
+    static std::atomic<const Routes *> routes_;
+    static std::mutex mtx_;
+    static std::vector<std::unique_ptr<Routes>> versions_;
+};
+
+#endif // HTTP_ROUTER_H
@@ -0,0 +1,33 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <array>
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+SHA-256（FIPS 180-4），只用来给缓存中的密码做摘要，不依赖外部的加密库
+Update可以调用多次，Final之后对象不能再用
+*/
+class Sha256 {
+public:
+    using Digest = std::array<uint8_t, 32>;
+
+    Sha256();
+
+    void Update(const void *data, size_t len);
+    Digest Final();
+
+    static Digest Hash(const std::string &data);
+
+private:
+    void Transform_(const uint8_t *block);
+
+    uint32_t state_[8];
+    uint8_t block_[64];
+    size_t blockLen_;
+    uint64_t totalLen_;
+};
+
+#endif // SHA256_H
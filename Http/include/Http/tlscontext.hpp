@@ -0,0 +1,72 @@
+#ifndef TLS_CONTEXT_H
+#define TLS_CONTEXT_H
+
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct ssl_ctx_st;
+struct ssl_st;
+
+/*
+可选的HTTPS，编译时找到OpenSSL才有（HTTP_HAVE_TLS），否则Init总是失败
+1. 握手在主循环中做，socket是非阻塞的，一次握手可能要等好几轮读写事件
+2. 握手完成之后，如果内核支持kTLS（SSL_OP_ENABLE_KTLS，需要加载tls模块，加密套件也要支持），
+   记录的加解密交给内核：fd上直接readv/writev的就是明文，HttpConn原来的零拷贝写法不用改
+   某个方向没有用上kTLS时，这个方向退回SSL_read/SSL_write（多一次拷贝）
+3. 会话复用：服务端的session cache加上session ticket（TLS1.3只发一张），客户端重连时不需要完整握手
+   ticket的密钥在进程启动时随机生成，平滑重启之后旧的ticket会失效，客户端做一次完整握手
+*/
+class TlsContext {
+public:
+    static TlsContext *Instance();
+
+    // 加载证书和私钥，失败时err说明原因；可以重复调用，之后新建的连接使用新的配置
+    bool Init(const std::string &certFile, const std::string &keyFile, bool ktls,
+              int sessionCacheSize, int sessionTimeoutSec, std::string *err);
+    bool Enabled() const { return ctx_ != nullptr; }
+
+    // 为一个已经accept的连接创建SSL对象，失败返回nullptr
+    ssl_st *NewSsl(int fd);
+
+private:
+    TlsContext() : ctx_(nullptr) {}
+    ~TlsContext();
+
+    ssl_ctx_st *ctx_;
+};
+
+// 一个连接上的TLS状态，跟着HttpConn复用；同一时刻只有一个线程处理一个连接，不需要同步
+class TlsConn {
+public:
+    TlsConn() : ssl_(nullptr), established_(false), ktlsSend_(false), ktlsRecv_(false) {}
+    ~TlsConn() { Reset(); }
+    TlsConn(const TlsConn &) = delete;
+    TlsConn &operator=(const TlsConn &) = delete;
+
+    void Start(ssl_st *ssl);
+    void Reset();
+
+    bool Active() const { return ssl_ != nullptr; }
+    bool Handshaking() const { return ssl_ != nullptr && !established_; }
+    // 这个方向已经交给内核，直接读写fd就可以
+    bool KtlsSend() const { return ktlsSend_; }
+    bool KtlsRecv() const { return ktlsRecv_; }
+
+    // 继续握手：返回1表示完成，0表示要等fd可读（*wantWrite为false）或者可写，-1表示失败
+    int Handshake(bool *wantWrite);
+
+    // 和read/writev一样，失败时返回-1并设置errno，EAGAIN表示要等下一次事件，对方关闭时Read返回0
+    ssize_t Read(char *buf, size_t len);
+    ssize_t Writev(const struct iovec *iov, int iovCnt);
+    // SSL中已经解密但是还没有读走的字节数
+    int Pending() const;
+
+private:
+    ssl_st *ssl_;
+    bool established_;
+    bool ktlsSend_;
+    bool ktlsRecv_;
+};
+
+#endif // TLS_CONTEXT_H
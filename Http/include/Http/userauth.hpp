@@ -0,0 +1,46 @@
+#ifndef USER_AUTH_H
+#define USER_AUTH_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <functional>
+#include <mysql/mysql.h>
+
+#include "Log/log.hpp"
+#include "Pool/sqlexecutor.hpp"
+#include "Pool/sqlbatchinserter.hpp"
+#include "Http/credentialcache.hpp"
+
+/*
+登录和注册的数据库操作，从HttpRequest中拆出来
+Verify是同步的，只应该在DB线程中调用；VerifyAsync把Verify交给SqlExecutor，
+done在DB线程中被调用，需要由调用者自己投递回连接所在的线程
+查询走连接上缓存的预编译语句；异步注册交给SqlBatchInserter和其他注册请求合并，
+查重和INSERT在同一个DB任务中，并发注册同一个用户名时靠user表上username的唯一键兜底
+合并写入器由服务器创建（NewInserter）并通过SetInserter注册，服务器析构时先停掉它再关闭连接池
+登录先查CredentialCache，命中时不需要经过DB线程
+*/
+class UserAuth {
+public:
+    static bool Verify(MYSQL *sql, const std::string &name, const std::string &pwd, bool isLogin);
+
+    static void VerifyAsync(const std::string &name, const std::string &pwd, bool isLogin,
+                            std::function<void(bool)> done);
+
+    static CredentialCache &Cache();
+
+    // 注册用的合并写入器，插入之前逐行查重
+    static std::unique_ptr<SqlBatchInserter> NewInserter();
+    // 为空时注册在一个DB任务中同步查重和插入
+    static void SetInserter(SqlBatchInserter *inserter);
+
+private:
+    // 查询用户名对应的密码，找到返回1，没有返回0，出错返回-1
+    static int Lookup_(MYSQL *sql, const std::string &name, std::string *password);
+    static bool Insert_(MYSQL *sql, const std::string &name, const std::string &pwd);
+
+    static std::atomic<SqlBatchInserter *> inserter_;
+};
+
+#endif // USER_AUTH_H
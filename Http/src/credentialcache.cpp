@@ -0,0 +1,122 @@
+#include "Http/credentialcache.hpp"
+#include <assert.h>
+#include <string.h>
+
+using namespace std;
+
+CredentialCache::CredentialCache(size_t capacity, Clock::duration ttl, Clock::duration negativeTtl)
+    : capacity_(capacity), ttl_(ttl), negativeTtl_(negativeTtl), rng_(random_device{}()),
+      hits_(0), misses_(0) {
+    assert(capacity_ > 0);
+}
+
+CredentialCache::Result CredentialCache::Check(const string &name, const string &pwd) {
+    lock_guard<mutex> locker(mtx_);
+    auto it = index_.find(name);
+    if (it == index_.end()) {
+        misses_++;
+        return MISS;
+    }
+    Entry &entry = *it->second;
+    if (Clock::now() >= entry.expire) {
+        lru_.erase(it->second);
+        index_.erase(it);
+        misses_++;
+        return MISS;
+    }
+    hits_++;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    if (!entry.exists) {
+        return UNKNOWN_USER;
+    }
+    return DigestEqual_(Digest_(entry.salt, pwd), entry.digest) ? MATCH : MISMATCH;
+}
+
+void CredentialCache::Put(const string &name, const string &pwd) {
+    lock_guard<mutex> locker(mtx_);
+    Entry &entry = Insert_(name);
+    entry.exists = true;
+    for (size_t i = 0; i < SALT_LEN; i += sizeof(uint64_t)) {
+        uint64_t r = rng_();
+        memcpy(entry.salt + i, &r, sizeof(r));
+    }
+    entry.digest = Digest_(entry.salt, pwd);
+    entry.expire = Clock::now() + ttl_;
+}
+
+void CredentialCache::PutUnknown(const string &name) {
+    lock_guard<mutex> locker(mtx_);
+    Entry &entry = Insert_(name);
+    entry.exists = false;
+    entry.digest.fill(0);
+    entry.expire = Clock::now() + negativeTtl_;
+}
+
+void CredentialCache::Erase(const string &name) {
+    lock_guard<mutex> locker(mtx_);
+    auto it = index_.find(name);
+    if (it != index_.end()) {
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+}
+
+void CredentialCache::Clear() {
+    lock_guard<mutex> locker(mtx_);
+    lru_.clear();
+    index_.clear();
+}
+
+void CredentialCache::SetLimits(size_t capacity, Clock::duration ttl, Clock::duration negativeTtl) {
+    assert(capacity > 0);
+    lock_guard<mutex> locker(mtx_);
+    capacity_ = capacity;
+    ttl_ = ttl;
+    negativeTtl_ = negativeTtl;
+    while (lru_.size() > capacity_) {
+        index_.erase(lru_.back().name);
+        lru_.pop_back();
+    }
+}
+
+size_t CredentialCache::Size() {
+    lock_guard<mutex> locker(mtx_);
+    return lru_.size();
+}
+
+// 找到或者新建name的条目并移到链表头，超过容量时淘汰链表尾
+CredentialCache::Entry &CredentialCache::Insert_(const string &name) {
+    auto it = index_.find(name);
+    if (it != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return lru_.front();
+    }
+    if (lru_.size() >= capacity_) {
+        index_.erase(lru_.back().name);
+        lru_.pop_back();
+    }
+    lru_.emplace_front();
+    lru_.front().name = name;
+    index_[name] = lru_.begin();
+    return lru_.front();
+}
+
+Sha256::Digest CredentialCache::Digest_(const uint8_t *salt, const string &pwd) {
+    Sha256 sha;
+    sha.Update(salt, SALT_LEN);
+    sha.Update(pwd.data(), pwd.size());
+    return sha.Final();
+}
+
+bool CredentialCache::SecretEqual(const string &a, const string &b) {
+    return DigestEqual_(Sha256::Hash(a), Sha256::Hash(b));
+}
+
+// 比较时间和第一个不同字节的位置无关
+bool CredentialCache::DigestEqual_(const Sha256::Digest &a, const Sha256::Digest &b) {
+    volatile uint8_t diff = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        diff = diff | (a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
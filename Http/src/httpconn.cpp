@@ -1,13 +1,30 @@
 #include "Http/httpconn.hpp"
+#include "Http/httprouter.hpp"
+#include "Metrics/metrics.hpp"
+#include "Metrics/slowlog.hpp"
 using namespace std;
 
 const char *HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
 bool HttpConn::isET;
 
-HttpConn::HttpConn() : kv(new KvStore()), request_(kv) {
+static Counter bytesRead("http_read_bytes_total", "Bytes read from client sockets");
+static Counter bytesWritten("http_written_bytes_total", "Bytes written to client sockets");
+static IntCounterVec responses("http_responses_total", "Responses by status code", "code");
+static Histogram parseSeconds("http_parse_seconds", "Time spent parsing one request");
+static CallbackGauge connections("http_connections", "Open client connections",
+                                 [] { return static_cast<double>(HttpConn::userCount.load()); });
+
+HttpConn::HttpConn() : HttpConn(std::make_shared<KvStore>()) {}
+
+// 所有连接共享服务器的KvStore
+// 读写缓冲区都是池化的，空闲连接不占缓冲块
+HttpConn::HttpConn(std::shared_ptr<KvStore> kv)
+    : kv(std::move(kv)), writeBuff_(0), request_(this->kv) {
+    request_.SetTrace(&trace_);
     fd_ = -1;
     addr_ = {0};
+    ip_[0] = '\0';
     isClose_ = true;
 };
 
@@ -17,9 +34,14 @@ void HttpConn::init(int fd, const sockaddr_in &addr) {
     assert(fd > 0);
     userCount++;
     addr_ = addr;
+    inet_ntop(AF_INET, &addr_.sin_addr, ip_, sizeof(ip_));
+    request_.SetPeer(addr_);
     fd_ = fd;
     writeBuff_.RetrieveAll();
-    readBuff_.RetrieveAll();
+    readChain_.RetrieveAll();
+    bodyChain_.RetrieveAll();
+    trace_.Reset();
+    tls_.Reset();
     isClose_ = false;
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
 }
@@ -31,6 +53,10 @@ void HttpConn::Close() {
     if (isClose_ == false) {
         isClose_ = true;
         userCount--;
+        writeBuff_.RetrieveAll();
+        readChain_.RetrieveAll();
+        bodyChain_.RetrieveAll();
+        tls_.Reset();
         close(fd_);
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
     }
@@ -42,85 +68,177 @@ struct sockaddr_in HttpConn::GetAddr() const {
     return addr_;
 }
 
-const char *HttpConn::GetIP() const { return inet_ntoa(addr_.sin_addr); }
+const char *HttpConn::GetIP() const { return ip_; }
 
 int HttpConn::GetPort() const { return addr_.sin_port; }
 
-// 从fd中读取数据到readBuff_
+// 从fd中读取数据，直接读到readChain_的缓冲块中
 ssize_t HttpConn::read(int *saveErrno) {
     ssize_t len = -1;
+    // 没有kTLS时先由SSL解密到栈上，再拷贝进readChain_
+    if (tls_.Active() && !tls_.KtlsRecv()) {
+        char buf[16384];
+        do {
+            len = tls_.Read(buf, sizeof(buf));
+            if (len <= 0) {
+                *saveErrno = errno;
+                break;
+            }
+            bytesRead.Add(len);
+            readChain_.Append(buf, len);
+        } while (isET || tls_.Pending() > 0);
+        return len;
+    }
     do {
-        len = readBuff_.ReadFd(fd_, saveErrno);
+        len = readChain_.ReadFd(fd_, saveErrno);
         if (len <= 0) {
             break;
         }
+        bytesRead.Add(len);
     } while (isET); // 边缘触发，所以要一直读
-    readBuff_.show();
     return len;
 }
 
-// 写数据到fd中
+// 在主循环中直接写一段固定的回复，不等待
+void HttpConn::WriteNow(const char *data, size_t len) {
+    ssize_t ret = -1;
+    if (tls_.Handshaking()) {
+        // 还没有加密通道，什么也不能发
+    } else if (tls_.Active() && !tls_.KtlsSend()) {
+        struct iovec iov = {const_cast<char *>(data), len};
+        ret = tls_.Writev(&iov, 1);
+    } else {
+        ret = send(fd_, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+    if (ret < 0) {
+        LOG_DEBUG("Client[%d] write now error", fd_);
+    }
+}
+
+// 写数据到fd中，头部和内容拼成一组iovec，一次writev写出
 ssize_t HttpConn::write(int *saveErrno) {
-    ssize_t len = -1;
+    ssize_t len = 0;
+    struct iovec iov[ChainBuffer::MAX_IOV + 1];
     do {
-        len = writev(fd_, iov_, iovCnt_);
-        if (len <= 0) {
-            *saveErrno = errno;
-            break;
+        int iovCnt = 0;
+        size_t headLen = writeBuff_.ReadableBytes();
+        if (headLen > 0) {
+            iov[0].iov_base = const_cast<char *>(writeBuff_.Peek());
+            iov[0].iov_len = headLen;
+            iovCnt = 1;
         }
+        iovCnt += bodyChain_.ExportIov(iov + iovCnt, ChainBuffer::MAX_IOV);
         // 传输结束
-        if (iov_[0].iov_len + iov_[1].iov_len == 0) {
+        if (iovCnt == 0) {
             break;
         }
-        // 使用到了第二块iov缓冲区
-        else if (static_cast<size_t>(len) > iov_[0].iov_len) {
-            iov_[1].iov_base = (uint8_t *)iov_[1].iov_base + (len - iov_[0].iov_len);
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
-            if (iov_[0].iov_len) {
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
-            }
+        if (tls_.Active() && !tls_.KtlsSend()) {
+            len = tls_.Writev(iov, iovCnt);
+        } else {
+            len = writev(fd_, iov, iovCnt);
         }
-        // 只用到了第一块缓冲区
-        else {
-            iov_[0].iov_base = (uint8_t *)iov_[0].iov_base + len;
-            iov_[0].iov_len -= len;
-            writeBuff_.Retrieve(len);
+        if (len <= 0) {
+            *saveErrno = errno;
+            break;
         }
-    } while (isET || ToWriteBytes() > 10240);
+        bytesWritten.Add(len);
+        trace_.MarkOnce(RequestTrace::FIRST_BYTE);
+        // 先消耗头部，剩下的算在内容上
+        size_t fromHead = std::min(static_cast<size_t>(len), headLen);
+        writeBuff_.Retrieve(fromHead);
+        bodyChain_.Retrieve(len - fromHead);
+    } while (ToWriteBytes() > 0 && (isET || ToWriteBytes() > 10240));
+    // 回复写完，请求结束；比第N慢的请求还快时只多一次原子读
+    if (ToWriteBytes() == 0 && trace_.Marked(RequestTrace::FIRST_BYTE)) {
+        trace_.Mark(RequestTrace::LAST_BYTE);
+        if (SlowLog::Instance()->IsSlow(trace_.Since(RequestTrace::LAST_BYTE))) {
+            SlowLog::Instance()->Add(trace_, fd_, request_.method(), request_.path());
+        }
+        trace_.Finish(fd_);
+    }
     return len;
 }
 
 // 调用了process后，writeBuff_就已经准备好了，再调用write就可以将http回复发送出去
-bool HttpConn::process() {
-    // 将http请求从readBuff_中读出并解析，并初始化response
+// 登录/注册请求需要查数据库，这时返回false并且IsVerifying()为true，
+// 由调用者异步验证，完成之后调用FinishVerify准备回复
+bool HttpConn::process(const HttpRequest::Admission &admit) {
+    // 将http请求从readChain_中读出并解析，并初始化response
     request_.Init();
-    if (readBuff_.ReadableBytes() <= 0) {
+    if (readChain_.ReadableBytes() <= 0) {
         return false;
-    } else if (request_.parse(readBuff_)) {
+    }
+    Histogram::Clock::time_point start = Histogram::Clock::now();
+    HttpRequest::HTTP_CODE code = request_.parse(readChain_, admit);
+    parseSeconds.RecordSince(start);
+    if (code == HttpRequest::NO_REQUEST) {
+        // 请求还没读全，继续监听读事件
+        return false;
+    }
+    if (code == HttpRequest::REFUSED_REQUEST) {
+        response_.Init(srcDir, request_.path(), false, 429);
+        response_.MakeHead(writeBuff_, "text/plain");
+        writeBuff_.Append("Retry-After: 1\r\nContent-length: 0\r\n\r\n");
+        responses.With(429).Add();
+        return true;
+    }
+    if (code == HttpRequest::GET_REQUEST) {
+        trace_.MarkOnce(RequestTrace::PARSE);
         LOG_DEBUG("%s", request_.path().c_str());
+        if (request_.NeedVerify()) {
+            return false;
+        }
+        if (Route_()) {
+            return true;
+        }
         response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
     } else {
         response_.Init(srcDir, request_.path(), false, 400);
     }
+    MakeResponse_();
+    trace_.Mark(RequestTrace::HANDLER);
+    return true;
+}
+
+// 服务器自己生成内容的路径（见HttpRouter），不读文件也不走kv
+bool HttpConn::Route_() {
+    int code = 200;
+    string body;
+    string type = "text/plain";
+    if (!HttpRouter::Dispatch(request_, &code, &body, &type)) {
+        return false;
+    }
+    response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), code);
+    response_.MakeHead(writeBuff_, type);
+    writeBuff_.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
+    bodyChain_.AppendString(std::move(body));
+    responses.With(response_.Code()).Add();
+    trace_.Mark(RequestTrace::HANDLER);
+    return true;
+}
+
+void HttpConn::FinishVerify(bool ok) {
+    assert(request_.NeedVerify());
+    request_.FinishVerify(ok);
+    response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
+    MakeResponse_();
+    trace_.Mark(RequestTrace::HANDLER);
+}
+
+void HttpConn::MakeResponse_() {
     // 根据已经初始化的response_将http回复写到writeBuff_中（这个函数因为kv被改了）
     response_.MakeResponse(writeBuff_);
-    // 以下两行kv相关
-    writeBuff_.Append("Content-length: " + to_string(request_.value.size()) + "\r\n\r\n");
-    writeBuff_.Append(request_.value);
-    writeBuff_.Append("\n");
-
-    cout << "value:  " << request_.value << endl;
-    // Buffer中只存了报文头部
-    iov_[0].iov_base = const_cast<char *>(writeBuff_.Peek());
-    iov_[0].iov_len = writeBuff_.ReadableBytes();
-    iovCnt_ = 1;
-    // 为了避免文件过大，用了mmap和iov机制（截胡，这里先修改为kv，如果要取消kv存储，则将下面这个if注释取消）
+    responses.With(response_.Code()).Add();
+    // 以下几行kv相关，value移动到bodyChain_中，不会让writeBuff_扩容，长度包括末尾的换行
+    writeBuff_.Append("Content-length: " + to_string(request_.value.size() + 1) + "\r\n\r\n");
+    LOG_DEBUG("Client[%d] value: %s", fd_, request_.value.c_str());
+    bodyChain_.AppendString(std::move(request_.value));
+    request_.value.clear();
+    bodyChain_.Append("\n", 1);
+
+    // writeBuff_中只存了报文头部（截胡，这里先修改为kv，如果要取消kv存储，则将下面这个if注释取消）
     // if (response_.FileLen() > 0 && response_.File()) {
-    //     iov_[1].iov_base = response_.File();
-    //     iov_[1].iov_len = response_.FileLen();
-    //     iovCnt_ = 2;
+    //     bodyChain_.Append(response_.File(), response_.FileLen());
     // }
-    LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen(), iovCnt_, ToWriteBytes());
-    return true;
+    LOG_DEBUG("filesize:%d, to %d", response_.FileLen(), ToWriteBytes());
 }
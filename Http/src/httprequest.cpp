@@ -1,7 +1,12 @@
 #include "Http/httprequest.hpp"
+#include "Metrics/metrics.hpp"
 #include <sstream>
 using namespace std;
 
+static Histogram kvSetSeconds("kv_op_seconds", "KV store operation latency", "verb=\"set\"");
+static Histogram kvGetSeconds("kv_op_seconds", "KV store operation latency", "verb=\"get\"");
+static Histogram kvDelSeconds("kv_op_seconds", "KV store operation latency", "verb=\"del\"");
+
 const unordered_set<string> HttpRequest::DEFAULT_HTML{
     "/index", "/register", "/login", "/welcome", "/video", "/picture",
 };
@@ -12,10 +17,12 @@ const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG{
 };
 
 void HttpRequest::Init() {
-    method_ = path_ = version_ = body_ = "";
+    line_ = method_ = path_ = version_ = body_ = "";
     state_ = REQUEST_LINE;
+    bodyLen_ = 0;
     header_.clear();
     post_.clear();
+    needVerify_ = false;
 }
 
 bool HttpRequest::IsKeepAlive() const {
@@ -25,41 +32,53 @@ bool HttpRequest::IsKeepAlive() const {
     return false;
 }
 
-// 解析一整个http请求
-bool HttpRequest::parse(Buffer &buff) {
+// 解析一整个http请求，直接在读到的缓冲块链上按行查找，不需要先拼成连续的
+// 头部和Content-Length指定的请求体没有全部读到之前返回NO_REQUEST，缓冲区里的数据一个字节都不取走，
+// 等下次读到更多数据后从头再解析
+HttpRequest::HTTP_CODE HttpRequest::parse(ChainBuffer &buff, const Admission &admit) {
     const char CRLF[] = "\r\n";
-    if (buff.ReadableBytes() <= 0) {
-        return false;
+    size_t headEnd = buff.Find("\r\n\r\n", 4);
+    if (headEnd == ChainBuffer::npos) {
+        return buff.ReadableBytes() > MAX_HEAD_SIZE ? BAD_REQUEST : NO_REQUEST;
     }
-    while (buff.ReadableBytes() && state_ != FINISH) {
-        const char *lineEnd = search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
-        std::string line(buff.Peek(), lineEnd);
-        switch (state_) {
-            case REQUEST_LINE:
-                if (!ParseRequestLine_(line)) {
-                    return false;
-                }
-                ParsePath_();
-                break;
-            case HEADERS:
-                ParseHeader_(line);
-                if (buff.ReadableBytes() <= 2) {
-                    state_ = FINISH;
-                }
-                break;
-            case BODY:
-                ParseBody_(line);
-                break;
-            default:
-                break;
+    // 逐行解析到空行为止，请求体按Content-Length取，后面可能紧跟着流水线上的下一个请求
+    size_t pos = 0;
+    while (state_ != BODY) {
+        size_t lineEnd = buff.Find(CRLF, 2, pos);
+        std::string line = buff.Substr(pos, lineEnd - pos);
+        pos = lineEnd + 2;
+        if (state_ == REQUEST_LINE) {
+            if (!ParseRequestLine_(line)) {
+                return BAD_REQUEST;
+            }
+            ParsePath_();
+        } else {
+            ParseHeader_(line);
         }
-        if (lineEnd == buff.BeginWrite()) {
-            break;
+    }
+    bodyLen_ = ContentLength_();
+    if (bodyLen_ > MAX_BODY_SIZE) {
+        return BAD_REQUEST;
+    }
+    if (buff.ReadableBytes() < pos + bodyLen_) {
+        return NO_REQUEST;
+    }
+    if (admit && !admit(*this)) {
+        buff.Retrieve(pos + bodyLen_);
+        return REFUSED_REQUEST;
+    }
+    buff.Retrieve(pos);
+    // 没有请求体（GET或者Content-Length为0）就不用再读了
+    if (bodyLen_ > 0) {
+        bool ok = ParseBody_(buff.Substr(0, bodyLen_));
+        buff.Retrieve(bodyLen_);
+        if (!ok) {
+            return BAD_REQUEST;
         }
-        buff.RetrieveUntil(lineEnd + 2);
     }
+    state_ = FINISH;
     LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
-    return true;
+    return GET_REQUEST;
 }
 
 // 解析请求的路径，设置主页面为index.html，其他页面则加上.html，比如请求路径为/log，则转为/log.html
@@ -84,6 +103,7 @@ bool HttpRequest::ParseRequestLine_(const string &line) {
         method_ = subMatch[1];
         path_ = subMatch[2];
         version_ = subMatch[3];
+        line_ = line;
         state_ = HEADERS;
         return true;
     }
@@ -103,33 +123,74 @@ void HttpRequest::ParseHeader_(const string &line) {
     }
 }
 
-void HttpRequest::ParseKv() {
+// 头部的名字不区分大小写，没有Content-Length说明没有请求体
+size_t HttpRequest::ContentLength_() const {
+    for (auto &item : header_) {
+        if (strcasecmp(item.first.c_str(), "Content-Length") == 0) {
+            return strtoul(item.second.c_str(), nullptr, 10);
+        }
+    }
+    return 0;
+}
+
+// 执行请求体中的kv操作，不是kv命令的请求体（比如登录的表单）直接忽略
+// 命令的参数个数不对时什么都不做，返回false，由调用者回复400
+bool HttpRequest::ParseKv() {
     stringstream ss;
     ss << body_;
     std::string temp;
     while (ss >> temp) {
         kvOp.push_back(temp);
     }
+    if (kvOp.empty()) {
+        return true;
+    }
+    Histogram::Clock::time_point start = Histogram::Clock::now();
+    Histogram *latency = nullptr;
+    bool ok = true;
     if (kvOp[0] == "set") {
-        kv_req->set(kvOp[1], kvOp[2]);
-        value = "OK";
+        ok = kvOp.size() == 3;
+        if (ok) {
+            kv_req->set(kvOp[1], kvOp[2]);
+            value = "OK";
+            latency = &kvSetSeconds;
+        }
     } else if (kvOp[0] == "del") {
-        kv_req->del(kvOp[1]);
-        value = "OK";
+        ok = kvOp.size() == 2;
+        if (ok) {
+            kv_req->del(kvOp[1]);
+            value = "OK";
+            latency = &kvDelSeconds;
+        }
     } else if (kvOp[0] == "get") {
-        value = kv_req->get(kvOp[1]);
+        ok = kvOp.size() == 2;
+        if (ok) {
+            value = kv_req->get(kvOp[1]);
+            latency = &kvGetSeconds;
+        }
+    }
+    if (latency) {
+        latency->RecordSince(start);
+    }
+    if (!ok) {
+        LOG_WARN("Bad kv request: %s", body_.c_str());
     }
     kvOp.clear();
+    return ok;
 }
 
-// 解析请求内容
-void HttpRequest::ParseBody_(const string &line) {
-    body_ = line;
+// 解析请求内容，kv命令格式错误时返回false
+bool HttpRequest::ParseBody_(string &&body) {
+    body_ = std::move(body);
+    if (trace_) {
+        trace_->Mark(RequestTrace::PARSE);
+    }
     // cout << "body: " << body_ << endl;
     ParsePost_();
-    ParseKv();
+    bool ok = ParseKv();
     state_ = FINISH;
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+    LOG_DEBUG("Body:%s, len:%d", body_.c_str(), body_.size());
+    return ok;
 }
 
 // 字符->十六进制
@@ -149,13 +210,10 @@ void HttpRequest::ParsePost_() {
         if (DEFAULT_HTML_TAG.count(path_)) {
             int tag = DEFAULT_HTML_TAG.find(path_)->second;
             LOG_DEBUG("Tag:%d", tag);
+            // 登录和注册需要查数据库，这里只记下来，由调用者异步验证之后再调用FinishVerify
             if (tag == 0 || tag == 1) {
-                bool isLogin = (tag == 1);
-                if (UserVerify(post_["username"], post_["password"], isLogin)) {
-                    path_ = "/welcome.html";
-                } else {
-                    path_ = "/error.html";
-                }
+                needVerify_ = true;
+                verifyLogin_ = (tag == 1);
             }
         }
     }
@@ -213,78 +271,10 @@ void HttpRequest::ParseFromUrlencoded_() {
     }
 }
 
-// 根据用户名和密码判断是否有这个用户，如果有则验证，没有则注册
-bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin) {
-    if (name == "" || pwd == "") {
-        return false;
-    }
-    LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
-    MYSQL *sql;
-    SqlConnRAII(&sql, SqlConnPool::Instance());
-    assert(sql);
-
-    bool flag = false;
-    unsigned int j = 0;
-    char order[256] = {0};
-    MYSQL_FIELD *fields = nullptr;
-    MYSQL_RES *res = nullptr;
-    // 若不是登录，则flag为true，代表注册
-    if (!isLogin) {
-        flag = true;
-    }
-    // 根据用户名去数据库查询
-    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1",
-             name.c_str());
-    LOG_DEBUG("%s", order);
-
-    if (mysql_query(sql, order)) {
-        mysql_free_result(res);
-        return false;
-    }
-    res = mysql_store_result(sql);
-    j = mysql_num_fields(res);
-    fields = mysql_fetch_fields(res);
-    // 根据查询结果来判断
-    while (MYSQL_ROW row = mysql_fetch_row(res)) {
-        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
-        string password(row[1]);
-        // 如果正在登录状态
-        if (isLogin) {
-            // 如果密码正确，则flag为true，代表通过
-            if (pwd == password) {
-                flag = true;
-            }
-            // 密码错误
-            else {
-                flag = false;
-                LOG_DEBUG("pwd error!");
-            }
-        }
-        // 不是登录状态，代表当前请求时注册，但是这个用户名之前已经有了，代表用户名重复
-        else {
-            flag = false;
-            LOG_DEBUG("user used!");
-        }
-    }
-    mysql_free_result(res);
-
-    // 代表注册
-    if (!isLogin && flag == true) {
-        LOG_DEBUG("regirster!");
-        bzero(order, 256);
-        snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(),
-                 pwd.c_str());
-        LOG_DEBUG("%s", order);
-        if (mysql_query(sql, order)) {
-            LOG_DEBUG("Insert error!");
-            flag = false;
-        }
-        flag = true;
-    }
-    // 这个连接池用的很离谱，先用了RALL，但是马上就销毁，最后又手工free？
-    SqlConnPool::Instance()->FreeConn(sql);
-    LOG_DEBUG("UserVerify success!!");
-    return flag;
+// 数据库验证完成之后由连接所在的线程调用，根据结果决定返回的页面
+void HttpRequest::FinishVerify(bool ok) {
+    needVerify_ = false;
+    path_ = ok ? "/welcome.html" : "/error.html";
 }
 
 std::string HttpRequest::path() const { return path_; }
@@ -29,6 +29,8 @@ const unordered_map<int, string> HttpResponse::CODE_STATUS = {
     {400, "Bad Request"},
     {403, "Forbidden"},
     {404, "Not Found"},
+    {405, "Method Not Allowed"},
+    {429, "Too Many Requests"},
 };
 
 const unordered_map<int, string> HttpResponse::CODE_PATH = {
@@ -77,6 +79,12 @@ void HttpResponse::MakeResponse(Buffer &buff) {
     AddContent_(buff);
 }
 
+// 服务器生成的内容（不对应文件），只写状态行和头部，Content-length和内容由调用者添加
+void HttpResponse::MakeHead(Buffer &buff, const string &contentType) {
+    AddStateLine_(buff);
+    AddHeader_(buff, contentType);
+}
+
 char *HttpResponse::File() { return mmFile_; }
 
 size_t HttpResponse::FileLen() const { return mmFileStat_.st_size; }
@@ -102,7 +110,9 @@ void HttpResponse::AddStateLine_(Buffer &buff) {
 }
 
 // 添加头部
-void HttpResponse::AddHeader_(Buffer &buff) {
+void HttpResponse::AddHeader_(Buffer &buff) { AddHeader_(buff, GetFileType_()); }
+
+void HttpResponse::AddHeader_(Buffer &buff, const string &contentType) {
     buff.Append("Connection: ");
     
     if (isKeepAlive_) {
@@ -111,7 +121,7 @@ void HttpResponse::AddHeader_(Buffer &buff) {
     } else {
         buff.Append("close\r\n");
     }
-    buff.Append("Content-type: " + GetFileType_() + "\r\n");
+    buff.Append("Content-type: " + contentType + "\r\n");
 }
 
 // 添加内容
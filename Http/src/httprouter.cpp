@@ -0,0 +1,39 @@
+#include "Http/httprouter.hpp"
+#include "Http/httprequest.hpp"
+using namespace std;
+
+std::atomic<const HttpRouter::Routes *> HttpRouter::routes_{nullptr};
+std::mutex HttpRouter::mtx_;
+std::vector<std::unique_ptr<HttpRouter::Routes>> HttpRouter::versions_;
+
+void HttpRouter::Register(const string &path, Handler handler, int flags) {
+    lock_guard<mutex> locker(mtx_);
+    const Routes *current = routes_.load(memory_order_relaxed);
+    unique_ptr<Routes> next(current ? new Routes(*current) : new Routes());
+    (*next)[path] = Route{std::move(handler), flags};
+    routes_.store(next.get(), memory_order_release);
+    versions_.push_back(std::move(next));
+}
+
+bool HttpRouter::Dispatch(const HttpRequest &request, int *code, string *body,
+                          string *contentType) {
+    const Routes *routes = routes_.load(memory_order_acquire);
+    if (!routes) {
+        return false;
+    }
+    auto it = routes->find(request.path());
+    if (it == routes->end()) {
+        return false;
+    }
+    const Route &route = it->second;
+    if ((route.flags & LOCAL_ONLY) && !request.IsLocal()) {
+        *code = 403;
+        *body = "forbidden\n";
+    } else if ((route.flags & POST_ONLY) && request.method() != "POST") {
+        *code = 405;
+        *body = "use POST\n";
+    } else {
+        *code = route.handler(request, *body, *contentType);
+    }
+    return true;
+}
@@ -0,0 +1,207 @@
+#include "Http/tlscontext.hpp"
+#include <errno.h>
+#include <limits.h>
+#include "Log/log.hpp"
+#include "Metrics/metrics.hpp"
+
+#ifdef HTTP_HAVE_TLS
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#endif
+
+using namespace std;
+
+TlsContext *TlsContext::Instance() {
+    static TlsContext context;
+    return &context;
+}
+
+#ifdef HTTP_HAVE_TLS
+
+static Counter fullHandshakes("tls_handshakes_total", "Completed TLS handshakes", "type=\"full\"");
+static Counter resumedHandshakes("tls_handshakes_total", "Completed TLS handshakes",
+                                 "type=\"resumed\"");
+static Counter handshakeErrors("tls_handshake_errors_total", "TLS handshakes that failed");
+static Counter ktlsSend("tls_ktls_connections_total", "TLS connections offloaded to kernel TLS",
+                        "dir=\"send\"");
+static Counter ktlsRecv("tls_ktls_connections_total", "TLS connections offloaded to kernel TLS",
+                        "dir=\"recv\"");
+
+namespace {
+    string LastError() {
+        char buf[256];
+        unsigned long code = ERR_get_error();
+        if (code == 0) {
+            return "unknown error";
+        }
+        ERR_error_string_n(code, buf, sizeof(buf));
+        ERR_clear_error();
+        return buf;
+    }
+} // namespace
+
+TlsContext::~TlsContext() { SSL_CTX_free(ctx_); }
+
+bool TlsContext::Init(const string &certFile, const string &keyFile, bool ktls,
+                      int sessionCacheSize, int sessionTimeoutSec, string *err) {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) {
+        *err = LastError();
+        return false;
+    }
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    if (SSL_CTX_use_certificate_chain_file(ctx, certFile.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, keyFile.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx) != 1) {
+        *err = certFile + "/" + keyFile + ": " + LastError();
+        SSL_CTX_free(ctx);
+        return false;
+    }
+    // 写的时候buffer的位置会变（Buffer扩容、ChainBuffer换块），允许只写一部分
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                              SSL_MODE_RELEASE_BUFFERS);
+    if (ktls) {
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+    }
+    // 会话复用：TLS1.2用session id查服务端缓存，TLS1.3和支持ticket的客户端用ticket
+    static const unsigned char SESSION_CONTEXT[] = "myServer";
+    SSL_CTX_set_session_id_context(ctx, SESSION_CONTEXT, sizeof(SESSION_CONTEXT) - 1);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, sessionCacheSize);
+    SSL_CTX_set_timeout(ctx, sessionTimeoutSec);
+    SSL_CTX_set_num_tickets(ctx, 1);
+
+    SSL_CTX_free(ctx_);
+    ctx_ = ctx;
+    return true;
+}
+
+ssl_st *TlsContext::NewSsl(int fd) {
+    if (!ctx_) {
+        return nullptr;
+    }
+    SSL *ssl = SSL_new(ctx_);
+    if (!ssl) {
+        return nullptr;
+    }
+    if (SSL_set_fd(ssl, fd) != 1) {
+        SSL_free(ssl);
+        return nullptr;
+    }
+    SSL_set_accept_state(ssl);
+    return ssl;
+}
+
+void TlsConn::Start(ssl_st *ssl) {
+    Reset();
+    ssl_ = ssl;
+}
+
+// 不发close_notify，连接马上就要close了；标记为已经关闭，否则SSL_free会把会话从缓存中删掉
+void TlsConn::Reset() {
+    if (ssl_) {
+        SSL_set_shutdown(ssl_, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    }
+    SSL_free(ssl_);
+    ssl_ = nullptr;
+    established_ = ktlsSend_ = ktlsRecv_ = false;
+}
+
+int TlsConn::Handshake(bool *wantWrite) {
+    ERR_clear_error();
+    int ret = SSL_do_handshake(ssl_);
+    if (ret == 1) {
+        established_ = true;
+#ifndef OPENSSL_NO_KTLS
+        ktlsSend_ = BIO_get_ktls_send(SSL_get_wbio(ssl_));
+        ktlsRecv_ = BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+#endif
+        (SSL_session_reused(ssl_) ? resumedHandshakes : fullHandshakes).Add();
+        if (ktlsSend_) {
+            ktlsSend.Add();
+        }
+        if (ktlsRecv_) {
+            ktlsRecv.Add();
+        }
+        return 1;
+    }
+    int code = SSL_get_error(ssl_, ret);
+    if (code == SSL_ERROR_WANT_READ || code == SSL_ERROR_WANT_WRITE) {
+        *wantWrite = (code == SSL_ERROR_WANT_WRITE);
+        return 0;
+    }
+    handshakeErrors.Add();
+    LOG_DEBUG("TLS handshake error: %s", LastError().c_str());
+    return -1;
+}
+
+ssize_t TlsConn::Read(char *buf, size_t len) {
+    ERR_clear_error();
+    int ret = SSL_read(ssl_, buf, static_cast<int>(min<size_t>(len, INT_MAX)));
+    if (ret > 0) {
+        return ret;
+    }
+    int code = SSL_get_error(ssl_, ret);
+    if (code == SSL_ERROR_ZERO_RETURN) {
+        return 0;
+    }
+    errno = (code == SSL_ERROR_WANT_READ || code == SSL_ERROR_WANT_WRITE) ? EAGAIN : ECONNRESET;
+    return -1;
+}
+
+// 每一段单独SSL_write，某一段没有写完就返回已经写了的字节数
+ssize_t TlsConn::Writev(const struct iovec *iov, int iovCnt) {
+    ssize_t total = 0;
+    for (int i = 0; i < iovCnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+        ERR_clear_error();
+        int len = static_cast<int>(min<size_t>(iov[i].iov_len, INT_MAX));
+        int ret = SSL_write(ssl_, iov[i].iov_base, len);
+        if (ret <= 0) {
+            if (total > 0) {
+                return total;
+            }
+            int code = SSL_get_error(ssl_, ret);
+            errno = (code == SSL_ERROR_WANT_WRITE || code == SSL_ERROR_WANT_READ) ? EAGAIN : EPIPE;
+            return -1;
+        }
+        total += ret;
+        if (ret < len) {
+            break;
+        }
+    }
+    return total;
+}
+
+int TlsConn::Pending() const { return ssl_ ? SSL_pending(ssl_) : 0; }
+
+#else // HTTP_HAVE_TLS
+
+TlsContext::~TlsContext() {}
+
+bool TlsContext::Init(const string &, const string &, bool, int, int, string *err) {
+    *err = "built without OpenSSL";
+    return false;
+}
+
+ssl_st *TlsContext::NewSsl(int) { return nullptr; }
+
+void TlsConn::Start(ssl_st *) {}
+void TlsConn::Reset() {}
+int TlsConn::Handshake(bool *) { return -1; }
+
+ssize_t TlsConn::Read(char *, size_t) {
+    errno = ENOTSUP;
+    return -1;
+}
+
+ssize_t TlsConn::Writev(const struct iovec *, int) {
+    errno = ENOTSUP;
+    return -1;
+}
+
+int TlsConn::Pending() const { return 0; }
+
+#endif // HTTP_HAVE_TLS
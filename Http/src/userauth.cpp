@@ -0,0 +1,161 @@
+#include "Http/userauth.hpp"
+#include "Metrics/metrics.hpp"
+using namespace std;
+
+static CallbackCounter cacheHits("auth_cache_hits_total", "Logins answered by the credential cache",
+                                 [] { return static_cast<double>(UserAuth::Cache().Hits()); });
+static CallbackCounter cacheMisses("auth_cache_misses_total", "Logins that had to query MySQL",
+                                   [] { return static_cast<double>(UserAuth::Cache().Misses()); });
+
+static const char *SELECT_PASSWORD = "SELECT password FROM user WHERE username=? LIMIT 1";
+static const char *INSERT_USER = "INSERT INTO user(username, password) VALUES(?,?)";
+
+int UserAuth::Lookup_(MYSQL *sql, const string &name, string *password) {
+    SqlStmtCache *cache = SqlConnPool::Instance()->GetStmtCache(sql);
+    MYSQL_STMT *stmt = cache ? cache->Get(SELECT_PASSWORD) : nullptr;
+    if (!stmt) {
+        return -1;
+    }
+    SqlBinds param(1), result(1);
+    char buf[256];
+    param.SetParam(0, name);
+    result.SetResult(0, buf, sizeof(buf));
+    if (mysql_stmt_bind_param(stmt, param.Data()) || mysql_stmt_bind_result(stmt, result.Data())
+        || mysql_stmt_execute(stmt) || mysql_stmt_store_result(stmt)) {
+        LOG_DEBUG("Select error: %s", mysql_stmt_error(stmt));
+        return -1;
+    }
+    int found = 0;
+    int ret = mysql_stmt_fetch(stmt);
+    if (ret == 0 || ret == MYSQL_DATA_TRUNCATED) {
+        found = 1;
+        // 比缓冲区还长的不是合法的密码，留空，和任何输入都不会相等
+        if (ret == 0) {
+            password->assign(buf, result.Length(0));
+        }
+    } else if (ret != MYSQL_NO_DATA) {
+        found = -1;
+    }
+    mysql_stmt_free_result(stmt);
+    return found;
+}
+
+bool UserAuth::Insert_(MYSQL *sql, const string &name, const string &pwd) {
+    SqlStmtCache *cache = SqlConnPool::Instance()->GetStmtCache(sql);
+    MYSQL_STMT *stmt = cache ? cache->Get(INSERT_USER) : nullptr;
+    if (!stmt) {
+        return false;
+    }
+    SqlBinds param(2);
+    param.SetParam(0, name);
+    param.SetParam(1, pwd);
+    if (mysql_stmt_bind_param(stmt, param.Data()) || mysql_stmt_execute(stmt)) {
+        LOG_DEBUG("Insert error: %s", mysql_stmt_error(stmt));
+        return false;
+    }
+    return true;
+}
+
+std::atomic<SqlBatchInserter *> UserAuth::inserter_(nullptr);
+
+// 批量插入之前在同一个DB任务中查重，用户名已经有了（或者查询出错）的行不插入
+std::unique_ptr<SqlBatchInserter> UserAuth::NewInserter() {
+    return std::make_unique<SqlBatchInserter>(
+        "user", std::vector<std::string>{"username", "password"}, 64, 2,
+        [](MYSQL *sql, const SqlBatchInserter::Row &row) {
+            string password;
+            return sql && Lookup_(sql, row[0], &password) == 0;
+        });
+}
+
+void UserAuth::SetInserter(SqlBatchInserter *inserter) {
+    inserter_.store(inserter, std::memory_order_release);
+}
+
+// 最多缓存4096个用户，存在的用户缓存60秒，不存在的缓存5秒
+CredentialCache &UserAuth::Cache() {
+    static CredentialCache cache(4096, chrono::seconds(60), chrono::seconds(5));
+    return cache;
+}
+
+// 根据用户名和密码判断是否有这个用户，如果有则验证，没有则注册
+bool UserAuth::Verify(MYSQL *sql, const string &name, const string &pwd, bool isLogin) {
+    if (name == "" || pwd == "" || !sql) {
+        return false;
+    }
+    LOG_INFO("Verify name:%s", name.c_str());
+
+    string password;
+    int found = Lookup_(sql, name, &password);
+    if (found < 0) {
+        return false;
+    }
+    // 登录：用户存在并且密码正确，查到的结果放进缓存
+    if (isLogin) {
+        if (found == 0) {
+            Cache().PutUnknown(name);
+            LOG_DEBUG("user not found!");
+            return false;
+        }
+        Cache().Put(name, password);
+        if (!CredentialCache::SecretEqual(pwd, password)) {
+            LOG_DEBUG("pwd error!");
+            return false;
+        }
+        return true;
+    }
+    // 注册：用户名之前已经有了，代表用户名重复
+    if (found == 1) {
+        LOG_DEBUG("user used!");
+        return false;
+    }
+    LOG_DEBUG("regirster!");
+    Cache().Erase(name);
+    if (!Insert_(sql, name, pwd)) {
+        return false;
+    }
+    Cache().Put(name, pwd);
+    return true;
+}
+
+void UserAuth::VerifyAsync(const string &name, const string &pwd, bool isLogin,
+                           function<void(bool)> done) {
+    CredentialCache::Result cached = Cache().Check(name, pwd);
+    if (isLogin) {
+        // 缓存命中直接返回，不需要经过DB线程
+        if (cached != CredentialCache::MISS) {
+            done(cached == CredentialCache::MATCH);
+            return;
+        }
+        SqlExecutor::Instance()->Submit([name, pwd, done = std::move(done)](MYSQL *sql) {
+            done(Verify(sql, name, pwd, true));
+        });
+        return;
+    }
+    // 缓存中已经有这个用户了，用户名重复
+    if (cached == CredentialCache::MATCH || cached == CredentialCache::MISMATCH) {
+        done(false);
+        return;
+    }
+    if (name == "" || pwd == "") {
+        done(false);
+        return;
+    }
+    // 注册：交给合并写入器，查重和插入在同一个DB任务中；没有合并写入器时由Verify一次做完
+    SqlBatchInserter *inserter = inserter_.load(std::memory_order_acquire);
+    if (!inserter) {
+        SqlExecutor::Instance()->Submit([name, pwd, done = std::move(done)](MYSQL *sql) {
+            done(Verify(sql, name, pwd, false));
+        });
+        return;
+    }
+    // 先去掉负缓存，插入成功之后再放进缓存，刚注册的用户马上就能登录
+    LOG_DEBUG("regirster!");
+    Cache().Erase(name);
+    inserter->Add({name, pwd}, [name, pwd, done = std::move(done)](bool ok) {
+        if (ok) {
+            Cache().Put(name, pwd);
+        }
+        done(ok);
+    });
+}
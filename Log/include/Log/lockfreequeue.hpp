@@ -0,0 +1,293 @@
+#ifndef LOCKFREE_QUEUE_H
+#define LOCKFREE_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdint.h>
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+/*
+有界的无锁队列，作为BlockDeque的补充，容量向上取整到2的幂
+1. SpscQueue：单生产者单消费者，head_和tail_各自只被一方修改，
+   双方还各自缓存了对方的下标，只有看起来满了/空了才去读对方的cache line
+2. MpscQueue：多生产者单消费者（Vyukov的有界队列），每个槽有自己的序号，
+   生产者之间通过CAS抢tail_，消费者不需要原子操作就能推进head_
+3. QueueNotifier：基于eventfd的阻塞等待，消费者睡眠之前Arm，生产者只在消费者Arm之后才写eventfd，
+   消费者醒着的时候生产者不需要系统调用
+两种队列都只提供Try操作，满了/空了由调用者决定是等待还是丢弃
+*/
+
+namespace lockfree {
+    constexpr size_t CACHE_LINE = 64;
+
+    inline size_t RoundUpPow2(size_t n) {
+        size_t size = 2;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+} // namespace lockfree
+
+template <class T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity)
+        : mask_(lockfree::RoundUpPow2(capacity) - 1), slots_(mask_ + 1) {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        cachedHead_ = cachedTail_ = 0;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // 生产者：拿到一个空闲的槽，直接在槽中构造数据，满了返回nullptr
+    T *BeginPush() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ > mask_) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ > mask_) {
+                return nullptr;
+            }
+        }
+        return &slots_[tail & mask_];
+    }
+
+    // 生产者：提交BeginPush拿到的槽
+    void CommitPush() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    template <class U>
+    bool TryPush(U &&item) {
+        T *slot = BeginPush();
+        if (!slot) {
+            return false;
+        }
+        *slot = std::forward<U>(item);
+        CommitPush();
+        return true;
+    }
+
+    // 消费者：拿到最早的一个，空的时候返回nullptr
+    T *Front() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_) {
+                return nullptr;
+            }
+        }
+        return &slots_[head & mask_];
+    }
+
+    // 消费者：释放Front拿到的槽
+    void Pop() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    bool TryPop(T &item) {
+        T *slot = Front();
+        if (!slot) {
+            return false;
+        }
+        item = std::move(*slot);
+        Pop();
+        return true;
+    }
+
+    // 消费者：一次最多取出max个，对每个调用func，只在最后更新一次head_
+    template <class Func>
+    size_t PopBatch(Func &&func, size_t max) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        size_t n = std::min(tail - head, max);
+        for (size_t i = 0; i < n; i++) {
+            func(slots_[(head + i) & mask_]);
+        }
+        if (n > 0) {
+            head_.store(head + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+    bool Empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    size_t SizeApprox() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    size_t Capacity() const { return mask_ + 1; }
+
+private:
+    const size_t mask_;
+    std::vector<T> slots_;
+    alignas(lockfree::CACHE_LINE) std::atomic<size_t> head_;
+    size_t cachedTail_; // 消费者看到的tail_
+    alignas(lockfree::CACHE_LINE) std::atomic<size_t> tail_;
+    size_t cachedHead_; // 生产者看到的head_
+    char pad_[lockfree::CACHE_LINE - sizeof(size_t)];
+};
+
+template <class T>
+class MpscQueue {
+public:
+    explicit MpscQueue(size_t capacity)
+        : mask_(lockfree::RoundUpPow2(capacity) - 1), cells_(new Cell[mask_ + 1]) {
+        for (size_t i = 0; i <= mask_; i++) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        tail_.store(0, std::memory_order_relaxed);
+        head_ = 0;
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    // 生产者：槽的序号等于pos说明空闲，CAS抢到pos之后写入数据，再把序号改为pos + 1
+    template <class U>
+    bool TryPush(U &&item) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // 满了
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::forward<U>(item);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者：槽的序号等于head_ + 1说明数据已经写好，取走之后把序号改为下一圈的head_
+    bool TryPop(T &item) {
+        Cell &cell = cells_[head_ & mask_];
+        if (cell.seq.load(std::memory_order_acquire) != head_ + 1) {
+            return false;
+        }
+        item = std::move(cell.data);
+        cell.seq.store(head_ + mask_ + 1, std::memory_order_release);
+        head_++;
+        return true;
+    }
+
+    // 消费者：一次最多取出max个，对每个调用func
+    template <class Func>
+    size_t PopBatch(Func &&func, size_t max) {
+        size_t n = 0;
+        while (n < max) {
+            Cell &cell = cells_[head_ & mask_];
+            if (cell.seq.load(std::memory_order_acquire) != head_ + 1) {
+                break;
+            }
+            func(cell.data);
+            cell.seq.store(head_ + mask_ + 1, std::memory_order_release);
+            head_++;
+            n++;
+        }
+        return n;
+    }
+
+    // 消费者：下一个槽还没有写好就认为是空的
+    bool Empty() const {
+        return cells_[head_ & mask_].seq.load(std::memory_order_acquire) != head_ + 1;
+    }
+
+    size_t Capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(lockfree::CACHE_LINE) std::atomic<size_t> tail_;
+    alignas(lockfree::CACHE_LINE) size_t head_;
+    char pad_[lockfree::CACHE_LINE - sizeof(size_t)];
+};
+
+/*
+消费者：Arm() -> 再检查一次队列 -> 仍然为空才Wait()（或者把Fd()放进epoll）
+生产者：入队 -> Notify()
+Arm和Notify中的全屏障保证：要么消费者再检查时能看到刚入队的数据，要么生产者能看到armed_并写eventfd
+*/
+class QueueNotifier {
+public:
+    QueueNotifier() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        assert(fd_ >= 0);
+        armed_.store(false, std::memory_order_relaxed);
+    }
+
+    ~QueueNotifier() { close(fd_); }
+
+    QueueNotifier(const QueueNotifier &) = delete;
+    QueueNotifier &operator=(const QueueNotifier &) = delete;
+
+    int Fd() const { return fd_; }
+
+    // 生产者：消费者Arm过才写eventfd，多个生产者只有一个会写
+    void Notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (armed_.load(std::memory_order_relaxed) && armed_.exchange(false)) {
+            Wake();
+        }
+    }
+
+    // 不管消费者是否Arm都写eventfd（比如要求消费者退出时）
+    void Wake() {
+        uint64_t one = 1;
+        ssize_t ret = write(fd_, &one, sizeof(one));
+        (void)ret;
+    }
+
+    // 消费者：准备睡眠，之后必须再检查一次队列
+    void Arm() {
+        armed_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    // 消费者：清掉eventfd的计数
+    void Drain() {
+        uint64_t cnt = 0;
+        ssize_t ret = read(fd_, &cnt, sizeof(cnt));
+        (void)ret;
+    }
+
+    // 消费者：等到被唤醒或者超时，返回是否被唤醒
+    bool Wait(int timeoutMs) {
+        struct pollfd pfd = {fd_, POLLIN, 0};
+        int n = 0;
+        do {
+            n = poll(&pfd, 1, timeoutMs);
+        } while (n < 0 && errno == EINTR);
+        if (n > 0) {
+            Drain();
+        }
+        return n > 0;
+    }
+
+private:
+    int fd_;
+    std::atomic<bool> armed_;
+};
+
+#endif // LOCKFREE_QUEUE_H
@@ -3,72 +3,160 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
 #include <sys/time.h>
 #include <string.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
-#include "Log/blockqueue.hpp"
-#include "Buffer/buffer.hpp"
+#include "Log/logring.hpp"
+#include "Log/logcodec.hpp"
+#include "Log/logarchiver.hpp"
+#include "Log/logsink.hpp"
 
 enum class LogLevel : int { DEBUG = 0, INFO, WARN, ERROR };
 
+// TEXT：在写日志的线程中格式化
+// DEFERRED：写日志的线程只记录格式串id和参数，由后台线程格式化成文本
+// BINARY：后台线程直接把二进制记录写到文件，用logdecoder离线还原
+enum class LogMode : int { TEXT = 0, DEFERRED, BINARY };
+
+/*
+异步日志
+1. 每个写日志的线程都有自己的LogRing，在自己的线程中格式化日志，不需要加锁
+2. 只有一个后台线程，批量地从所有LogRing中取出日志，拼成一大块之后一次write到文件
+3. 日志级别是原子变量，判断级别只需要一次relaxed load
+4. 换文件（按天或者按大小）也由后台线程完成，不会卡住写日志的线程，
+   关闭的文件交给LogArchiver在另一个线程中压缩和清理
+5. 除了日志文件，还可以通过AddSink输出到标准错误、内存环形缓冲等地方
+6. 非TEXT模式下，每个LOG_XXX调用点在第一次执行时注册自己的格式串，之后只记录id和原始参数
+maxQueueCapacity为0时是同步日志，直接在写日志的线程中加锁写文件
+*/
 class Log {
 public:
     void init(int level = 1, const char *path = "./log", const char *suffix = ".log",
-              int maxQueueCapacity = 1024);
+              int maxQueueCapacity = 1024, LogMode mode = LogMode::TEXT);
 
     static Log *Instance();
     static void FlushLogThread();
+    static uint16_t RegisterFormat(const char *format);
+
+    // 单个文件的最大字节数，保留的旧文件个数（0不限制），旧文件是否压缩，需要在init之前调用
+    void SetRotate(size_t maxFileBytes, int maxFiles = 0, bool compress = true);
+    // 增加一个额外的输出目标
+    void AddSink(std::shared_ptr<LogSink> sink);
 
     void write(int level, const char *format, ...);
     void flush();
 
-    int GetLevel();
-    void SetLevel(int level);
-    bool IsOpen() {
-        return isOpen_;
+    // 延迟格式化：只记录时间戳，格式串id和编码后的参数
+    template <class... Args>
+    void WriteDeferred(int level, uint16_t id, const Args &...args) {
+        bool async = false;
+        LogLine *line = BeginLine_(&async);
+        line->fmtId = id;
+        line->level = static_cast<uint8_t>(level);
+        int64_t usec = NowUsec_();
+        memcpy(line->data, &usec, sizeof(usec));
+        line->len = sizeof(usec)
+                    + LogCodec::Encode(line->data + sizeof(usec), LogLine::LINE_SIZE - sizeof(usec),
+                                       args...);
+        CommitLine_(line, async);
+    }
+
+    bool IsDeferred() {
+        return mode_.load(std::memory_order_relaxed) != static_cast<int>(LogMode::TEXT);
     }
 
+    int GetLevel() { return level_.load(std::memory_order_relaxed); }
+    void SetLevel(int level) { level_.store(level, std::memory_order_relaxed); }
+    bool IsOpen() { return isOpen_.load(std::memory_order_relaxed); }
+
 private:
     Log();
-    void AppendLogLevelTitle_(int level);
     virtual ~Log();
+    size_t FormatLine_(char *buf, size_t size, int level, const char *format, va_list vaList);
+    static int64_t NowUsec_();
+    LogRing *LocalRing_();
+    LogLine *BeginLine_(bool *async);
+    void CommitLine_(LogLine *line, bool async);
+    void AppendLine_(std::string &out, const LogLine &line);
     void AsyncWrite_();
+    size_t Drain_();
+    bool HasPending_();
+    void FlushBatch_();
+    void WriteOut_(const char *data, size_t len);
+    void Output_(const char *data, size_t len);
+    void RotateIfNeeded_();
+    void OpenFile_(const std::string &fileName);
+    std::string FileName_(const struct tm &t, int index);
 
 private:
     static const int LOG_PATH_LEN = 256;
     static const int LOG_NAME_LEN = 256;
-    static const int MAX_LINES = 50000;
+    static const size_t BATCH_SIZE = 64 * 1024;
+    static const int MAX_FORMATS = 8192;
+
+    static std::atomic<const char *> formats_[MAX_FORMATS];
+    static std::atomic<int> formatCount_;
 
     const char *path_;
     const char *suffix_;
 
-    int MAX_LINES_;
-
-    int lineCount_;
+    size_t maxFileBytes_;
+    size_t fileBytes_;
+    int fileIndex_;
     int toDay_;
+    std::string fileName_;
+    LogArchiver archiver_;
+    int maxFiles_;
+    bool compress_;
+
+    std::atomic<bool> isOpen_;
+    std::atomic<int> level_;
+    std::atomic<int> mode_;
+    bool isAsync_;
+    size_t ringSlots_;
 
-    bool isOpen_;
+    int fd_;
+    std::string batch_;
+    std::vector<uint8_t> emitted_; // 当前文件中已经写过的格式串
+    std::vector<std::shared_ptr<LogSink>> sinks_;
 
-    Buffer buff_;
-    int level_;
-    bool isAsync_;
+    std::vector<std::shared_ptr<LogRing>> rings_;
+    std::mutex ringsMtx_;
 
-    FILE *fp_;
-    std::unique_ptr<BlockDeque<std::string>> deque_;
     std::unique_ptr<std::thread> writeThread_;
-    std::mutex mtx_;
+    std::atomic<bool> stop_;
+    QueueNotifier notifier_; // 后台线程睡眠用
+    std::mutex mtx_;     // 保护日志文件
 };
 
-// 下方代码封装了日志的操作，给出了四种级别的日志信息，并且写完之后马上flush
+// 编译期的最低日志级别，低于它的LOG_XXX会被整个去掉，参数也不会被求值
+// Release构建默认是1（去掉DEBUG），见Log/CMakeLists.txt
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+// 下方代码封装了日志的操作，给出了四种级别的日志信息，日志由后台线程批量写入文件
+// 每个调用点有一个静态的格式串id，延迟格式化模式下只记录id和参数
 #define LOG_BASE(level, format, ...)                                                               \
     do {                                                                                           \
-        Log *log = Log::Instance();                                                                \
-        if (log->IsOpen() && log->GetLevel() <= level) {                                           \
-            log->write(level, format, ##__VA_ARGS__);                                              \
-            log->flush();                                                                          \
-        }                                                                                        \
+        if constexpr ((level) >= LOG_MIN_LEVEL) {                                                  \
+            Log *log = Log::Instance();                                                            \
+            if (log->IsOpen() && log->GetLevel() <= level) {                                       \
+                static const uint16_t logFmtId = Log::RegisterFormat(format);                      \
+                if (logFmtId != 0 && log->IsDeferred()) {                                          \
+                    log->WriteDeferred(level, logFmtId, ##__VA_ARGS__);                            \
+                } else {                                                                           \
+                    log->write(level, format, ##__VA_ARGS__);                                      \
+                }                                                                                  \
+            }                                                                                      \
+        }                                                                                          \
     } while (0);
 
 #define LOG_DEBUG(format, ...)                                                                     \
@@ -91,4 +179,4 @@ private:
         LOG_BASE(3, format, ##__VA_ARGS__)                                                         \
     } while (0);
 
-#endif
\ No newline at end of file
+#endif
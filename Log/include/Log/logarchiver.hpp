@@ -0,0 +1,45 @@
+#ifndef LOG_ARCHIVER_H
+#define LOG_ARCHIVER_H
+
+#include <mutex>
+#include <deque>
+#include <string>
+#include <thread>
+#include <memory>
+#include <condition_variable>
+
+/*
+处理已经关闭的日志文件，有自己的线程，不会卡住写日志的线程和后台写线程
+1. 压缩：编译时有zlib（LOG_HAVE_ZLIB）就把文件压缩成 文件名.gz，然后删除原文件
+2. 保留：目录中关闭的日志文件超过maxFiles个时，按修改时间删除最旧的，0表示不限制
+*/
+class LogArchiver {
+public:
+    LogArchiver();
+    ~LogArchiver();
+
+    void Start(const std::string &dir, const std::string &suffix, int maxFiles, bool compress);
+    // closed是刚刚关闭的文件，current是新打开的文件（保留时不会删除它）
+    void Submit(const std::string &closed, const std::string &current);
+    // 处理完已经提交的文件之后退出
+    void Stop();
+
+private:
+    void Run_();
+    void Compress_(const std::string &file);
+    void Retain_();
+
+    std::string dir_;
+    std::string suffix_;
+    int maxFiles_;
+    bool compress_;
+
+    std::string current_;
+    std::deque<std::string> queue_;
+    bool stop_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::unique_ptr<std::thread> thread_;
+};
+
+#endif // LOG_ARCHIVER_H
@@ -0,0 +1,127 @@
+#ifndef LOG_CODEC_H
+#define LOG_CODEC_H
+
+#include <string>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <type_traits>
+#include <algorithm>
+
+/*
+延迟格式化日志的编解码
+1. 写日志的线程只把参数按照 类型标记+原始字节 编码到LogLine中，不调用vsnprintf
+2. 后台线程（或者离线的logdecoder）再根据格式串把参数还原成文本
+字符串参数会被拷贝进来（调用返回之后指针可能就失效了），超长时截断
+二进制日志文件的格式：文件头MAGIC，之后是一条条记录，每条记录都是RecordHeader加数据
+  'F'：格式串字典，id对应的格式串，每个文件中第一次用到某个id之前写入
+  'R'：一条日志，数据是8字节的时间戳（微秒）加编码后的参数
+  'T'：已经格式化好的文本
+*/
+class LogCodec {
+public:
+    static constexpr char MAGIC[8] = {'S', 'S', 'L', 'O', 'G', 'v', '1', '\n'};
+
+    enum ArgType : char {
+        ARG_INT = 'i',
+        ARG_UINT = 'u',
+        ARG_DOUBLE = 'd',
+        ARG_STR = 's',
+        ARG_PTR = 'p',
+    };
+
+    enum RecordTag : char {
+        TAG_FORMAT = 'F',
+        TAG_RECORD = 'R',
+        TAG_TEXT = 'T',
+    };
+
+    struct RecordHeader {
+        char tag;
+        uint8_t level;
+        uint16_t id;
+        uint32_t len;
+    };
+
+    // 把参数依次编码到buf中，放不下的参数会被丢掉
+    class ArgWriter {
+    public:
+        ArgWriter(char *buf, size_t size) : buf_(buf), size_(size), pos_(0) {}
+
+        template <class T>
+        void Put(const T &v) {
+            if constexpr (std::is_enum_v<T>) {
+                Put(static_cast<std::underlying_type_t<T>>(v));
+            } else if constexpr (std::is_same_v<T, bool>) {
+                PutRaw_(ARG_INT, static_cast<int64_t>(v));
+            } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+                PutRaw_(ARG_INT, static_cast<int64_t>(v));
+            } else if constexpr (std::is_integral_v<T>) {
+                PutRaw_(ARG_UINT, static_cast<uint64_t>(v));
+            } else if constexpr (std::is_floating_point_v<T>) {
+                PutRaw_(ARG_DOUBLE, static_cast<double>(v));
+            } else if constexpr (std::is_same_v<T, std::string>) {
+                PutStr_(v.data(), v.size());
+            } else if constexpr (std::is_convertible_v<T, const char *>) {
+                const char *s = v;
+                s ? PutStr_(s, strlen(s)) : PutStr_("(null)", 6);
+            } else if constexpr (std::is_pointer_v<T>) {
+                PutRaw_(ARG_PTR, reinterpret_cast<uint64_t>(v));
+            } else {
+                static_assert(std::is_pointer_v<T>, "unsupported log argument type");
+            }
+        }
+
+        size_t Size() const { return pos_; }
+
+    private:
+        template <class V>
+        void PutRaw_(char type, V v) {
+            if (pos_ + 1 + sizeof(V) > size_) {
+                return;
+            }
+            buf_[pos_++] = type;
+            memcpy(buf_ + pos_, &v, sizeof(V));
+            pos_ += sizeof(V);
+        }
+
+        void PutStr_(const char *s, size_t len) {
+            if (pos_ + 3 > size_) {
+                return;
+            }
+            len = std::min(len, std::min(size_ - pos_ - 3, static_cast<size_t>(UINT16_MAX)));
+            uint16_t n = static_cast<uint16_t>(len);
+            buf_[pos_++] = ARG_STR;
+            memcpy(buf_ + pos_, &n, sizeof(n));
+            pos_ += sizeof(n);
+            memcpy(buf_ + pos_, s, len);
+            pos_ += len;
+        }
+
+        char *buf_;
+        size_t size_;
+        size_t pos_;
+    };
+
+    template <class... Args>
+    static size_t Encode(char *buf, size_t size, const Args &...args) {
+        ArgWriter writer(buf, size);
+        (writer.Put(args), ...);
+        return writer.Size();
+    }
+
+    // 根据格式串和编码后的参数生成文本，返回长度（不超过size - 1）
+    static size_t FormatArgs(char *out, size_t size, const char *fmt, const char *args,
+                             size_t len);
+
+    // 生成 时间 + 级别 的日志前缀，返回长度
+    static size_t FormatPrefix(char *out, size_t size, int level, int64_t usec);
+
+    // 编码一条记录的头部到out的末尾
+    static void AppendHeader(std::string &out, char tag, int level, uint16_t id, uint32_t len);
+
+    // 把一个二进制日志文件还原成文本写到out，文件损坏时返回false，err中是出错的原因
+    static bool Decode(FILE *in, FILE *out, std::string *err);
+};
+
+#endif // LOG_CODEC_H
@@ -0,0 +1,34 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <atomic>
+#include <stdint.h>
+#include "Log/lockfreequeue.hpp"
+
+// 一条日志，在写日志的线程中直接格式化到这里
+// fmtId为0时data是格式化好的文本，否则是延迟格式化的 时间戳+编码后的参数（见LogCodec）
+struct LogLine {
+    static constexpr size_t LINE_SIZE = 1016;
+    uint32_t len;
+    uint16_t fmtId;
+    uint8_t level;
+    uint8_t reserved;
+    char data[LINE_SIZE];
+};
+
+/*
+每个写日志的线程独有的环形缓冲，单生产者（写日志的线程）单消费者（后台线程）
+1. 生产者通过BeginPush拿到空闲的槽，直接格式化进去，然后CommitPush
+2. 后台线程通过Front拿到最早的一条，写完之后Pop
+线程退出时把orphaned置为true，后台线程写完剩余的日志之后就会删除这个缓冲
+*/
+class LogRing : public SpscQueue<LogLine> {
+public:
+    explicit LogRing(size_t slots) : SpscQueue<LogLine>(slots) {
+        orphaned.store(false, std::memory_order_relaxed);
+    }
+
+    std::atomic<bool> orphaned;
+};
+
+#endif // LOG_RING_H
@@ -0,0 +1,39 @@
+#ifndef LOG_SINK_H
+#define LOG_SINK_H
+
+#include <string>
+#include <memory>
+#include "Buffer/syncbuffer.hpp"
+
+/*
+日志的额外输出目标，由后台写线程（同步模式下是写日志的线程）在持有Log的文件锁时调用
+每次收到的是若干条完整的文本日志，BINARY模式下不会调用
+日志文件本身由Log负责（换文件、压缩），这里只放额外的输出
+*/
+class LogSink {
+public:
+    virtual ~LogSink() = default;
+    virtual void Write(const char *data, size_t len) = 0;
+};
+
+// 输出到标准错误
+class StderrSink : public LogSink {
+public:
+    void Write(const char *data, size_t len) override;
+};
+
+// 在内存中保留最近的日志，最多capacity字节，可以随时取出来看（比如出问题之后）
+class RingSink : public LogSink {
+public:
+    explicit RingSink(size_t capacity = 1024 * 1024) : capacity_(capacity) {}
+
+    void Write(const char *data, size_t len) override { buff_.AppendBounded(data, len, capacity_); }
+
+    std::string Snapshot() { return buff_.PeekAllToStr(); }
+
+private:
+    size_t capacity_;
+    SyncBuffer buff_;
+};
+
+#endif // LOG_SINK_H
@@ -2,181 +2,379 @@
 
 using namespace std;
 
+namespace {
+    // 线程退出时标记自己的LogRing，后台线程写完剩下的日志就会删除它
+    struct RingHolder {
+        std::shared_ptr<LogRing> ring;
+        ~RingHolder() {
+            if (ring) {
+                ring->orphaned.store(true, std::memory_order_release);
+            }
+        }
+    };
+    thread_local RingHolder tlsRing;
+} // namespace
+
+std::atomic<const char *> Log::formats_[Log::MAX_FORMATS];
+std::atomic<int> Log::formatCount_(0);
+
 Log::Log() {
-    lineCount_ = 0;
+    maxFileBytes_ = 64 * 1024 * 1024;
+    fileBytes_ = 0;
+    maxFiles_ = 0;
+    compress_ = true;
+    fileIndex_ = 0;
     isAsync_ = false;
+    ringSlots_ = 0;
     writeThread_ = nullptr;
-    deque_ = nullptr;
     toDay_ = 0;
-    fp_ = nullptr;
+    fd_ = -1;
+    path_ = suffix_ = nullptr;
+    isOpen_.store(false);
+    level_.store(1);
+    mode_.store(static_cast<int>(LogMode::TEXT));
+    stop_.store(false);
 }
 
 Log::~Log() {
     if (writeThread_ && writeThread_->joinable()) {
-        while (!deque_->empty()) {
-            deque_->flush();
-        };
-        deque_->Close();
+        stop_.store(true);
+        notifier_.Wake();
         writeThread_->join();
     }
-    if (fp_) {
+    {
         lock_guard<mutex> locker(mtx_);
-        flush();
-        fclose(fp_);
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
     }
+    archiver_.Stop();
 }
 
-int Log::GetLevel() {
+void Log::SetRotate(size_t maxFileBytes, int maxFiles, bool compress) {
     lock_guard<mutex> locker(mtx_);
-    return level_;
+    maxFileBytes_ = maxFileBytes;
+    maxFiles_ = maxFiles;
+    compress_ = compress;
 }
 
-void Log::SetLevel(int level) {
-    lock_guard<mutex> locker(mtx_);
-    level_ = level;
-}
+// 初始化日志类对象，主要是后台写线程的创建，以及日志文件的创建
+void Log::init(int level, const char *path, const char *suffix, int maxQueueSize,
+               LogMode mode) {
+    level_.store(level);
+    mode_.store(static_cast<int>(mode));
+    path_ = path;
+    suffix_ = suffix;
+
+    // 构建日志的文件和时间信息，创建对应的文件
+    time_t timer = time(nullptr);
+    struct tm t;
+    localtime_r(&timer, &t);
+    {
+        lock_guard<mutex> locker(mtx_);
+        archiver_.Start(path_, suffix_, maxFiles_, compress_);
+        toDay_ = t.tm_mday;
+        fileIndex_ = 0;
+        OpenFile_(FileName_(t, fileIndex_));
+    }
 
-// 初始化日志类对象，主要是异步相关的队列和线程的创建，以及日志文件的创建
-void Log::init(int level, const char *path, const char *suffix, int maxQueueSize) {
-    isOpen_ = true;
-    level_ = level;
-    // 如果是异步写，那么构建队列和写日志的线程
+    // 如果是异步写，那么构建写日志的线程，每个线程的缓冲有maxQueueSize条
     if (maxQueueSize > 0) {
+        ringSlots_ = maxQueueSize;
         isAsync_ = true;
-        if (!deque_) {
-            unique_ptr<BlockDeque<std::string>> newDeque(new BlockDeque<std::string>);
-            deque_ = move(newDeque);
-
-            std::unique_ptr<std::thread> NewThread(new thread(FlushLogThread));
-            writeThread_ = move(NewThread);
+        if (!writeThread_) {
+            writeThread_.reset(new thread(FlushLogThread));
         }
     } else {
         isAsync_ = false;
     }
+    isOpen_.store(true);
+}
 
-    lineCount_ = 0;
+// 日志文件名：path/年_月_日后缀，同一天的第index个文件是path/年_月_日-index后缀
+std::string Log::FileName_(const struct tm &t, int index) {
+    char name[LOG_NAME_LEN] = {0};
+    if (index == 0) {
+        snprintf(name, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s", path_, t.tm_year + 1900,
+                 t.tm_mon + 1, t.tm_mday, suffix_);
+    } else {
+        snprintf(name, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d-%d%s", path_, t.tm_year + 1900,
+                 t.tm_mon + 1, t.tm_mday, index, suffix_);
+    }
+    return name;
+}
 
-    // 构建日志的文件和时间信息，创建对应的文件
-    time_t timer = time(nullptr);
-    struct tm *sysTime = localtime(&timer);
-    struct tm t = *sysTime;
-    path_ = path;
-    suffix_ = suffix;
-    char fileName[LOG_NAME_LEN] = {0};
-    snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s", path_, t.tm_year + 1900,
-             t.tm_mon + 1, t.tm_mday, suffix_);
-    toDay_ = t.tm_mday;
-    {
-        lock_guard<mutex> locker(mtx_);
-        buff_.RetrieveAll();
-        if (fp_) {
-            flush();
-            fclose(fp_);
-        }
+// 打开日志文件，需要持有mtx_
+void Log::OpenFile_(const std::string &fileName) {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    fd_ = open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        mkdir(path_, 0777);
+        fd_ = open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+    assert(fd_ >= 0);
+    fileName_ = fileName;
+    off_t size = lseek(fd_, 0, SEEK_END);
+    fileBytes_ = size > 0 ? static_cast<size_t>(size) : 0;
+    // 新文件中的格式串字典要重新写一遍，空的二进制文件先写文件头
+    emitted_.assign(MAX_FORMATS, 0);
+    if (mode_.load() == static_cast<int>(LogMode::BINARY) && fileBytes_ == 0) {
+        WriteOut_(LogCodec::MAGIC, sizeof(LogCodec::MAGIC));
+    }
+}
 
-        fp_ = fopen(fileName, "a");
-        if (fp_ == nullptr) {
-            mkdir(path_, 0777);
-            fp_ = fopen(fileName, "a");
-        }
-        assert(fp_ != nullptr);
+// 注册一个调用点的格式串，返回它的id，id用完了返回0（退回到直接格式化）
+uint16_t Log::RegisterFormat(const char *format) {
+    int id = formatCount_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (id >= MAX_FORMATS) {
+        return 0;
     }
+    formats_[id].store(format, std::memory_order_release);
+    return static_cast<uint16_t>(id);
 }
 
-void Log::write(int level, const char *format, ...) {
+int64_t Log::NowUsec_() {
     struct timeval now = {0, 0};
     gettimeofday(&now, nullptr);
-    time_t tSec = now.tv_sec;
-    struct tm *sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
-    va_list vaList;
-
-    // 如果已经到了新的一天，则新建日志文件
-    if (toDay_ != t.tm_mday || (lineCount_ && (lineCount_ % MAX_LINES == 0))) {
-        unique_lock<mutex> locker(mtx_);
-        locker.unlock();
+    return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_usec;
+}
 
-        char newFile[LOG_NAME_LEN];
-        char tail[36] = {0};
-        snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+// 把一条日志（时间，级别，内容，换行）格式化到buf中，返回长度，超长的部分会被截断
+size_t Log::FormatLine_(char *buf, size_t size, int level, const char *format, va_list vaList) {
+    size_t len = LogCodec::FormatPrefix(buf, size, level, NowUsec_());
+    // 留一个字节给换行
+    int m = vsnprintf(buf + len, size - len - 1, format, vaList);
+    if (m > 0) {
+        len += std::min(static_cast<size_t>(m), size - len - 2);
+    }
+    buf[len++] = '\n';
+    return len;
+}
 
-        if (toDay_ != t.tm_mday) {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", path_, tail, suffix_);
-            toDay_ = t.tm_mday;
-            lineCount_ = 0;
-        } else {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", path_, tail,
-                     (lineCount_ / MAX_LINES), suffix_);
-        }
+// 当前线程的LogRing，第一次写日志时创建并注册给后台线程
+LogRing *Log::LocalRing_() {
+    if (!tlsRing.ring) {
+        tlsRing.ring = std::make_shared<LogRing>(ringSlots_);
+        lock_guard<mutex> locker(ringsMtx_);
+        rings_.push_back(tlsRing.ring);
+    }
+    return tlsRing.ring.get();
+}
 
-        locker.lock();
+// 拿到一个可以写的LogLine，异步模式下是自己LogRing中的槽，同步模式下是线程局部的缓冲
+LogLine *Log::BeginLine_(bool *async) {
+    *async = isAsync_ && !stop_.load(std::memory_order_relaxed);
+    if (!*async) {
+        static thread_local LogLine line;
+        return &line;
+    }
+    LogRing *ring = LocalRing_();
+    LogLine *line = nullptr;
+    // 缓冲满了，叫醒后台线程，等它腾出空间
+    while ((line = ring->BeginPush()) == nullptr) {
         flush();
-        fclose(fp_);
-        fp_ = fopen(newFile, "a");
-        assert(fp_ != nullptr);
+        this_thread::yield();
     }
-    // 根据可变参数列表构造要写的字符串（格式化字符串），放入Buffer中，然后一次性读到Queue中
-    {
-        unique_lock<mutex> locker(mtx_);
-        lineCount_++;
-        int n = snprintf(buff_.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
-                         t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec,
-                         now.tv_usec);
+    return line;
+}
+
+// 提交BeginLine_拿到的LogLine，同步模式下直接加锁写文件
+void Log::CommitLine_(LogLine *line, bool async) {
+    if (async) {
+        tlsRing.ring->CommitPush();
+        // 后台线程准备睡眠时才会真的写eventfd
+        notifier_.Notify();
+        return;
+    }
+    static thread_local std::string out;
+    out.clear();
+    lock_guard<mutex> locker(mtx_);
+    RotateIfNeeded_();
+    AppendLine_(out, *line);
+    Output_(out.data(), out.size());
+}
 
-        buff_.HasWritten(n);
-        AppendLogLevelTitle_(level);
+// 在当前线程中格式化日志，异步模式下放到自己的LogRing中，不需要加锁
+void Log::write(int level, const char *format, ...) {
+    va_list vaList;
+    va_start(vaList, format);
+    bool async = false;
+    LogLine *line = BeginLine_(&async);
+    line->fmtId = 0;
+    line->level = static_cast<uint8_t>(level);
+    line->len = FormatLine_(line->data, LogLine::LINE_SIZE, level, format, vaList);
+    CommitLine_(line, async);
+    va_end(vaList);
+}
 
-        va_start(vaList, format);
-        int m = vsnprintf(buff_.BeginWrite(), buff_.WritableBytes(), format, vaList);
-        va_end(vaList);
+// 把一条LogLine按照当前模式追加到out中：文本直接追加，延迟格式化的在这里还原成文本，
+// 二进制模式下写成记录，某个格式串在当前文件中第一次出现时先写它的字典记录
+void Log::AppendLine_(std::string &out, const LogLine &line) {
+    bool binary = mode_.load(std::memory_order_relaxed) == static_cast<int>(LogMode::BINARY);
+    if (line.fmtId == 0) {
+        if (binary) {
+            LogCodec::AppendHeader(out, LogCodec::TAG_TEXT, line.level, 0, line.len);
+        }
+        out.append(line.data, line.len);
+        return;
+    }
+    const char *format = formats_[line.fmtId].load(std::memory_order_acquire);
+    if (binary) {
+        if (!emitted_[line.fmtId]) {
+            uint32_t len = static_cast<uint32_t>(strlen(format));
+            LogCodec::AppendHeader(out, LogCodec::TAG_FORMAT, line.level, line.fmtId, len);
+            out.append(format, len);
+            emitted_[line.fmtId] = 1;
+        }
+        LogCodec::AppendHeader(out, LogCodec::TAG_RECORD, line.level, line.fmtId, line.len);
+        out.append(line.data, line.len);
+        return;
+    }
+    char buf[LogLine::LINE_SIZE + 64];
+    int64_t usec = 0;
+    memcpy(&usec, line.data, sizeof(usec));
+    size_t len = LogCodec::FormatPrefix(buf, sizeof(buf), line.level, usec);
+    len += LogCodec::FormatArgs(buf + len, sizeof(buf) - len - 1, format, line.data + sizeof(usec),
+                                line.len - sizeof(usec));
+    buf[len++] = '\n';
+    out.append(buf, len);
+}
 
-        buff_.HasWritten(m);
-        buff_.Append("\n\0", 2);
+// 叫醒后台写线程
+void Log::flush() { notifier_.Notify(); }
 
-        if (isAsync_ && deque_ && !deque_->full()) {
-            deque_->push_back(buff_.RetrieveAllToStr());
-        } else {
-            fputs(buff_.Peek(), fp_);
+void Log::AddSink(std::shared_ptr<LogSink> sink) {
+    lock_guard<mutex> locker(mtx_);
+    sinks_.push_back(std::move(sink));
+}
+
+// 写到文件和所有额外的输出目标中，二进制日志只写文件，需要持有mtx_
+void Log::Output_(const char *data, size_t len) {
+    WriteOut_(data, len);
+    if (sinks_.empty() || mode_.load(std::memory_order_relaxed) == static_cast<int>(LogMode::BINARY)) {
+        return;
+    }
+    for (auto &sink : sinks_) {
+        sink->Write(data, len);
+    }
+}
+
+// 写到文件中，需要持有mtx_
+void Log::WriteOut_(const char *data, size_t len) {
+    while (len > 0 && fd_ >= 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
         }
-        buff_.RetrieveAll();
+        data += n;
+        len -= n;
+        fileBytes_ += n;
     }
 }
 
-// 根据当前日志的级别写入信息到BUffer中
-void Log::AppendLogLevelTitle_(int level) {
-    switch (level) {
-        case 0:
-            buff_.Append("[debug]: ", 9);
-            break;
-        case 1:
-            buff_.Append("[info] : ", 9);
-            break;
-        case 2:
-            buff_.Append("[warn] : ", 9);
-            break;
-        case 3:
-            buff_.Append("[error]: ", 9);
-            break;
-        default:
-            buff_.Append("[info] : ", 9);
-            break;
+// 如果已经到了新的一天，或者文件超过了maxFileBytes_，则新建日志文件，需要持有mtx_
+// 只在两批日志之间检查，一批日志不会被拆到两个文件中
+// 关闭的文件交给archiver_，压缩和清理都不在这个线程中做
+void Log::RotateIfNeeded_() {
+    time_t timer = time(nullptr);
+    struct tm t;
+    localtime_r(&timer, &t);
+    if (toDay_ == t.tm_mday && fileBytes_ < maxFileBytes_) {
+        return;
+    }
+    if (toDay_ != t.tm_mday) {
+        toDay_ = t.tm_mday;
+        fileIndex_ = 0;
+    } else {
+        fileIndex_++;
     }
+    // 跳过之前已经写满（或者已经压缩）的文件
+    std::string newFile = FileName_(t, fileIndex_);
+    struct stat st;
+    while ((stat(newFile.c_str(), &st) == 0 && static_cast<size_t>(st.st_size) >= maxFileBytes_)
+           || access((newFile + ".gz").c_str(), F_OK) == 0) {
+        newFile = FileName_(t, ++fileIndex_);
+    }
+    std::string closed = fileName_;
+    OpenFile_(newFile);
+    archiver_.Submit(closed, fileName_);
 }
 
-// 通知写线程将队列中的日志都写到文件中去
-void Log::flush() {
-    if (isAsync_) {
-        deque_->flush();
+// 把攒好的一批日志写到文件中，写完之后再检查是否需要换文件
+void Log::FlushBatch_() {
+    if (batch_.empty()) {
+        return;
     }
-    fflush(fp_);
+    lock_guard<mutex> locker(mtx_);
+    Output_(batch_.data(), batch_.size());
+    batch_.clear();
+    RotateIfNeeded_();
 }
 
-// 写日志的线程，不断地从日志队列中取数据，然后写到文件中
+// 从所有线程的LogRing中取出日志，攒成BATCH_SIZE大小的一批再写，返回取出的条数
+size_t Log::Drain_() {
+    size_t total = 0;
+    lock_guard<mutex> locker(ringsMtx_);
+    {
+        lock_guard<mutex> fileLocker(mtx_);
+        RotateIfNeeded_();
+    }
+    for (auto it = rings_.begin(); it != rings_.end();) {
+        LogRing &ring = **it;
+        // 先读orphaned再取日志，保证线程退出前写的日志都能取到
+        bool orphaned = ring.orphaned.load(std::memory_order_acquire);
+        LogLine *line = nullptr;
+        while ((line = ring.Front()) != nullptr) {
+            if (batch_.size() + line->len + 64 > BATCH_SIZE) {
+                FlushBatch_();
+            }
+            AppendLine_(batch_, *line);
+            ring.Pop();
+            total++;
+        }
+        if (orphaned) {
+            it = rings_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    FlushBatch_();
+    return total;
+}
+
+// 是否还有没写的日志
+bool Log::HasPending_() {
+    lock_guard<mutex> locker(ringsMtx_);
+    for (auto &ring : rings_) {
+        if (!ring->Empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 写日志的线程，不断地从所有LogRing中取日志，然后写到文件中，没有日志时睡眠
 void Log::AsyncWrite_() {
-    string str = "";
-    while (deque_->pop(str)) {
-        lock_guard<mutex> locker(mtx_);
-        fputs(str.c_str(), fp_);
+    batch_.reserve(BATCH_SIZE);
+    while (true) {
+        if (Drain_() > 0) {
+            continue;
+        }
+        if (stop_.load()) {
+            break;
+        }
+        // Arm之后再检查一次，避免错过Arm之前刚提交的日志
+        notifier_.Arm();
+        if (HasPending_()) {
+            continue;
+        }
+        notifier_.Wait(100);
     }
 }
 
@@ -189,4 +387,4 @@ Log *Log::Instance() {
 // 写日志的线程的函数
 void Log::FlushLogThread() {
     Log::Instance()->AsyncWrite_();
-}
\ No newline at end of file
+}
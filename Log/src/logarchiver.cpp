@@ -0,0 +1,158 @@
+#include "Log/logarchiver.hpp"
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef LOG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+LogArchiver::LogArchiver() : maxFiles_(0), compress_(false), stop_(false) {}
+
+LogArchiver::~LogArchiver() { Stop(); }
+
+void LogArchiver::Start(const string &dir, const string &suffix, int maxFiles, bool compress) {
+    lock_guard<mutex> locker(mtx_);
+    dir_ = dir;
+    suffix_ = suffix;
+    maxFiles_ = maxFiles;
+#ifdef LOG_HAVE_ZLIB
+    compress_ = compress;
+#else
+    compress_ = false;
+    (void)compress;
+#endif
+    if (!thread_) {
+        stop_ = false;
+        thread_.reset(new thread(&LogArchiver::Run_, this));
+    }
+}
+
+void LogArchiver::Submit(const string &closed, const string &current) {
+    {
+        lock_guard<mutex> locker(mtx_);
+        queue_.push_back(closed);
+        current_ = current;
+    }
+    cond_.notify_one();
+}
+
+void LogArchiver::Stop() {
+    {
+        lock_guard<mutex> locker(mtx_);
+        stop_ = true;
+    }
+    cond_.notify_one();
+    if (thread_ && thread_->joinable()) {
+        thread_->join();
+    }
+    thread_.reset();
+}
+
+void LogArchiver::Run_() {
+    unique_lock<mutex> locker(mtx_);
+    while (true) {
+        cond_.wait(locker, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            break;
+        }
+        string file = std::move(queue_.front());
+        queue_.pop_front();
+        bool compress = compress_;
+        locker.unlock();
+        if (compress) {
+            Compress_(file);
+        }
+        Retain_();
+        locker.lock();
+    }
+}
+
+// 压缩到临时文件，完成之后再改名，中途退出不会留下不完整的.gz
+void LogArchiver::Compress_(const string &file) {
+#ifdef LOG_HAVE_ZLIB
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    string tmp = file + ".gz.tmp";
+    gzFile gz = gzopen(tmp.c_str(), "wb6");
+    if (!gz) {
+        close(fd);
+        return;
+    }
+    vector<char> buf(64 * 1024);
+    bool ok = true;
+    ssize_t n = 0;
+    while ((n = read(fd, buf.data(), buf.size())) > 0) {
+        if (gzwrite(gz, buf.data(), static_cast<unsigned>(n)) != n) {
+            ok = false;
+            break;
+        }
+    }
+    close(fd);
+    ok = (gzclose(gz) == Z_OK) && ok && n == 0;
+    // 和gzip一样保留原文件的修改时间，保留旧文件时按它排序
+    struct stat st;
+    if (ok && stat(file.c_str(), &st) == 0) {
+        struct timespec times[2] = {st.st_atim, st.st_mtim};
+        utimensat(AT_FDCWD, tmp.c_str(), times, 0);
+    }
+    if (ok && rename(tmp.c_str(), (file + ".gz").c_str()) == 0) {
+        unlink(file.c_str());
+    } else {
+        unlink(tmp.c_str());
+    }
+#else
+    (void)file;
+#endif
+}
+
+// 统计目录中关闭的日志文件（.log和.log.gz），超过maxFiles_时删除最旧的
+// 同一秒内可能关闭好几个文件，按纳秒级的修改时间排序
+void LogArchiver::Retain_() {
+    if (maxFiles_ <= 0) {
+        return;
+    }
+    string current;
+    {
+        lock_guard<mutex> locker(mtx_);
+        current = current_;
+    }
+    DIR *dir = opendir(dir_.c_str());
+    if (!dir) {
+        return;
+    }
+    string gzSuffix = suffix_ + ".gz";
+    auto endsWith = [](const string &s, const string &tail) {
+        return s.size() >= tail.size() && s.compare(s.size() - tail.size(), tail.size(), tail) == 0;
+    };
+    vector<pair<int64_t, string>> files;
+    struct dirent *entry = nullptr;
+    while ((entry = readdir(dir)) != nullptr) {
+        string name = entry->d_name;
+        if (!endsWith(name, suffix_) && !endsWith(name, gzSuffix)) {
+            continue;
+        }
+        string full = dir_ + "/" + name;
+        struct stat st;
+        if (full == current || stat(full.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        files.emplace_back(static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+                           full);
+    }
+    closedir(dir);
+    if (files.size() <= static_cast<size_t>(maxFiles_)) {
+        return;
+    }
+    sort(files.begin(), files.end());
+    for (size_t i = 0; i < files.size() - maxFiles_; i++) {
+        unlink(files[i].second.c_str());
+    }
+}
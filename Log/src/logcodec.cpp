@@ -0,0 +1,238 @@
+#include "Log/logcodec.hpp"
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+#include <unordered_map>
+
+namespace {
+    // 按顺序读出编码后的参数
+    class ArgReader {
+    public:
+        ArgReader(const char *buf, size_t len) : buf_(buf), len_(len), pos_(0) {}
+
+        bool Next(char *type, int64_t *i, uint64_t *u, double *d, std::string *s) {
+            if (pos_ >= len_) {
+                return false;
+            }
+            *type = buf_[pos_++];
+            switch (*type) {
+                case LogCodec::ARG_INT:
+                    return Read_(i);
+                case LogCodec::ARG_UINT:
+                case LogCodec::ARG_PTR:
+                    return Read_(u);
+                case LogCodec::ARG_DOUBLE:
+                    return Read_(d);
+                case LogCodec::ARG_STR: {
+                    uint16_t n = 0;
+                    if (!Read_(&n) || pos_ + n > len_) {
+                        return false;
+                    }
+                    s->assign(buf_ + pos_, n);
+                    pos_ += n;
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+
+    private:
+        template <class V>
+        bool Read_(V *v) {
+            if (pos_ + sizeof(V) > len_) {
+                return false;
+            }
+            memcpy(v, buf_ + pos_, sizeof(V));
+            pos_ += sizeof(V);
+            return true;
+        }
+
+        const char *buf_;
+        size_t len_;
+        size_t pos_;
+    };
+} // namespace
+
+// 逐个解析格式串中的转换说明，每个说明用对应类型的参数单独snprintf
+size_t LogCodec::FormatArgs(char *out, size_t size, const char *fmt, const char *args,
+                            size_t len) {
+    if (size == 0) {
+        return 0;
+    }
+    ArgReader reader(args, len);
+    size_t pos = 0;
+    auto put = [&](const char *s, size_t n) {
+        n = std::min(n, size - 1 - pos);
+        memcpy(out + pos, s, n);
+        pos += n;
+    };
+    char type = 0;
+    int64_t i = 0;
+    uint64_t u = 0;
+    double d = 0;
+    std::string s;
+    char tmp[512];
+    const char *p = fmt;
+    while (*p && pos < size - 1) {
+        if (*p != '%') {
+            const char *q = strchr(p, '%');
+            size_t n = q ? static_cast<size_t>(q - p) : strlen(p);
+            put(p, n);
+            p += n;
+            continue;
+        }
+        if (p[1] == '%') {
+            put("%", 1);
+            p += 2;
+            continue;
+        }
+        // 取出 %[flags][width][.precision]，*对应的int参数直接展开成数字
+        std::string spec = "%";
+        p++;
+        while (*p && strchr("-+ #0", *p)) {
+            spec += *p++;
+        }
+        for (int part = 0; part < 2; part++) {
+            if (part == 1) {
+                if (*p != '.') {
+                    break;
+                }
+                spec += *p++;
+            }
+            if (*p == '*') {
+                p++;
+                if (reader.Next(&type, &i, &u, &d, &s)) {
+                    spec += std::to_string(type == ARG_INT ? i : static_cast<int64_t>(u));
+                }
+            }
+            while (*p >= '0' && *p <= '9') {
+                spec += *p++;
+            }
+        }
+        // 长度修饰符由参数的实际类型决定
+        while (*p && strchr("hlLqjzt", *p)) {
+            p++;
+        }
+        char conv = *p ? *p++ : 0;
+        if (conv == 0) {
+            break;
+        }
+        int n = 0;
+        if (!reader.Next(&type, &i, &u, &d, &s)) {
+            n = snprintf(tmp, sizeof(tmp), "<?>");
+        } else if (strchr("diouxXc", conv) && (type == ARG_INT || type == ARG_UINT)) {
+            if (conv == 'c') {
+                n = snprintf(tmp, sizeof(tmp), (spec + 'c').c_str(),
+                             static_cast<int>(type == ARG_INT ? i : u));
+            } else if (type == ARG_INT) {
+                n = snprintf(tmp, sizeof(tmp), (spec + "ll" + conv).c_str(),
+                             static_cast<long long>(i));
+            } else {
+                n = snprintf(tmp, sizeof(tmp), (spec + "ll" + conv).c_str(),
+                             static_cast<unsigned long long>(u));
+            }
+        } else if (strchr("fFeEgGaA", conv) && type == ARG_DOUBLE) {
+            n = snprintf(tmp, sizeof(tmp), (spec + conv).c_str(), d);
+        } else if (conv == 's' && type == ARG_STR) {
+            n = snprintf(tmp, sizeof(tmp), (spec + 's').c_str(), s.c_str());
+        } else if (conv == 'p' && (type == ARG_PTR || type == ARG_UINT)) {
+            n = snprintf(tmp, sizeof(tmp), (spec + 'p').c_str(), reinterpret_cast<void *>(u));
+        } else {
+            n = snprintf(tmp, sizeof(tmp), "<?>");
+        }
+        if (n > 0) {
+            put(tmp, std::min(static_cast<size_t>(n), sizeof(tmp) - 1));
+        }
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+// 生成 时间 + 级别 的日志前缀
+// 每个线程缓存当前这一秒格式化好的日期，同一秒内只需要填微秒和级别
+size_t LogCodec::FormatPrefix(char *out, size_t size, int level, int64_t usec) {
+    static const char *titles[] = {"[debug]: ", "[info] : ", "[warn] : ", "[error]: "};
+    static const size_t TITLE_LEN = 9;
+    struct DateCache {
+        int64_t sec = -1;
+        char date[32];
+        size_t len = 0;
+    };
+    thread_local DateCache cache;
+
+    int64_t sec = usec / 1000000;
+    long micro = static_cast<long>(usec % 1000000);
+    if (sec != cache.sec) {
+        time_t tSec = sec;
+        struct tm t;
+        localtime_r(&tSec, &t);
+        int n = snprintf(cache.date, sizeof(cache.date), "%d-%02d-%02d %02d:%02d:%02d.",
+                         t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+        cache.len = static_cast<size_t>(n);
+        cache.sec = sec;
+    }
+    // 日期 + 6位微秒 + 空格 + 级别
+    if (cache.len + 7 + TITLE_LEN >= size) {
+        return 0;
+    }
+    memcpy(out, cache.date, cache.len);
+    char *p = out + cache.len;
+    for (int i = 5; i >= 0; i--) {
+        p[i] = static_cast<char>('0' + micro % 10);
+        micro /= 10;
+    }
+    p[6] = ' ';
+    memcpy(p + 7, titles[(level >= 0 && level <= 3) ? level : 1], TITLE_LEN);
+    size_t len = cache.len + 7 + TITLE_LEN;
+    out[len] = '\0';
+    return len;
+}
+
+void LogCodec::AppendHeader(std::string &out, char tag, int level, uint16_t id, uint32_t len) {
+    RecordHeader header = {tag, static_cast<uint8_t>(level), id, len};
+    out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+// 格式串字典只在本文件内有效；找不到格式串的记录跳过，err中记下原因，但不算失败
+bool LogCodec::Decode(FILE *in, FILE *out, std::string *err) {
+    char magic[sizeof(MAGIC)];
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic)
+        || memcmp(magic, MAGIC, sizeof(magic)) != 0) {
+        *err = "not a binary log file";
+        return false;
+    }
+    std::unordered_map<uint16_t, std::string> formats;
+    std::vector<char> data;
+    char line[4096];
+    RecordHeader header;
+    while (fread(&header, sizeof(header), 1, in) == 1) {
+        data.resize(header.len);
+        if (header.len > 0 && fread(data.data(), 1, header.len, in) != header.len) {
+            *err = "truncated record";
+            return false;
+        }
+        if (header.tag == TAG_FORMAT) {
+            formats[header.id].assign(data.data(), data.size());
+        } else if (header.tag == TAG_TEXT) {
+            fwrite(data.data(), 1, data.size(), out);
+        } else if (header.tag == TAG_RECORD) {
+            auto it = formats.find(header.id);
+            int64_t usec = 0;
+            if (it == formats.end() || data.size() < sizeof(usec)) {
+                *err = "bad record, id " + std::to_string(header.id);
+                continue;
+            }
+            memcpy(&usec, data.data(), sizeof(usec));
+            size_t len = FormatPrefix(line, sizeof(line), header.level, usec);
+            len += FormatArgs(line + len, sizeof(line) - len - 1, it->second.c_str(),
+                              data.data() + sizeof(usec), data.size() - sizeof(usec));
+            line[len++] = '\n';
+            fwrite(line, 1, len, out);
+        } else {
+            *err = std::string("unknown record tag '") + header.tag + "'";
+            return false;
+        }
+    }
+    return true;
+}
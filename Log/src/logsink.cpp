@@ -0,0 +1,17 @@
+#include "Log/logsink.hpp"
+#include <errno.h>
+#include <unistd.h>
+
+void StderrSink::Write(const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(STDERR_FILENO, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
@@ -0,0 +1,37 @@
+#include "Log/logcodec.hpp"
+#include <stdio.h>
+
+/*
+把BINARY模式写出的日志文件还原成文本
+用法：logdecoder <file>...，结果输出到标准输出
+*/
+
+// 解码一个文件，格式串字典只在本文件内有效
+static bool DecodeFile(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        perror(path);
+        return false;
+    }
+    std::string err;
+    bool ok = LogCodec::Decode(fp, stdout, &err);
+    if (!err.empty()) {
+        fprintf(stderr, "%s: %s\n", path, err.c_str());
+    }
+    fclose(fp);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file>...\n", argv[0]);
+        return 1;
+    }
+    int ret = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!DecodeFile(argv[i])) {
+            ret = 1;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,73 @@
+#ifndef HOT_KEYS_H
+#define HOT_KEYS_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+热点key统计：Count-Min Sketch估计每个key被访问的次数，再维护一个次数最多的K个key的列表
+1. 每个线程平均每sample次访问只记录一次，热点key对应的计数器不会被所有线程一直抢
+   间隔是随机的（1到2*sample-1），不会和有规律的访问模式对上
+2. sketch的计数器是relaxed的原子变量，不加锁；估计值超过列表中最小的次数时才加锁更新列表
+3. 记录的次数每到DECAY_EVERY就把所有计数减半，列表反映的是最近一段时间的热点
+4. 输出时用sketch重新估计列表中每个key的次数再排序
+估计值只会偏大不会偏小；计数是采样之后的，乘以sample才是大约的访问次数
+*/
+class HotKeys {
+public:
+    struct Item {
+        std::string key;
+        uint64_t count;
+    };
+
+    explicit HotKeys(size_t topK = 16, size_t width = 4096, int sample = 8);
+
+    void Record(const std::string &key) {
+        static thread_local int countdown = 0;
+        // 每个线程的种子不同，否则所有线程的采样间隔序列完全一样
+        static thread_local uint32_t seed = NextSeed_();
+        if (--countdown > 0) {
+            return;
+        }
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        countdown = 1 + static_cast<int>(seed % (2 * sample_ - 1));
+        Add(key);
+    }
+
+    // 不采样，直接计一次
+    void Add(const std::string &key);
+    uint64_t Estimate(const std::string &key) const;
+
+    // 从多到少
+    std::vector<Item> Top();
+    std::string Render();
+    void Clear();
+
+    int Sample() const { return sample_; }
+
+    static const int DEPTH = 4;
+    static const uint64_t DECAY_EVERY = 1 << 16;
+
+private:
+    static uint32_t NextSeed_();
+    void Hash_(const std::string &key, size_t *index) const;
+    void Decay_();
+
+    const size_t topK_;
+    const size_t mask_;
+    const int sample_;
+    std::unique_ptr<std::atomic<uint32_t>[]> counters_; // DEPTH行，每行mask_ + 1个
+    std::atomic<uint64_t> total_;
+
+    std::mutex mtx_; // 保护top_
+    std::vector<Item> top_;
+    std::atomic<uint64_t> minTop_; // 列表满了之后列表中最小的次数，没满时为0
+};
+
+#endif // HOT_KEYS_H
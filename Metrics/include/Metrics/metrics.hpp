@@ -0,0 +1,234 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+/*
+服务器内部的监控指标，由服务器自己以Prometheus文本格式输出（见/metrics）
+1. Counter和Histogram按线程分片，每个分片独占cache line，记录时只对当前线程的分片做relaxed的原子加，
+   不加锁，线程之间也不会抢同一个cache line
+2. 输出时才把所有分片加起来，输出的频率很低，慢一点没有关系
+3. Histogram是对数线性分桶（HDR风格），每个2的幂区间分成16个子桶，相对误差在6%左右，
+   输出时折算成固定的le边界（1-2-5序列，1微秒到10秒）
+4. Gauge由拥有数据的线程Set；CallbackGauge在输出时才调用回调取值（比如线程池的队列长度）
+5. 指标在构造时注册到MetricsRegistry，析构时注销，一般是静态变量或者对象的成员
+线程数超过分片数时几个线程共用一个分片，结果仍然是对的，只是会有一些竞争
+*/
+
+namespace metrics {
+    constexpr size_t CACHE_LINE = 64;
+    constexpr size_t SHARDS = 16;
+
+    // 当前线程使用的分片，线程第一次记录时轮流分配
+    inline size_t ShardIndex() {
+        static std::atomic<size_t> next{0};
+        thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return index;
+    }
+} // namespace metrics
+
+class Metric {
+public:
+    // labels是Prometheus的标签，比如 verb="get"，没有标签时为空
+    Metric(std::string name, std::string help, std::string labels, const char *type);
+    virtual ~Metric();
+
+    Metric(const Metric &) = delete;
+    Metric &operator=(const Metric &) = delete;
+
+    const std::string &Name() const { return name_; }
+    const std::string &Help() const { return help_; }
+    const std::string &Labels() const { return labels_; }
+    const char *Type() const { return type_; }
+
+    // 输出样本行，不包括HELP和TYPE
+    virtual void Collect(std::string &out) const = 0;
+
+protected:
+    // 输出一行：name+suffix{labels,extraLabel} value
+    void AppendSample_(std::string &out, const char *suffix, const std::string &extraLabel,
+                       double value) const;
+
+private:
+    std::string name_;
+    std::string help_;
+    std::string labels_;
+    const char *type_;
+};
+
+class Counter : public Metric {
+public:
+    Counter(std::string name, std::string help, std::string labels = "");
+
+    void Add(uint64_t n = 1) {
+        shards_[metrics::ShardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t Value() const;
+    void Collect(std::string &out) const override;
+
+private:
+    struct alignas(metrics::CACHE_LINE) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    Shard shards_[metrics::SHARDS];
+};
+
+class Gauge : public Metric {
+public:
+    Gauge(std::string name, std::string help, std::string labels = "");
+
+    void Set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void Add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+    void Collect(std::string &out) const override;
+
+private:
+    std::atomic<int64_t> value_;
+};
+
+// 输出时调用回调取值，回调在输出的线程中执行，需要自己保证线程安全
+class CallbackGauge : public Metric {
+public:
+    CallbackGauge(std::string name, std::string help, std::function<double()> func,
+                  std::string labels = "");
+
+    void Collect(std::string &out) const override;
+
+protected:
+    CallbackGauge(std::string name, std::string help, std::function<double()> func,
+                  std::string labels, const char *type);
+
+private:
+    std::function<double()> func_;
+};
+
+// 回调返回的是只增不减的累计值（比如其他模块自己维护的计数）
+class CallbackCounter : public CallbackGauge {
+public:
+    CallbackCounter(std::string name, std::string help, std::function<double()> func,
+                    std::string labels = "");
+};
+
+class Histogram : public Metric {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 所有分片合并之后的结果
+    struct Snapshot {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum = 0; // 纳秒
+        uint64_t max = 0;
+
+        // 返回q分位所在桶的上界（纳秒），q在[0, 1]之间
+        uint64_t Percentile(double q) const;
+        // 不超过ns的记录数，落在ns所在桶中的记录不算
+        uint64_t CountBelow(uint64_t ns) const;
+    };
+
+    Histogram(std::string name, std::string help, std::string labels = "");
+
+    // 记录一个耗时（纳秒）
+    void Record(uint64_t ns) {
+        Shard &shard = shards_[metrics::ShardIndex()];
+        shard.buckets[Index_(ns)].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t max = shard.max.load(std::memory_order_relaxed);
+        while (ns > max && !shard.max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    void RecordSince(Clock::time_point start) {
+        Record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+
+    Snapshot Snap() const;
+    void Collect(std::string &out) const override;
+
+    static const int SUB_BITS = 4;
+    static const uint64_t SUB = 1 << SUB_BITS;
+    static const int MAX_EXP = 40; // 超过2^41纳秒（大约36分钟）的记在最后一个桶
+    static const size_t BUCKETS = (MAX_EXP - SUB_BITS + 2) * SUB;
+
+    static size_t Index_(uint64_t v) {
+        if (v < SUB) {
+            return v;
+        }
+        int exp = 63 - __builtin_clzll(v);
+        if (exp > MAX_EXP) {
+            return BUCKETS - 1;
+        }
+        return (exp - SUB_BITS + 1) * SUB + ((v >> (exp - SUB_BITS)) & (SUB - 1));
+    }
+
+    // 第i个桶的下界
+    static uint64_t Lower_(size_t i) {
+        if (i < SUB) {
+            return i;
+        }
+        size_t group = i / SUB;
+        uint64_t sub = i % SUB;
+        return (SUB + sub) << (group - 1);
+    }
+
+private:
+    struct alignas(metrics::CACHE_LINE) Shard {
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+    std::unique_ptr<Shard[]> shards_;
+};
+
+// 按一个整数标签（比如状态码）区分的一组Counter，子Counter在第一次用到时创建
+// 查找不加锁：开放寻址的小表，槽一旦写入就不再改变，只有创建新的子Counter时加锁
+class IntCounterVec {
+public:
+    IntCounterVec(std::string name, std::string help, std::string labelName);
+
+    Counter &With(int value);
+
+private:
+    static const size_t SLOTS = 64;
+
+    Counter &Create_(int value);
+
+    std::string name_;
+    std::string help_;
+    std::string labelName_;
+    std::atomic<int> keys_[SLOTS];
+    std::atomic<Counter *> counters_[SLOTS];
+    std::mutex mtx_;
+    std::vector<std::unique_ptr<Counter>> owned_;
+    std::unique_ptr<Counter> other_; // 表满了之后的值都记在这里
+};
+
+class MetricsRegistry {
+public:
+    static MetricsRegistry *Instance();
+
+    void Add(Metric *metric);
+    void Remove(Metric *metric);
+
+    // Prometheus文本格式，同名的指标放在一起，只输出一次HELP和TYPE
+    std::string Render();
+
+private:
+    MetricsRegistry() = default;
+
+    std::mutex mtx_; // 输出期间也持有，指标不会在输出的时候被析构
+    std::vector<Metric *> metrics_;
+};
+
+#endif // METRICS_H
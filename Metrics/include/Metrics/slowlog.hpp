@@ -0,0 +1,60 @@
+#ifndef SLOW_LOG_H
+#define SLOW_LOG_H
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "Metrics/tracer.hpp"
+
+/*
+最慢的N个请求，一直开着，记录各个阶段的耗时，用来判断慢在排队、解析、kv/数据库还是写socket
+1. 请求结束时用RequestTrace中的时间点算出总耗时，先和当前第N慢的比较（一次relaxed load），
+   不够慢就直接返回，只有可能进入前N的请求才加锁
+2. 前N个放在以总耗时为key的小根堆中，堆顶就是门槛
+3. Clear之后重新统计，用来观察一段时间内的慢请求
+*/
+class SlowLog {
+public:
+    struct Entry {
+        int64_t wallMs;    // 请求结束时的墙上时间（毫秒）
+        int64_t totalNs;
+        int64_t queueNs;   // 在线程池中排队
+        int64_t parseNs;   // 读和解析
+        int64_t handlerNs; // kv操作/数据库验证
+        int64_t writeNs;   // 准备好回复到最后一个字节写出去
+        int conn;
+        std::string method;
+        std::string path;
+    };
+
+    static SlowLog *Instance();
+
+    explicit SlowLog(size_t capacity = 32);
+
+    // 总耗时是否可能进入前N，不加锁
+    bool IsSlow(int64_t totalNs) const {
+        return totalNs > threshold_.load(std::memory_order_relaxed);
+    }
+
+    void Add(const RequestTrace &trace, int conn, const std::string &method,
+             const std::string &path);
+
+    // 从慢到快
+    std::vector<Entry> Entries();
+    std::string Render();
+    void Clear();
+
+private:
+    static bool Faster_(const Entry &a, const Entry &b) { return a.totalNs > b.totalNs; }
+
+    static const size_t MAX_PATH = 128;
+
+    size_t capacity_;
+    std::mutex mtx_;
+    std::vector<Entry> heap_;
+    std::atomic<int64_t> threshold_; // 堆满时是堆顶的总耗时，没满时为0
+};
+
+#endif // SLOW_LOG_H
@@ -0,0 +1,124 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+可选的请求级追踪，默认关闭，打开之后记录每个请求在各个阶段花的时间
+1. RequestTrace跟着连接走，在各个阶段打时间戳；同一时刻只有一个线程处理一个连接，不需要同步
+   时间戳一直在打（SlowLog也要用），一次打点只是读一次CLOCK_MONOTONIC（vdso，几十纳秒）
+2. 打开追踪时，请求的最后一个字节写出去之后，由当时的线程把相邻阶段之间的时间作为span
+   写到自己的TraceRing中；关闭时只多一次relaxed load
+3. TraceRing是每个线程独有的环形缓冲，写满之后覆盖最旧的，只保留最近的一段
+   每个TraceRing有一把锁，平时只有自己的线程用，导出时才会有竞争
+4. 导出为Chrome trace的JSON（chrome://tracing 或者 Perfetto可以打开），每个连接是一行
+*/
+
+struct TraceEvent {
+    const char *name;
+    int64_t startNs;
+    int64_t durNs;
+    uint64_t reqId;
+    int conn;
+};
+
+class TraceRing {
+public:
+    TraceRing(size_t capacity, int tid);
+
+    void Push(const TraceEvent &event);
+    // 按时间顺序追加到out中，返回追加的个数
+    size_t CopyTo(std::vector<TraceEvent> &out);
+    void Clear();
+
+    int Tid() const { return tid_; }
+
+private:
+    std::mutex mtx_;
+    std::vector<TraceEvent> events_;
+    size_t next_;  // 下一个写入的位置
+    size_t count_; // 已经写入的个数，最多是容量
+    int tid_;
+};
+
+class Tracer {
+public:
+    static Tracer *Instance();
+
+    static bool Enabled() { return enabled_.load(std::memory_order_relaxed); }
+    static int64_t NowNs();
+
+    void SetEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    // 每个线程的TraceRing能保存的span个数，只影响之后创建的TraceRing
+    void SetRingCapacity(size_t capacity) { capacity_ = capacity; }
+
+    // 写到当前线程的TraceRing中
+    void Record(const TraceEvent &event);
+    uint64_t NextRequestId() { return nextReqId_.fetch_add(1, std::memory_order_relaxed); }
+
+    std::string DumpJson();
+    bool DumpToFile(const std::string &path);
+    void Clear();
+
+private:
+    Tracer();
+
+    TraceRing *LocalRing_();
+
+    static std::atomic<bool> enabled_;
+
+    std::atomic<size_t> capacity_;
+    std::atomic<uint64_t> nextReqId_;
+    std::mutex mtx_; // 保护rings_
+    std::vector<std::shared_ptr<TraceRing>> rings_;
+};
+
+// 一个请求在各个阶段的时间点，没有经过的阶段为0
+class RequestTrace {
+public:
+    enum Stage {
+        ACCEPT = 0, // 连接建立
+        WAKE,       // epoll_wait返回
+        DISPATCH,   // 读任务交给线程池
+        DEQUEUE,    // 工作线程开始执行
+        PARSE,      // 请求解析完（kv操作之前）
+        HANDLER,    // kv操作/数据库验证完成，回复准备好
+        FIRST_BYTE, // 第一次写出数据
+        LAST_BYTE,  // 回复全部写完
+        STAGES,
+    };
+
+    RequestTrace() { Reset(); }
+
+    void Mark(Stage stage) { stamps_[stage] = Tracer::NowNs(); }
+    void Mark(Stage stage, int64_t ns) { stamps_[stage] = ns; }
+
+    // 同一个请求中可能经过好几次的地方只记第一次
+    void MarkOnce(Stage stage) {
+        if (stamps_[stage] == 0) {
+            stamps_[stage] = Tracer::NowNs();
+        }
+    }
+
+    bool Marked(Stage stage) const { return stamps_[stage] != 0; }
+    int64_t Stamp(Stage stage) const { return stamps_[stage]; }
+
+    // 请求的开始（从WAKE起第一个打过点的阶段）到stage的时间，stage没有打点时为0
+    int64_t Since(Stage stage) const;
+    // stage和它前面最近一个打过点的阶段（不早于请求开始）之间的时间
+    int64_t Gap(Stage stage) const;
+
+    // 请求结束，打开追踪时写出span，之后清空，连接建立的时间只在第一个请求中使用
+    void Finish(int conn);
+    void Reset();
+
+private:
+    int64_t stamps_[STAGES];
+};
+
+#endif // TRACER_H
@@ -0,0 +1,136 @@
+#include "Metrics/hotkeys.hpp"
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+
+using namespace std;
+
+namespace {
+    size_t RoundUpPow2(size_t n) {
+        size_t size = 2;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+} // namespace
+
+HotKeys::HotKeys(size_t topK, size_t width, int sample)
+    : topK_(max<size_t>(topK, 1)), mask_(RoundUpPow2(width) - 1), sample_(max(sample, 1)),
+      counters_(new atomic<uint32_t>[DEPTH * (mask_ + 1)]), total_(0), minTop_(0) {
+    for (size_t i = 0; i < DEPTH * (mask_ + 1); i++) {
+        counters_[i].store(0, memory_order_relaxed);
+    }
+}
+
+// 全局计数器乘上黄金分割常数再混合一下，xorshift的种子不能为0
+uint32_t HotKeys::NextSeed_() {
+    static atomic<uint32_t> next(0);
+    uint32_t x = (next.fetch_add(1, memory_order_relaxed) + 1) * 0x9e3779b9u;
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    return x ? x : 2463534242u;
+}
+
+// 一次哈希得到两个值，第i行用h1 + i * h2（Kirsch-Mitzenmacher）
+void HotKeys::Hash_(const string &key, size_t *index) const {
+    uint64_t h = hash<string>()(key);
+    // 再混一下，有的实现对短字符串的哈希高位变化很小
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    uint64_t h1 = h & 0xffffffff;
+    uint64_t h2 = (h >> 32) | 1;
+    for (int i = 0; i < DEPTH; i++) {
+        index[i] = i * (mask_ + 1) + ((h1 + i * h2) & mask_);
+    }
+}
+
+void HotKeys::Add(const string &key) {
+    size_t index[DEPTH];
+    Hash_(key, index);
+    uint64_t estimate = UINT64_MAX;
+    for (int i = 0; i < DEPTH; i++) {
+        uint64_t v = counters_[index[i]].fetch_add(1, memory_order_relaxed) + 1;
+        estimate = min(estimate, v);
+    }
+    if (estimate > minTop_.load(memory_order_relaxed)) {
+        lock_guard<mutex> locker(mtx_);
+        auto it = find_if(top_.begin(), top_.end(), [&key](const Item &item) { return item.key == key; });
+        if (it != top_.end()) {
+            it->count = estimate;
+        } else if (top_.size() < topK_) {
+            top_.push_back({key, estimate});
+        } else {
+            auto least = min_element(top_.begin(), top_.end(),
+                                     [](const Item &a, const Item &b) { return a.count < b.count; });
+            if (estimate > least->count) {
+                *least = {key, estimate};
+            }
+        }
+        if (top_.size() == topK_) {
+            uint64_t least = UINT64_MAX;
+            for (const Item &item : top_) {
+                least = min(least, item.count);
+            }
+            minTop_.store(least, memory_order_relaxed);
+        }
+    }
+    if ((total_.fetch_add(1, memory_order_relaxed) + 1) % DECAY_EVERY == 0) {
+        Decay_();
+    }
+}
+
+uint64_t HotKeys::Estimate(const string &key) const {
+    size_t index[DEPTH];
+    Hash_(key, index);
+    uint64_t estimate = UINT64_MAX;
+    for (int i = 0; i < DEPTH; i++) {
+        estimate = min<uint64_t>(estimate, counters_[index[i]].load(memory_order_relaxed));
+    }
+    return estimate;
+}
+
+// 减半时其他线程可能正在加，少算或者多算一两次没有关系
+void HotKeys::Decay_() {
+    for (size_t i = 0; i < DEPTH * (mask_ + 1); i++) {
+        counters_[i].store(counters_[i].load(memory_order_relaxed) / 2, memory_order_relaxed);
+    }
+    lock_guard<mutex> locker(mtx_);
+    for (Item &item : top_) {
+        item.count /= 2;
+    }
+    minTop_.store(minTop_.load(memory_order_relaxed) / 2, memory_order_relaxed);
+}
+
+vector<HotKeys::Item> HotKeys::Top() {
+    vector<Item> items;
+    {
+        lock_guard<mutex> locker(mtx_);
+        items = top_;
+    }
+    for (Item &item : items) {
+        item.count = Estimate(item.key);
+    }
+    sort(items.begin(), items.end(), [](const Item &a, const Item &b) { return a.count > b.count; });
+    return items;
+}
+
+string HotKeys::Render() {
+    // 第一列是采样之后的次数，第二列乘上了采样间隔，是大约的访问次数
+    string out = "# sampled approx_ops key (1 in " + to_string(sample_) + " ops sampled)\n";
+    for (const Item &item : Top()) {
+        out += to_string(item.count) + " " + to_string(item.count * sample_) + " " + item.key + "\n";
+    }
+    return out;
+}
+
+void HotKeys::Clear() {
+    for (size_t i = 0; i < DEPTH * (mask_ + 1); i++) {
+        counters_[i].store(0, memory_order_relaxed);
+    }
+    lock_guard<mutex> locker(mtx_);
+    top_.clear();
+    minTop_.store(0, memory_order_relaxed);
+}
@@ -0,0 +1,202 @@
+#include "Metrics/metrics.hpp"
+#include <algorithm>
+#include <stdio.h>
+
+using namespace std;
+
+Metric::Metric(string name, string help, string labels, const char *type)
+    : name_(std::move(name)), help_(std::move(help)), labels_(std::move(labels)), type_(type) {
+    MetricsRegistry::Instance()->Add(this);
+}
+
+Metric::~Metric() { MetricsRegistry::Instance()->Remove(this); }
+
+void Metric::AppendSample_(string &out, const char *suffix, const string &extraLabel,
+                           double value) const {
+    out += name_;
+    out += suffix;
+    if (!labels_.empty() || !extraLabel.empty()) {
+        out += '{';
+        out += labels_;
+        if (!labels_.empty() && !extraLabel.empty()) {
+            out += ',';
+        }
+        out += extraLabel;
+        out += '}';
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), " %.10g\n", value);
+    out += buf;
+}
+
+Counter::Counter(string name, string help, string labels)
+    : Metric(std::move(name), std::move(help), std::move(labels), "counter") {}
+
+uint64_t Counter::Value() const {
+    uint64_t sum = 0;
+    for (const Shard &shard : shards_) {
+        sum += shard.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void Counter::Collect(string &out) const { AppendSample_(out, "", "", static_cast<double>(Value())); }
+
+Gauge::Gauge(string name, string help, string labels)
+    : Metric(std::move(name), std::move(help), std::move(labels), "gauge"), value_(0) {}
+
+void Gauge::Collect(string &out) const { AppendSample_(out, "", "", static_cast<double>(Value())); }
+
+CallbackGauge::CallbackGauge(string name, string help, function<double()> func, string labels)
+    : CallbackGauge(std::move(name), std::move(help), std::move(func), std::move(labels), "gauge") {}
+
+CallbackGauge::CallbackGauge(string name, string help, function<double()> func, string labels,
+                             const char *type)
+    : Metric(std::move(name), std::move(help), std::move(labels), type), func_(std::move(func)) {}
+
+void CallbackGauge::Collect(string &out) const { AppendSample_(out, "", "", func_()); }
+
+CallbackCounter::CallbackCounter(string name, string help, function<double()> func, string labels)
+    : CallbackGauge(std::move(name), std::move(help), std::move(func), std::move(labels),
+                    "counter") {}
+
+Histogram::Histogram(string name, string help, string labels)
+    : Metric(std::move(name), std::move(help), std::move(labels), "histogram"),
+      shards_(new Shard[metrics::SHARDS]()) {}
+
+Histogram::Snapshot Histogram::Snap() const {
+    Snapshot snap;
+    snap.buckets.assign(BUCKETS, 0);
+    for (size_t s = 0; s < metrics::SHARDS; s++) {
+        const Shard &shard = shards_[s];
+        for (size_t i = 0; i < BUCKETS; i++) {
+            snap.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+        snap.count += shard.count.load(std::memory_order_relaxed);
+        snap.sum += shard.sum.load(std::memory_order_relaxed);
+        snap.max = max(snap.max, shard.max.load(std::memory_order_relaxed));
+    }
+    return snap;
+}
+
+uint64_t Histogram::Snapshot::Percentile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(q * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return min(max, Lower_(i + 1) - 1);
+        }
+    }
+    return max;
+}
+
+uint64_t Histogram::Snapshot::CountBelow(uint64_t ns) const {
+    uint64_t n = 0;
+    for (size_t i = 0; i < buckets.size() && Lower_(i + 1) <= ns + 1; i++) {
+        n += buckets[i];
+    }
+    return n;
+}
+
+// 分片是分别读的，输出期间还有记录的话各个数之间可能差几个，Prometheus可以接受
+void Histogram::Collect(string &out) const {
+    static const uint64_t BOUNDS_NS[] = {
+        1000,       2000,       5000,        10000,       20000,       50000,
+        100000,     200000,     500000,      1000000,     2000000,     5000000,
+        10000000,   20000000,   50000000,    100000000,   200000000,   500000000,
+        1000000000, 2000000000, 5000000000, 10000000000,
+    };
+    Snapshot snap = Snap();
+    char le[32];
+    for (uint64_t bound : BOUNDS_NS) {
+        snprintf(le, sizeof(le), "le=\"%g\"", bound / 1e9);
+        AppendSample_(out, "_bucket", le, static_cast<double>(snap.CountBelow(bound)));
+    }
+    AppendSample_(out, "_bucket", "le=\"+Inf\"", static_cast<double>(snap.count));
+    AppendSample_(out, "_sum", "", snap.sum / 1e9);
+    AppendSample_(out, "_count", "", static_cast<double>(snap.count));
+}
+
+IntCounterVec::IntCounterVec(string name, string help, string labelName)
+    : name_(std::move(name)), help_(std::move(help)), labelName_(std::move(labelName)) {
+    for (size_t i = 0; i < SLOTS; i++) {
+        keys_[i].store(0, std::memory_order_relaxed);
+        counters_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+Counter &IntCounterVec::With(int value) {
+    size_t h = static_cast<unsigned>(value) % SLOTS;
+    for (size_t n = 0; n < SLOTS; n++) {
+        size_t i = (h + n) % SLOTS;
+        Counter *counter = counters_[i].load(std::memory_order_acquire);
+        if (!counter) {
+            break;
+        }
+        if (keys_[i].load(std::memory_order_relaxed) == value) {
+            return *counter;
+        }
+    }
+    return Create_(value);
+}
+
+// 先写key再发布counter，读者看到counter时key一定已经写好了
+Counter &IntCounterVec::Create_(int value) {
+    lock_guard<mutex> locker(mtx_);
+    size_t h = static_cast<unsigned>(value) % SLOTS;
+    for (size_t n = 0; n < SLOTS; n++) {
+        size_t i = (h + n) % SLOTS;
+        Counter *counter = counters_[i].load(std::memory_order_relaxed);
+        if (counter && keys_[i].load(std::memory_order_relaxed) == value) {
+            return *counter;
+        }
+        if (!counter) {
+            owned_.emplace_back(
+                new Counter(name_, help_, labelName_ + "=\"" + to_string(value) + "\""));
+            keys_[i].store(value, std::memory_order_relaxed);
+            counters_[i].store(owned_.back().get(), std::memory_order_release);
+            return *owned_.back();
+        }
+    }
+    if (!other_) {
+        other_.reset(new Counter(name_, help_, labelName_ + "=\"other\""));
+    }
+    return *other_;
+}
+
+MetricsRegistry *MetricsRegistry::Instance() {
+    static MetricsRegistry registry;
+    return &registry;
+}
+
+void MetricsRegistry::Add(Metric *metric) {
+    lock_guard<mutex> locker(mtx_);
+    metrics_.push_back(metric);
+}
+
+void MetricsRegistry::Remove(Metric *metric) {
+    lock_guard<mutex> locker(mtx_);
+    metrics_.erase(std::remove(metrics_.begin(), metrics_.end(), metric), metrics_.end());
+}
+
+string MetricsRegistry::Render() {
+    lock_guard<mutex> locker(mtx_);
+    vector<Metric *> sorted = metrics_;
+    stable_sort(sorted.begin(), sorted.end(),
+                [](const Metric *a, const Metric *b) { return a->Name() < b->Name(); });
+    string out;
+    const string *last = nullptr;
+    for (const Metric *metric : sorted) {
+        if (!last || *last != metric->Name()) {
+            out += "# HELP " + metric->Name() + " " + metric->Help() + "\n";
+            out += "# TYPE " + metric->Name() + " " + metric->Type() + "\n";
+            last = &metric->Name();
+        }
+        metric->Collect(out);
+    }
+    return out;
+}
@@ -0,0 +1,79 @@
+#include "Metrics/slowlog.hpp"
+#include <algorithm>
+#include <stdio.h>
+#include <sys/time.h>
+
+using namespace std;
+
+SlowLog *SlowLog::Instance() {
+    static SlowLog slowLog;
+    return &slowLog;
+}
+
+SlowLog::SlowLog(size_t capacity) : capacity_(max<size_t>(capacity, 1)), threshold_(0) {
+    heap_.reserve(capacity_);
+}
+
+void SlowLog::Add(const RequestTrace &trace, int conn, const string &method, const string &path) {
+    int64_t total = trace.Since(RequestTrace::LAST_BYTE);
+    if (!IsSlow(total)) {
+        return;
+    }
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    Entry entry;
+    entry.wallMs = static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+    entry.totalNs = total;
+    entry.queueNs = trace.Marked(RequestTrace::DISPATCH) ? trace.Gap(RequestTrace::DEQUEUE) : 0;
+    entry.parseNs = trace.Gap(RequestTrace::PARSE);
+    entry.handlerNs = trace.Gap(RequestTrace::HANDLER);
+    entry.writeNs = trace.Gap(RequestTrace::FIRST_BYTE) + trace.Gap(RequestTrace::LAST_BYTE);
+    entry.conn = conn;
+    entry.method = method;
+    entry.path = path.substr(0, MAX_PATH);
+
+    lock_guard<mutex> locker(mtx_);
+    if (heap_.size() == capacity_) {
+        if (total <= heap_.front().totalNs) {
+            return;
+        }
+        pop_heap(heap_.begin(), heap_.end(), Faster_);
+        heap_.back() = std::move(entry);
+    } else {
+        heap_.push_back(std::move(entry));
+    }
+    push_heap(heap_.begin(), heap_.end(), Faster_);
+    if (heap_.size() == capacity_) {
+        threshold_.store(heap_.front().totalNs, std::memory_order_relaxed);
+    }
+}
+
+vector<SlowLog::Entry> SlowLog::Entries() {
+    vector<Entry> entries;
+    {
+        lock_guard<mutex> locker(mtx_);
+        entries = heap_;
+    }
+    sort(entries.begin(), entries.end(), Faster_);
+    return entries;
+}
+
+// 每行一个请求，时间都是微秒
+string SlowLog::Render() {
+    string out = "# total_us queue_us parse_us handler_us write_us conn wall_ms method path\n";
+    char buf[128];
+    for (const Entry &entry : Entries()) {
+        snprintf(buf, sizeof(buf), "%.1f %.1f %.1f %.1f %.1f %d %lld ", entry.totalNs / 1e3,
+                 entry.queueNs / 1e3, entry.parseNs / 1e3, entry.handlerNs / 1e3,
+                 entry.writeNs / 1e3, entry.conn, static_cast<long long>(entry.wallMs));
+        out += buf;
+        out += entry.method + " " + entry.path + "\n";
+    }
+    return out;
+}
+
+void SlowLog::Clear() {
+    lock_guard<mutex> locker(mtx_);
+    heap_.clear();
+    threshold_.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,184 @@
+#include "Metrics/tracer.hpp"
+#include <time.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sys/syscall.h>
+
+using namespace std;
+
+std::atomic<bool> Tracer::enabled_(false);
+
+namespace {
+    // span的名字是到这个阶段为止的那一段，ACCEPT之前没有span
+    const char *const SPAN_NAMES[RequestTrace::STAGES] = {
+        nullptr, "idle", "loop", "queue", "parse", "handler", "respond", "write",
+    };
+
+    struct RingHolder {
+        shared_ptr<TraceRing> ring;
+    };
+    thread_local RingHolder tlsRing;
+} // namespace
+
+TraceRing::TraceRing(size_t capacity, int tid)
+    : events_(max<size_t>(capacity, 1)), next_(0), count_(0), tid_(tid) {}
+
+void TraceRing::Push(const TraceEvent &event) {
+    lock_guard<mutex> locker(mtx_);
+    events_[next_] = event;
+    next_ = (next_ + 1) % events_.size();
+    count_ = min(count_ + 1, events_.size());
+}
+
+size_t TraceRing::CopyTo(vector<TraceEvent> &out) {
+    lock_guard<mutex> locker(mtx_);
+    size_t start = (next_ + events_.size() - count_) % events_.size();
+    for (size_t i = 0; i < count_; i++) {
+        out.push_back(events_[(start + i) % events_.size()]);
+    }
+    return count_;
+}
+
+void TraceRing::Clear() {
+    lock_guard<mutex> locker(mtx_);
+    next_ = count_ = 0;
+}
+
+Tracer::Tracer() : capacity_(8192), nextReqId_(1) {}
+
+Tracer *Tracer::Instance() {
+    static Tracer tracer;
+    return &tracer;
+}
+
+int64_t Tracer::NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// 当前线程的TraceRing，第一次记录时创建，线程退出之后仍然保留，已经记下的span还能导出
+TraceRing *Tracer::LocalRing_() {
+    if (!tlsRing.ring) {
+        int tid = static_cast<int>(syscall(SYS_gettid));
+        tlsRing.ring = make_shared<TraceRing>(capacity_.load(), tid);
+        lock_guard<mutex> locker(mtx_);
+        rings_.push_back(tlsRing.ring);
+    }
+    return tlsRing.ring.get();
+}
+
+void Tracer::Record(const TraceEvent &event) { LocalRing_()->Push(event); }
+
+void Tracer::Clear() {
+    lock_guard<mutex> locker(mtx_);
+    for (auto &ring : rings_) {
+        ring->Clear();
+    }
+}
+
+// Chrome trace格式：ph为X的完整事件，时间单位是微秒；tid用连接的fd，同一个连接的请求画在一行
+string Tracer::DumpJson() {
+    vector<pair<int, TraceEvent>> events;
+    {
+        lock_guard<mutex> locker(mtx_);
+        vector<TraceEvent> buf;
+        for (auto &ring : rings_) {
+            buf.clear();
+            ring->CopyTo(buf);
+            for (const TraceEvent &event : buf) {
+                events.emplace_back(ring->Tid(), event);
+            }
+        }
+    }
+    // 开始时间相同时长的在前，外层的request span先出现
+    sort(events.begin(), events.end(),
+         [](const pair<int, TraceEvent> &a, const pair<int, TraceEvent> &b) {
+             if (a.second.startNs != b.second.startNs) {
+                 return a.second.startNs < b.second.startNs;
+             }
+             return a.second.durNs > b.second.durNs;
+         });
+    string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    char buf[256];
+    int pid = getpid();
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent &event = events[i].second;
+        snprintf(buf, sizeof(buf),
+                 "%s\n{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                 "\"pid\":%d,\"tid\":%d,\"args\":{\"req\":%llu,\"thread\":%d}}",
+                 i == 0 ? "" : ",", event.name, event.startNs / 1000.0, event.durNs / 1000.0, pid,
+                 event.conn, static_cast<unsigned long long>(event.reqId), events[i].first);
+        out += buf;
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool Tracer::DumpToFile(const string &path) {
+    string json = DumpJson();
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fwrite(json.data(), 1, json.size(), fp) == json.size();
+    return fclose(fp) == 0 && ok;
+}
+
+void RequestTrace::Reset() {
+    for (int i = 0; i < STAGES; i++) {
+        stamps_[i] = 0;
+    }
+}
+
+int64_t RequestTrace::Since(Stage stage) const {
+    for (int i = WAKE; i < stage; i++) {
+        if (stamps_[i] != 0) {
+            return stamps_[stage] != 0 ? stamps_[stage] - stamps_[i] : 0;
+        }
+    }
+    return 0;
+}
+
+int64_t RequestTrace::Gap(Stage stage) const {
+    if (stamps_[stage] == 0) {
+        return 0;
+    }
+    for (int i = stage - 1; i >= WAKE; i--) {
+        if (stamps_[i] != 0) {
+            return stamps_[stage] - stamps_[i];
+        }
+    }
+    return 0;
+}
+
+// 整个请求是一个span，相邻两个打过点的阶段之间是一个子span
+void RequestTrace::Finish(int conn) {
+    if (!Tracer::Enabled()) {
+        Reset();
+        return;
+    }
+    int first = WAKE;
+    while (first < STAGES && stamps_[first] == 0) {
+        first++;
+    }
+    int last = STAGES - 1;
+    while (last > first && stamps_[last] == 0) {
+        last--;
+    }
+    if (first < last) {
+        Tracer *tracer = Tracer::Instance();
+        uint64_t reqId = tracer->NextRequestId();
+        tracer->Record({"request", stamps_[first], stamps_[last] - stamps_[first], reqId, conn});
+        int prev = stamps_[ACCEPT] != 0 ? static_cast<int>(ACCEPT) : first;
+        for (int i = prev + 1; i <= last; i++) {
+            if (stamps_[i] == 0) {
+                continue;
+            }
+            tracer->Record({SPAN_NAMES[i], stamps_[prev], stamps_[i] - stamps_[prev], reqId, conn});
+            prev = i;
+        }
+    }
+    Reset();
+}
@@ -0,0 +1,66 @@
+#ifndef CODEL_H
+#define CODEL_H
+
+#include <atomic>
+#include <algorithm>
+#include <stdint.h>
+
+/*
+基于排队时间的过载判断（CoDel的思路，按Facebook的自适应CoDel做了简化）
+1. 只看排队时间，不看队列长度：突发的请求排一会儿队没有关系，
+   一整个interval中最短的排队时间都超过target，说明有消不掉的积压，认为过载
+2. 队列空了（工作线程开始等待）马上退出过载
+3. OnDequeue和OnIdle由工作线程在线程池的锁中调用，不需要自己加锁；
+   Overloaded可以在任何线程中读（主循环用来决定是否拒绝新请求）
+target为0时关闭，永远不过载
+*/
+class CoDel {
+public:
+    CoDel(int64_t targetNs = 5000000, int64_t intervalNs = 100000000)
+        : targetNs_(targetNs), intervalNs_(intervalNs), intervalEnd_(0), minDelay_(INT64_MAX),
+          overloaded_(false) {}
+
+    void SetTarget(int64_t targetNs, int64_t intervalNs) {
+        targetNs_.store(targetNs, std::memory_order_relaxed);
+        intervalNs_ = std::max<int64_t>(intervalNs, 1);
+        intervalEnd_ = 0;
+        minDelay_ = INT64_MAX;
+        overloaded_.store(false, std::memory_order_relaxed);
+    }
+
+    // 取出一个任务，sojournNs是它的排队时间
+    void OnDequeue(int64_t sojournNs, int64_t nowNs) {
+        minDelay_ = std::min(minDelay_, sojournNs);
+        // 忙起来之后的第一个任务，开始一个新的interval
+        if (intervalEnd_ == 0) {
+            intervalEnd_ = nowNs + intervalNs_;
+            return;
+        }
+        if (nowNs < intervalEnd_) {
+            return;
+        }
+        int64_t target = Target();
+        overloaded_.store(target > 0 && minDelay_ > target, std::memory_order_relaxed);
+        minDelay_ = INT64_MAX;
+        intervalEnd_ = nowNs + intervalNs_;
+    }
+
+    // 队列空了
+    void OnIdle() {
+        intervalEnd_ = 0;
+        minDelay_ = INT64_MAX;
+        overloaded_.store(false, std::memory_order_relaxed);
+    }
+
+    bool Overloaded() const { return overloaded_.load(std::memory_order_relaxed); }
+    int64_t Target() const { return targetNs_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> targetNs_;
+    int64_t intervalNs_;
+    int64_t intervalEnd_; // 当前interval结束的时间
+    int64_t minDelay_;    // 当前interval中最短的排队时间
+    std::atomic<bool> overloaded_;
+};
+
+#endif // CODEL_H
@@ -0,0 +1,60 @@
+#ifndef SQLBATCHINSERTER_H
+#define SQLBATCHINSERTER_H
+
+#include <mutex>
+#include <vector>
+#include <string>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include "Pool/sqlexecutor.hpp"
+#include "Pool/sqlstmtcache.hpp"
+
+/*
+把短时间内并发的INSERT合并成一条多行的INSERT，减少和MySQL之间的来回
+1. Add之后不会马上插入，后台线程在第一行到来之后再等window，或者攒够maxRows行
+2. 攒好的一批交给SqlExecutor，用预编译的多行INSERT执行（每种行数的语句在每个连接上只prepare一次）
+3. 整批失败（比如其中一行主键冲突）时逐行重试，每一行都能拿到自己的结果
+4. 有check时，插入之前在同一个DB任务中逐行检查（比如查重），没通过的行直接失败
+done在DB线程中被调用
+*/
+class SqlBatchInserter {
+public:
+    using Row = std::vector<std::string>;
+    using Done = std::function<void(bool)>;
+    using Check = std::function<bool(MYSQL *, const Row &)>;
+
+    SqlBatchInserter(const std::string &table, const std::vector<std::string> &columns,
+                     size_t maxRows = 64, int windowMs = 2, Check check = nullptr);
+    ~SqlBatchInserter();
+
+    void Add(Row row, Done done);
+
+private:
+    struct Item {
+        Row row;
+        Done done;
+    };
+
+    void Run_();
+    void Insert_(MYSQL *sql, std::vector<Item> &batch);
+    bool Exec_(MYSQL *sql, Item *items, size_t n);
+    std::string Query_(size_t rows) const;
+
+    std::string table_;
+    std::vector<std::string> columns_;
+    size_t maxRows_;
+    std::chrono::milliseconds window_;
+    Check check_;
+
+    std::vector<Item> items_;
+    int inflight_; // 已经交给SqlExecutor还没有执行完的批次，析构时要等它们
+    bool stop_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::unique_ptr<std::thread> thread_;
+};
+
+#endif // SQLBATCHINSERTER_H
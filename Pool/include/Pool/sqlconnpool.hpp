@@ -3,35 +3,103 @@
 
 #include <mysql/mysql.h>
 #include <string>
-#include <queue>
+#include <deque>
 #include <mutex>
-#include <semaphore.h>
+#include <chrono>
 #include <thread>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+#include <condition_variable>
 #include "Log/log.hpp"
+#include "Pool/sqlstmtcache.hpp"
 
+/*
+可伸缩的MySQL连接池
+1. 连接数在[minSize, maxSize]之间，Init不会等连接建好，没有空闲连接时GetConn才新建（懒增长）
+2. 后台线程定期ping空闲的连接，断开的连接关闭掉，连接数低于minSize时补上，
+   空闲太久的连接在超过minSize的部分会被关闭
+3. GetConn可以指定等待时间；数据库连不上时不排队等待，直接返回nullptr（快速失败），
+   由后台线程每隔一段时间重试，连上之后恢复
+4. 统计等待次数、等待时间、超时次数等，用GetStats取出
+空闲连接按后进先出使用，热的连接一直被复用，多出来的连接自然变成空闲的，之后被回收
+*/
 class SqlConnPool {
 public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        int size;                // 已经打开的连接（包括正在使用的）
+        int idle;                // 空闲的连接
+        int maxSize;
+        uint64_t gets;           // GetConn的调用次数
+        uint64_t waits;          // 需要等待的次数
+        uint64_t waitUsTotal;    // 总的等待时间
+        uint64_t waitUsMax;      // 最长的一次等待
+        uint64_t timeouts;       // 等待超时的次数
+        uint64_t failFast;       // 数据库不可用直接失败的次数
+        uint64_t connects;       // 成功建立的连接
+        uint64_t connectErrors;  // 建立连接失败的次数
+        uint64_t broken;         // 发现已经断开的连接
+    };
+
     static SqlConnPool *Instance();
 
+    // 使用Init时设置的默认等待时间
     MYSQL *GetConn();
+    // 最多等待timeoutMs毫秒，0表示不等待，-1表示一直等待
+    MYSQL *GetConn(int timeoutMs);
     void FreeConn(MYSQL *conn);
     int GetFreeConnCount();
+    // 连接对应的预编译语句缓存，只能由持有这个连接的线程使用
+    SqlStmtCache *GetStmtCache(MYSQL *conn);
+    Stats GetStats();
 
     void Init(const char *host, int port, const char *user, const char *pwd, const char *dbName,
-              int connSize);
+              int connSize, int minSize = 1, int waitTimeoutMs = 1000);
     void ClosePool();
 
 private:
     SqlConnPool();
     ~SqlConnPool();
 
-    int MAX_CONN_;
-    int useCount_;
-    int freeCount_;
+    struct IdleConn {
+        MYSQL *sql;
+        Clock::time_point since;
+    };
+
+    MYSQL *Connect_();
+    void Adopt_(MYSQL *sql);
+    void Close_(MYSQL *sql);
+    void Monitor_();
+    void CheckIdle_(std::unique_lock<std::mutex> &locker);
+    void FillMin_(std::unique_lock<std::mutex> &locker);
+
+    static const int CONNECT_TIMEOUT_S = 3;
+    static constexpr std::chrono::seconds PING_INTERVAL{5};
+    static constexpr std::chrono::seconds RETRY_INTERVAL{1};
+    static constexpr std::chrono::seconds IDLE_TIMEOUT{60};
+
+    std::string host_;
+    int port_;
+    std::string user_;
+    std::string pwd_;
+    std::string dbName_;
+
+    int maxSize_;
+    int minSize_;
+    int waitTimeoutMs_;
+    int size_;
+    bool down_;   // 最近一次建立连接失败，数据库可能不可用
+    bool closed_;
 
-    std::queue<MYSQL *> connQue_;
+    std::deque<IdleConn> idle_;
+    std::unordered_map<MYSQL *, std::unique_ptr<SqlStmtCache>> stmtCaches_;
+    Stats stats_;
     std::mutex mtx_;
-    sem_t semId_;
+    std::condition_variable cond_;        // 等待空闲连接
+    std::condition_variable monitorCond_; // 后台线程睡眠
+    std::unique_ptr<std::thread> monitor_;
 };
 
-#endif // SQLCONNPOOL_H
\ No newline at end of file
+#endif // SQLCONNPOOL_H
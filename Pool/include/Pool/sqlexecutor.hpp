@@ -0,0 +1,40 @@
+#ifndef SQLEXECUTOR_H
+#define SQLEXECUTOR_H
+
+#include <functional>
+#include <memory>
+#include <atomic>
+#include "Pool/threadpool.hpp"
+#include "Pool/sqlconnpool.hpp"
+#include "Pool/sqlconnRALL.hpp"
+
+/*
+专门执行数据库操作的线程池，处理http的工作线程不会被慢查询卡住
+1. 线程数和连接池的连接数相同，每个任务执行时都能拿到一个连接，用完马上归还
+2. 任务在DB线程中执行，完成之后由任务自己通知调用者（比如投递回主循环）
+没有Init时任务直接在调用者的线程中执行
+*/
+class SqlExecutor {
+public:
+    using Job = std::function<void(MYSQL *)>;
+
+    static SqlExecutor *Instance();
+
+    void Init(int threadNum);
+
+    // 提交一个数据库任务，拿不到连接时job收到nullptr
+    void Submit(Job job);
+
+    // 还没有执行完的任务数
+    int Pending() const { return pending_.load(std::memory_order_relaxed); }
+
+private:
+    SqlExecutor() : pending_(0) {}
+
+    static void Run_(const Job &job);
+
+    std::unique_ptr<ThreadPool> pool_;
+    std::atomic<int> pending_;
+};
+
+#endif // SQLEXECUTOR_H
@@ -0,0 +1,72 @@
+#ifndef SQLSTMTCACHE_H
+#define SQLSTMTCACHE_H
+
+#include <mysql/mysql.h>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <unordered_map>
+#include "Log/log.hpp"
+
+/*
+每个连接池中的连接都有一个预编译语句的缓存，同一条SQL只在第一次用到时prepare
+连接同一时刻只会被一个线程使用，所以缓存不需要加锁
+连接重连之后服务器端的语句都失效了，要调用Clear
+*/
+class SqlStmtCache {
+public:
+    explicit SqlStmtCache(MYSQL *sql) : sql_(sql) {}
+    ~SqlStmtCache() { Clear(); }
+
+    SqlStmtCache(const SqlStmtCache &) = delete;
+    SqlStmtCache &operator=(const SqlStmtCache &) = delete;
+
+    // 拿到query对应的预编译语句，prepare失败返回nullptr
+    MYSQL_STMT *Get(const std::string &query);
+
+    // 关闭所有缓存的语句
+    void Clear();
+
+    size_t Size() const { return stmts_.size(); }
+
+private:
+    MYSQL *sql_;
+    std::unordered_map<std::string, MYSQL_STMT *> stmts_;
+};
+
+// 执行预编译语句时绑定参数和结果用的小工具，只支持字符串
+class SqlBinds {
+public:
+    explicit SqlBinds(size_t n) : binds_(n), lengths_(n, 0) {
+        for (auto &bind : binds_) {
+            memset(&bind, 0, sizeof(bind));
+        }
+    }
+
+    // 输入参数，str要在执行完之前一直有效
+    void SetParam(size_t i, const std::string &str) {
+        lengths_[i] = str.size();
+        binds_[i].buffer_type = MYSQL_TYPE_STRING;
+        binds_[i].buffer = const_cast<char *>(str.data());
+        binds_[i].buffer_length = str.size();
+        binds_[i].length = &lengths_[i];
+    }
+
+    // 输出结果，fetch之后用Length(i)取长度
+    void SetResult(size_t i, char *buf, size_t size) {
+        binds_[i].buffer_type = MYSQL_TYPE_STRING;
+        binds_[i].buffer = buf;
+        binds_[i].buffer_length = size;
+        binds_[i].length = &lengths_[i];
+    }
+
+    unsigned long Length(size_t i) const { return lengths_[i]; }
+
+    MYSQL_BIND *Data() { return binds_.data(); }
+
+private:
+    std::vector<MYSQL_BIND> binds_;
+    std::vector<unsigned long> lengths_;
+};
+
+#endif // SQLSTMTCACHE_H
@@ -6,7 +6,10 @@
 #include <queue>
 #include <functional>
 #include <thread>
+#include <atomic>
+#include <chrono>
 #include "glog/logging.h"
+#include "Pool/codel.hpp"
 
 //TODO ：加入无锁队列
 
@@ -15,31 +18,7 @@ public:
     explicit ThreadPool(size_t threadCount = 8) : pool_(std::make_shared<Pool>()) {
         // 检查线程数量是否合法
         CHECK(threadCount > 0) << "threadCount is less than 0";
-        // 使用lambda函数创建工作线程
-        for (size_t i = 0; i < threadCount; i++) {
-            std::thread([pool = pool_] {
-                // 工作线程唯一的作用就是运行一个循环，不断地从task中取出待处理的函数
-                std::unique_lock<std::mutex> uq_lock(pool->mtx);
-                while (true) {
-                    // 这里if循环的顺序很重要，就算是缓存池已经被关了，如果任务队列不空，也必须将所有任务处理完了再退出线程
-                    if (!pool->tasks.empty()) {
-                        // 任务队列有待处理的任务
-                        // 在锁的保护下取出任务队列的第一个任务
-                        auto task = pool->tasks.front();
-                        pool->tasks.pop();
-                        uq_lock.unlock();
-                        task();
-                        uq_lock.lock();
-                    } else if (pool->isClosed) {
-                        // 线程池已经关闭
-                        break;
-                    } else {
-                        // 暂时无任务，通过条件变量阻塞
-                        pool->cond.wait(uq_lock);
-                    }
-                }
-            }).detach();
-        }
+        Resize(threadCount);
     }
 
     ThreadPool() = default;
@@ -59,18 +38,119 @@ public:
     void AddTask(F &&task) {
         {
             std::lock_guard<std::mutex> lg(pool_->mtx);
-            pool_->tasks.emplace(std::forward<F>(task));
+            pool_->tasks.push(Task{std::forward<F>(task), NowNs_()});
+            pool_->depth.store(pool_->tasks.size(), std::memory_order_relaxed);
         }
         pool_->cond.notify_one();
     }
 
+    // 排队中还没有被取走的任务数
+    size_t QueueSize() {
+        std::lock_guard<std::mutex> lg(pool_->mtx);
+        return pool_->tasks.size();
+    }
+
+    /*
+    是否应该在入口处直接拒绝新请求，不加锁，主循环每个请求都会调用
+    1. CoDel发现排队时间一直降不下来（有消不掉的积压）
+    2. 并且按照当前的队列长度和任务平均耗时估计，新任务的排队时间会超过target
+    只满足1时积压可能正在消退，不拒绝；只满足2说明只是突发，也不拒绝
+    */
+    bool ShouldShed() const {
+        if (!pool_->codel.Overloaded()) {
+            return false;
+        }
+        int64_t depth = static_cast<int64_t>(pool_->depth.load(std::memory_order_relaxed));
+        int64_t wait = depth * pool_->serviceNs.load(std::memory_order_relaxed) /
+                       static_cast<int64_t>(pool_->threads.load(std::memory_order_relaxed));
+        return wait > pool_->codel.Target();
+    }
+
+    // 运行时调整线程数：多了马上创建，少了由多出来的线程处理完手上的任务之后自己退出
+    void Resize(size_t threadCount) {
+        CHECK(threadCount > 0) << "threadCount is less than 0";
+        {
+            std::lock_guard<std::mutex> lg(pool_->mtx);
+            pool_->threads.store(threadCount, std::memory_order_relaxed);
+            for (; pool_->workers < threadCount; pool_->workers++) {
+                std::thread(Work_, pool_).detach();
+            }
+        }
+        pool_->cond.notify_all();
+    }
+
+    size_t ThreadCount() const { return pool_->threads.load(std::memory_order_relaxed); }
+
+    // 排队时间的目标和观察窗口，单位毫秒，targetMs为0时关闭拒绝
+    void SetQueueTarget(int targetMs, int intervalMs) {
+        std::lock_guard<std::mutex> lg(pool_->mtx);
+        pool_->codel.SetTarget(static_cast<int64_t>(targetMs) * 1000000,
+                               static_cast<int64_t>(intervalMs) * 1000000);
+    }
+
 private:
+    struct Pool;
+
+    // 工作线程唯一的作用就是运行一个循环，不断地从task中取出待处理的函数
+    static void Work_(std::shared_ptr<Pool> pool) {
+        std::unique_lock<std::mutex> uq_lock(pool->mtx);
+        while (true) {
+            // 线程数被调小了，多出来的线程退出
+            if (pool->workers > pool->threads.load(std::memory_order_relaxed)) {
+                pool->workers--;
+                break;
+            }
+            // 这里if循环的顺序很重要，就算是缓存池已经被关了，如果任务队列不空，也必须将所有任务处理完了再退出线程
+            if (!pool->tasks.empty()) {
+                // 任务队列有待处理的任务
+                // 在锁的保护下取出任务队列的第一个任务
+                auto task = std::move(pool->tasks.front());
+                pool->tasks.pop();
+                pool->depth.store(pool->tasks.size(), std::memory_order_relaxed);
+                int64_t start = NowNs_();
+                pool->codel.OnDequeue(start - task.enqueueNs, start);
+                uq_lock.unlock();
+                task.func();
+                int64_t cost = NowNs_() - start;
+                uq_lock.lock();
+                // 任务平均耗时，EWMA，新的占1/8
+                int64_t avg = pool->serviceNs.load(std::memory_order_relaxed);
+                pool->serviceNs.store(avg + (cost - avg) / 8, std::memory_order_relaxed);
+            } else if (pool->isClosed) {
+                // 线程池已经关闭
+                break;
+            } else {
+                // 暂时无任务，通过条件变量阻塞
+                pool->codel.OnIdle();
+                pool->cond.wait(uq_lock);
+            }
+        }
+    }
+
+    static int64_t NowNs_() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // 任务和它入队的时间
+    struct Task {
+        std::function<void()> func;
+        int64_t enqueueNs;
+    };
+
     // 缓存池对象，封装了缓存池的锁，条件变量，状态，任务队列
     struct Pool {
         std::mutex mtx;
         std::condition_variable cond;
         bool isClosed;
-        std::queue<std::function<void()>> tasks;
+        std::queue<Task> tasks;
+        size_t workers = 0;             // 正在运行的线程数
+        std::atomic<size_t> threads{1}; // 应该有的线程数，ShouldShed不加锁读
+        CoDel codel;
+        // 下面两个在锁中修改，ShouldShed不加锁读
+        std::atomic<size_t> depth{0};
+        std::atomic<int64_t> serviceNs{0};
     };
     std::shared_ptr<Pool> pool_;
 };
@@ -0,0 +1,137 @@
+#include "Pool/sqlbatchinserter.hpp"
+
+using namespace std;
+
+SqlBatchInserter::SqlBatchInserter(const string &table, const vector<string> &columns,
+                                   size_t maxRows, int windowMs, Check check)
+    : table_(table), columns_(columns), maxRows_(maxRows), window_(windowMs),
+      check_(std::move(check)), inflight_(0), stop_(false) {
+    assert(!columns_.empty() && maxRows_ > 0);
+    thread_.reset(new thread(&SqlBatchInserter::Run_, this));
+}
+
+// 退出之前把剩下的行都提交出去，并等它们执行完
+SqlBatchInserter::~SqlBatchInserter() {
+    {
+        lock_guard<mutex> locker(mtx_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    thread_->join();
+    unique_lock<mutex> locker(mtx_);
+    cond_.wait(locker, [this] { return inflight_ == 0; });
+}
+
+void SqlBatchInserter::Add(Row row, Done done) {
+    assert(row.size() == columns_.size());
+    bool first = false;
+    {
+        lock_guard<mutex> locker(mtx_);
+        first = items_.empty();
+        items_.push_back({std::move(row), std::move(done)});
+        first = first || items_.size() >= maxRows_;
+    }
+    // 只有开始一个新的窗口或者攒够了才需要叫醒后台线程
+    if (first) {
+        cond_.notify_one();
+    }
+}
+
+void SqlBatchInserter::Run_() {
+    unique_lock<mutex> locker(mtx_);
+    while (true) {
+        cond_.wait(locker, [this] { return stop_ || !items_.empty(); });
+        if (items_.empty()) {
+            break;
+        }
+        // 第一行到了之后再等一个窗口，攒更多的行
+        cond_.wait_for(locker, window_, [this] { return stop_ || items_.size() >= maxRows_; });
+        auto batch = make_shared<vector<Item>>();
+        if (items_.size() <= maxRows_) {
+            batch->swap(items_);
+        } else {
+            batch->assign(make_move_iterator(items_.begin()),
+                          make_move_iterator(items_.begin() + maxRows_));
+            items_.erase(items_.begin(), items_.begin() + maxRows_);
+        }
+        inflight_++;
+        locker.unlock();
+        SqlExecutor::Instance()->Submit([this, batch](MYSQL *sql) {
+            Insert_(sql, *batch);
+            lock_guard<mutex> locker(mtx_);
+            inflight_--;
+            cond_.notify_all();
+        });
+        locker.lock();
+    }
+}
+
+void SqlBatchInserter::Insert_(MYSQL *sql, vector<Item> &batch) {
+    // 先逐行检查，没通过的行不参与插入
+    if (check_) {
+        size_t kept = 0;
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (!check_(sql, batch[i].row)) {
+                batch[i].done(false);
+            } else if (kept++ != i) {
+                batch[kept - 1] = std::move(batch[i]);
+            }
+        }
+        batch.resize(kept);
+        if (batch.empty()) {
+            return;
+        }
+    }
+    if (Exec_(sql, batch.data(), batch.size())) {
+        LOG_DEBUG("Batch insert %d rows into %s", static_cast<int>(batch.size()), table_.c_str());
+        for (auto &item : batch) {
+            item.done(true);
+        }
+        return;
+    }
+    if (batch.size() == 1) {
+        batch[0].done(false);
+        return;
+    }
+    LOG_WARN("Batch insert into %s failed, retry row by row", table_.c_str());
+    for (auto &item : batch) {
+        item.done(Exec_(sql, &item, 1));
+    }
+}
+
+// 用n行的预编译语句插入items中的n行
+bool SqlBatchInserter::Exec_(MYSQL *sql, Item *items, size_t n) {
+    SqlStmtCache *cache = sql ? SqlConnPool::Instance()->GetStmtCache(sql) : nullptr;
+    MYSQL_STMT *stmt = cache ? cache->Get(Query_(n)) : nullptr;
+    if (!stmt) {
+        return false;
+    }
+    size_t cols = columns_.size();
+    SqlBinds binds(n * cols);
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            binds.SetParam(i * cols + j, items[i].row[j]);
+        }
+    }
+    if (mysql_stmt_bind_param(stmt, binds.Data()) || mysql_stmt_execute(stmt)) {
+        LOG_DEBUG("Insert error: %s", mysql_stmt_error(stmt));
+        return false;
+    }
+    return true;
+}
+
+// INSERT INTO table(a,b) VALUES(?,?),(?,?)...
+string SqlBatchInserter::Query_(size_t rows) const {
+    string query = "INSERT INTO " + table_ + "(";
+    string values = "(";
+    for (size_t j = 0; j < columns_.size(); j++) {
+        query += (j ? "," : "") + columns_[j];
+        values += j ? ",?" : "?";
+    }
+    values += ")";
+    query += ") VALUES";
+    for (size_t i = 0; i < rows; i++) {
+        query += (i ? "," : "") + values;
+    }
+    return query;
+}
@@ -1,84 +1,335 @@
 #include "Pool/sqlconnpool.hpp"
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <mysql/errmsg.h>
+#include "Metrics/metrics.hpp"
 using namespace std;
 
-SqlConnPool::SqlConnPool() {
-    useCount_ = 0;
-    freeCount_ = 0;
-}
+static Histogram waitSeconds("sql_pool_wait_seconds", "Time GetConn spent waiting for a connection");
+static CallbackGauge poolSize("sql_pool_connections", "Open MySQL connections", [] {
+    return static_cast<double>(SqlConnPool::Instance()->GetStats().size);
+});
+static CallbackGauge poolIdle("sql_pool_idle_connections", "Idle MySQL connections", [] {
+    return static_cast<double>(SqlConnPool::Instance()->GetStats().idle);
+});
+static CallbackCounter poolTimeouts("sql_pool_timeouts_total", "GetConn calls that timed out", [] {
+    return static_cast<double>(SqlConnPool::Instance()->GetStats().timeouts);
+});
+
+// 客户端库在进程内只初始化一次，ClosePool之后再Init不会重复初始化
+static once_flag libraryOnce;
+static bool libraryInited = false;
+
+constexpr chrono::seconds SqlConnPool::PING_INTERVAL;
+constexpr chrono::seconds SqlConnPool::RETRY_INTERVAL;
+constexpr chrono::seconds SqlConnPool::IDLE_TIMEOUT;
+
+SqlConnPool::SqlConnPool()
+    : port_(0), maxSize_(0), minSize_(0), waitTimeoutMs_(0), size_(0), down_(false),
+      closed_(true), stats_() {}
 
 SqlConnPool *SqlConnPool::Instance() {
     static SqlConnPool connPool;
     return &connPool;
 }
-// 初始化若干个mysql连接
+
+// 只记录配置，最少的连接由后台线程建立，启动时不需要等连接
 void SqlConnPool::Init(const char *host, int port, const char *user, const char *pwd,
-                       const char *dbName, int connSize = 10) {
-    assert(connSize > 0);
+                       const char *dbName, int connSize, int minSize, int waitTimeoutMs) {
+    assert(connSize > 0 && minSize >= 0);
+    {
+        lock_guard<mutex> locker(mtx_);
+        if (!closed_) {
+            LOG_WARN("SqlConnPool already initialized!");
+            return;
+        }
+        host_ = host;
+        port_ = port;
+        user_ = user;
+        pwd_ = pwd;
+        dbName_ = dbName;
+        maxSize_ = connSize;
+        minSize_ = min(minSize, connSize);
+        waitTimeoutMs_ = waitTimeoutMs;
+        down_ = false;
+        closed_ = false;
+        stats_ = Stats();
+    }
+    // mysql_init第一次调用时会隐式初始化客户端库，这一步不是线程安全的，
+    // 所以在启动后台线程之前显式初始化，和析构函数中的mysql_library_end配对
+    call_once(libraryOnce, [] {
+        if (mysql_library_init(0, nullptr, nullptr)) {
+            LOG_ERROR("MySql library init error!");
+            return;
+        }
+        libraryInited = true;
+    });
+    monitor_.reset(new thread(&SqlConnPool::Monitor_, this));
+}
 
-    for (int i = 0; i < connSize; i++) {
-        MYSQL *sql = nullptr;
-        sql = mysql_init(sql);
-        if (!sql) {
-            LOG_ERROR("MySql init error!");
-            assert(sql);
+MYSQL *SqlConnPool::GetConn() { return GetConn(waitTimeoutMs_); }
+
+// 优先用空闲的连接，没有的话在maxSize以内新建，都不行再等别人归还
+MYSQL *SqlConnPool::GetConn(int timeoutMs) {
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + chrono::milliseconds(max(timeoutMs, 0));
+    bool waited = false;
+    MYSQL *sql = nullptr;
+    unique_lock<mutex> locker(mtx_);
+    stats_.gets++;
+    while (!closed_) {
+        if (!idle_.empty()) {
+            sql = idle_.back().sql;
+            idle_.pop_back();
+            break;
         }
-        sql = mysql_real_connect(sql, host, user, pwd, dbName, port, nullptr, 0);
-        if (!sql) {
-            LOG_ERROR("MySql Connect error!");
+        // 数据库不可用时不排队，直接失败
+        if (down_) {
+            stats_.failFast++;
+            break;
+        }
+        if (size_ < maxSize_) {
+            size_++;
+            locker.unlock();
+            sql = Connect_();
+            locker.lock();
+            if (sql) {
+                Adopt_(sql);
+            } else {
+                size_--;
+                stats_.failFast++;
+            }
+            break;
+        }
+        if (timeoutMs >= 0 && Clock::now() >= deadline) {
+            stats_.timeouts++;
+            LOG_WARN("SqlConnPool busy!");
+            break;
+        }
+        waited = true;
+        if (timeoutMs < 0) {
+            cond_.wait(locker);
+        } else {
+            cond_.wait_until(locker, deadline);
         }
-        connQue_.push(sql);
     }
-    MAX_CONN_ = connSize;
-    sem_init(&semId_, 0, MAX_CONN_);
+    uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+    if (waited) {
+        uint64_t us = ns / 1000;
+        stats_.waits++;
+        stats_.waitUsTotal += us;
+        stats_.waitUsMax = max(stats_.waitUsMax, us);
+    }
+    locker.unlock();
+    waitSeconds.Record(ns);
+    return sql;
 }
 
-// 获取一个mysql连接
-MYSQL *SqlConnPool::GetConn() {
-    MYSQL *sql = nullptr;
-    if (connQue_.empty()) {
-        LOG_WARN("SqlConnPool busy!");
+// 归还mysql连接，已经断开的连接直接关闭，由后台线程或者下一次GetConn补上
+void SqlConnPool::FreeConn(MYSQL *sql) {
+    assert(sql);
+    unsigned int err = mysql_errno(sql);
+    bool broken = (err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST);
+    {
+        lock_guard<mutex> locker(mtx_);
+        if (!broken && !closed_) {
+            idle_.push_back({sql, Clock::now()});
+            cond_.notify_one();
+            return;
+        }
+        size_--;
+        stats_.broken += broken;
+    }
+    Close_(sql);
+    cond_.notify_one();
+}
+
+SqlStmtCache *SqlConnPool::GetStmtCache(MYSQL *sql) {
+    lock_guard<mutex> locker(mtx_);
+    auto it = stmtCaches_.find(sql);
+    return it == stmtCaches_.end() ? nullptr : it->second.get();
+}
+
+SqlConnPool::Stats SqlConnPool::GetStats() {
+    lock_guard<mutex> locker(mtx_);
+    Stats stats = stats_;
+    stats.size = size_;
+    stats.idle = static_cast<int>(idle_.size());
+    stats.maxSize = maxSize_;
+    return stats;
+}
+
+// 建立一个新的连接，不持有锁，失败时返回nullptr
+MYSQL *SqlConnPool::Connect_() {
+    MYSQL *sql = mysql_init(nullptr);
+    if (!sql) {
+        LOG_ERROR("MySql init error!");
+        lock_guard<mutex> locker(mtx_);
+        stats_.connectErrors++;
+        down_ = true;
+        return nullptr;
+    }
+    unsigned int timeout = CONNECT_TIMEOUT_S;
+    mysql_options(sql, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+    if (!mysql_real_connect(sql, host_.c_str(), user_.c_str(), pwd_.c_str(), dbName_.c_str(),
+                            port_, nullptr, 0)) {
+        LOG_ERROR("MySql Connect error: %s", mysql_error(sql));
+        mysql_close(sql);
+        lock_guard<mutex> locker(mtx_);
+        stats_.connectErrors++;
+        down_ = true;
         return nullptr;
     }
-    // 先通过信号量确定是否有
-    sem_wait(&semId_);
+    return sql;
+}
+
+// 持有锁：登记新建的连接，连上之后数据库恢复可用
+void SqlConnPool::Adopt_(MYSQL *sql) {
+    stmtCaches_[sql].reset(new SqlStmtCache(sql));
+    stats_.connects++;
+    if (down_) {
+        LOG_INFO("MySql connection recovered");
+        down_ = false;
+    }
+}
+
+// 不持有锁：先关闭连接上的预编译语句，再关闭连接
+void SqlConnPool::Close_(MYSQL *sql) {
+    unique_ptr<SqlStmtCache> cache;
     {
-        // 信号量确定有，锁帮助不会发生竞态条件
-        // 但是这里的代码在关闭连接池时，好像没有考虑到并发的问题，有可能是因为关闭连接池的时候所有线程都结束了，所以不会发生？
-        // 加上判断为空的条件还是要好点
         lock_guard<mutex> locker(mtx_);
-        if (connQue_.empty()) {
-            return sql; // nullptr
+        auto it = stmtCaches_.find(sql);
+        if (it != stmtCaches_.end()) {
+            cache = std::move(it->second);
+            stmtCaches_.erase(it);
         }
-        sql = connQue_.front();
-        connQue_.pop();
     }
-    return sql;
+    cache.reset();
+    mysql_close(sql);
 }
 
-// 归还mysql连接，加锁放入，然后将信号量加1
-void SqlConnPool::FreeConn(MYSQL *sql) {
-    assert(sql);
-    lock_guard<mutex> locker(mtx_);
-    connQue_.push(sql);
-    sem_post(&semId_);
+void SqlConnPool::Monitor_() {
+    unique_lock<mutex> locker(mtx_);
+    while (!closed_) {
+        FillMin_(locker);
+        if (monitorCond_.wait_for(locker, down_ ? RETRY_INTERVAL : PING_INTERVAL,
+                                  [this] { return closed_; })) {
+            break;
+        }
+        CheckIdle_(locker);
+    }
+    locker.unlock();
+    // 后台线程用过客户端库，退出前释放库给这个线程分配的资源
+    mysql_thread_end();
+}
+
+// 取出空闲了一个PING_INTERVAL以上的连接：超过minSize并且空闲太久的关闭，其余的ping一下
+// ping的时候不持有锁，这些连接暂时不会被GetConn拿到
+void SqlConnPool::CheckIdle_(unique_lock<mutex> &locker) {
+    Clock::time_point now = Clock::now();
+    vector<IdleConn> checking;
+    vector<MYSQL *> expired;
+    int keep = size_;
+    auto it = idle_.begin();
+    while (it != idle_.end() && now - it->since >= PING_INTERVAL) {
+        if (keep > minSize_ && now - it->since >= IDLE_TIMEOUT) {
+            expired.push_back(it->sql);
+            keep--;
+        } else {
+            checking.push_back(*it);
+        }
+        ++it;
+    }
+    idle_.erase(idle_.begin(), it);
+    size_ -= static_cast<int>(expired.size());
+    locker.unlock();
+
+    for (MYSQL *sql : expired) {
+        Close_(sql);
+    }
+    vector<IdleConn> alive;
+    int broken = 0;
+    for (auto &conn : checking) {
+        if (mysql_ping(conn.sql) == 0) {
+            alive.push_back(conn);
+        } else {
+            LOG_WARN("MySql ping error: %s", mysql_error(conn.sql));
+            Close_(conn.sql);
+            broken++;
+        }
+    }
+
+    locker.lock();
+    // 放回队头，仍然是最先被回收的
+    idle_.insert(idle_.begin(), alive.begin(), alive.end());
+    size_ -= broken;
+    stats_.broken += broken;
+    if (!alive.empty()) {
+        cond_.notify_all();
+    }
+}
+
+// 连接数低于minSize时补上；数据库不可用时至少试一个，连上之后恢复
+void SqlConnPool::FillMin_(unique_lock<mutex> &locker) {
+    while (!closed_ && size_ < maxSize_ && (size_ < minSize_ || down_)) {
+        size_++;
+        locker.unlock();
+        MYSQL *sql = Connect_();
+        locker.lock();
+        if (!sql) {
+            size_--;
+            break;
+        }
+        Adopt_(sql);
+        if (closed_) {
+            size_--;
+            locker.unlock();
+            Close_(sql);
+            locker.lock();
+            break;
+        }
+        idle_.push_back({sql, Clock::now()});
+        cond_.notify_one();
+    }
 }
 
-// 关闭连接池
+// 关闭连接池：停止后台线程，关闭空闲的连接，正在使用的连接在归还时关闭
+// 客户端库在这里不结束，归还时还要用它关闭连接，之后也可以再次Init
 void SqlConnPool::ClosePool() {
-    lock_guard<mutex> locker(mtx_);
-    while (!connQue_.empty()) {
-        auto item = connQue_.front();
-        connQue_.pop();
-        mysql_close(item);
+    {
+        lock_guard<mutex> locker(mtx_);
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+    }
+    monitorCond_.notify_all();
+    cond_.notify_all();
+    if (monitor_ && monitor_->joinable()) {
+        monitor_->join();
+    }
+    monitor_.reset();
+    deque<IdleConn> idle;
+    {
+        lock_guard<mutex> locker(mtx_);
+        idle.swap(idle_);
+        size_ -= static_cast<int>(idle.size());
+    }
+    for (auto &conn : idle) {
+        Close_(conn.sql);
     }
-    mysql_library_end();
 }
 
 int SqlConnPool::GetFreeConnCount() {
     lock_guard<mutex> locker(mtx_);
-    return connQue_.size();
+    return static_cast<int>(idle_.size());
 }
 
+// 连接池在进程退出时析构，这时才结束客户端库
 SqlConnPool::~SqlConnPool() {
     ClosePool();
+    if (libraryInited) {
+        mysql_library_end();
+    }
 }
@@ -0,0 +1,39 @@
+#include "Pool/sqlexecutor.hpp"
+
+SqlExecutor *SqlExecutor::Instance() {
+    static SqlExecutor executor;
+    return &executor;
+}
+
+void SqlExecutor::Init(int threadNum) {
+    assert(threadNum > 0);
+    if (!pool_) {
+        pool_.reset(new ThreadPool(threadNum));
+    }
+}
+
+void SqlExecutor::Submit(Job job) {
+    if (!pool_) {
+        Run_(job);
+        return;
+    }
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    pool_->AddTask([this, job = std::move(job)] {
+        Run_(job);
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+    });
+}
+
+// 执行过任务的线程退出时（比如线程池关闭、线程数调小）释放客户端库给这个线程分配的资源
+struct SqlThreadGuard {
+    ~SqlThreadGuard() { mysql_thread_end(); }
+};
+
+// 在当前线程中拿一个连接执行任务，任务结束后归还连接
+void SqlExecutor::Run_(const Job &job) {
+    static thread_local SqlThreadGuard guard;
+    (void)guard;
+    MYSQL *sql = nullptr;
+    SqlConnRAII holder(&sql, SqlConnPool::Instance());
+    job(sql);
+}
@@ -0,0 +1,27 @@
+#include "Pool/sqlstmtcache.hpp"
+
+MYSQL_STMT *SqlStmtCache::Get(const std::string &query) {
+    auto it = stmts_.find(query);
+    if (it != stmts_.end()) {
+        return it->second;
+    }
+    MYSQL_STMT *stmt = mysql_stmt_init(sql_);
+    if (!stmt) {
+        LOG_ERROR("mysql_stmt_init error!");
+        return nullptr;
+    }
+    if (mysql_stmt_prepare(stmt, query.data(), query.size()) != 0) {
+        LOG_ERROR("Prepare [%s] error: %s", query.c_str(), mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+    stmts_.emplace(query, stmt);
+    return stmt;
+}
+
+void SqlStmtCache::Clear() {
+    for (auto &item : stmts_) {
+        mysql_stmt_close(item.second);
+    }
+    stmts_.clear();
+}
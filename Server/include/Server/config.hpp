@@ -0,0 +1,93 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+INI格式的配置文件，加上命令行覆盖
+1. 配置文件：
+     [section]
+     key = value    # 或者;开头的注释
+   key在程序中的名字是section.key；同一个key可以写多次（比如限速规则），Get取最后一个，GetAll取全部
+2. 命令行：-c path 或者 --config=path 指定配置文件，--section.key=value 覆盖配置文件中的值
+3. Load每次都重新读配置文件，再应用命令行的覆盖，SIGHUP重新加载时也是这样
+*/
+class Config {
+public:
+    bool ParseArgs(int argc, char *argv[], std::string *err);
+    // 没有指定配置文件时只有命令行的值
+    bool Load(std::string *err);
+    // 解析配置文件的内容，替换之前的值，name用在错误信息中
+    bool LoadString(const std::string &text, const std::string &name, std::string *err);
+    // 和命令行的覆盖一样，重新Load之后仍然有效
+    void Set(const std::string &key, const std::string &value);
+
+    const std::string &Path() const { return path_; }
+    bool Has(const std::string &key) const { return values_.count(key) > 0; }
+    std::vector<std::string> GetAll(const std::string &key) const;
+
+    // key不存在时value不变，返回true；格式不对时返回false
+    bool Get(const std::string &key, std::string *value) const;
+    bool Get(const std::string &key, int *value) const;
+    bool Get(const std::string &key, double *value) const;
+    bool Get(const std::string &key, bool *value) const;
+
+private:
+    std::string path_;
+    std::vector<std::pair<std::string, std::string>> overrides_;
+    std::map<std::string, std::vector<std::string>> values_;
+};
+
+// 一条限速规则：请求行以prefix开头的请求，每个IP每秒rate个，突发burst个
+struct RateRule {
+    std::string prefix;
+    double rate;
+    double burst;
+};
+
+// WebServer的所有参数和默认值
+struct ServerOptions {
+    // 只在启动时使用，修改之后需要重启
+    int port = 1316;
+    int trigMode = 3;         // 0 LT，1 连接ET，2 监听ET，3 都是ET
+    bool optLinger = false;   // 优雅关闭
+    std::string srcDir;       // 静态文件目录，为空时是当前目录的上一级中的resources
+    std::string upgradePath = "./myServer.sock"; // 平滑重启的unix socket，为空时关闭
+    std::string sqlHost = "localhost";
+    int sqlPort = 3306;
+    std::string sqlUser = "root";
+    std::string sqlPwd = "123456";
+    std::string dbName = "yourdb";
+    int connPoolNum = 12;
+    bool openLog = true;
+    int logQueSize = 1024;
+    int tlsPort = 0;          // HTTPS端口，0为不打开
+    std::string tlsCert;      // PEM格式的证书（链）和私钥
+    std::string tlsKey;
+    bool tlsKtls = true;      // 内核支持时把加解密交给内核
+    int tlsSessionCache = 20480; // 会话缓存的条目数，用于会话复用
+    int tlsSessionTimeoutSec = 300;
+
+    // 收到SIGHUP时重新加载，不需要重启
+    int threadNum = 6;
+    int timeoutMS = 60000;    // 连接的超时时间，0为不超时
+    int drainMS = 10000;      // 平滑重启时旧进程最多等多久
+    int logLevel = 1;
+    int authCacheSize = 4096; // 登录验证缓存的条目数
+    int authCacheTtlSec = 60;
+    int authCacheNegativeTtlSec = 5;
+    int traceRingSize = 8192; // 每个线程保存的追踪span个数
+    int maxConnPerIp = 1024;  // 0为不限制
+    int queueTargetMS = 5;    // 0为不拒绝
+    int queueIntervalMS = 100;
+    double rate = 0;          // 每个IP每秒的请求数，0为不限制
+    double burst = 0;
+    std::vector<RateRule> rateRules;
+
+    // 从配置中读出所有参数并检查范围，出错时err说明是哪一个
+    static bool FromConfig(const Config &config, ServerOptions *options, std::string *err);
+};
+
+#endif // SERVER_CONFIG_H
@@ -0,0 +1,58 @@
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+#include <atomic>
+#include <memory>
+#include <assert.h>
+
+#include "Http/httpconn.hpp"
+#include "SkipList/kvstore.hpp"
+
+/*
+以fd为下标的连接表，代替unordered_map<int, HttpConn>
+1. 槽位数组在构造时就分配好，不会rehash，工作线程持有的HttpConn*一直有效
+2. HttpConn在某个fd第一次被使用时才创建，之后复用，所有连接共享同一个KvStore
+3. 每个槽位有一个代数（generation），打开和关闭连接时都会加一，
+   定时器和任务保存fd+代数，执行时如果代数对不上，说明连接已经被关闭或者fd被复用了
+4. 连接交给工作线程之后标记为已分发，直到工作线程把它交还给主循环（重新监听或者关闭）；
+   这期间主循环（定时器、排空）不能关闭它，只记下要关闭，交还时再关闭。这些标记只在主循环中读写
+*/
+class ConnTable {
+public:
+    ConnTable(int maxFd, std::shared_ptr<KvStore> kv);
+    ~ConnTable() = default;
+
+    HttpConn *Open(int fd, const sockaddr_in &addr, uint32_t *gen);
+
+    HttpConn *Get(int fd) const;
+
+    HttpConn *Get(int fd, uint32_t gen) const;
+
+    uint32_t Generation(int fd) const;
+
+    bool Retire(int fd, uint32_t gen);
+
+    void Dispatch(int fd);
+
+    bool Dispatched(int fd) const;
+
+    void DeferClose(int fd);
+
+    bool HandBack(int fd);
+
+    int MaxFd() const { return maxFd_; }
+
+private:
+    struct Slot {
+        std::unique_ptr<HttpConn> conn;
+        std::atomic<uint32_t> gen{0};
+        bool dispatched = false;
+        bool closePending = false;
+    };
+
+    int maxFd_;
+    std::unique_ptr<Slot[]> slots_;
+    std::shared_ptr<KvStore> kv_;
+};
+
+#endif // CONN_TABLE_H
@@ -1,16 +1,31 @@
 #ifndef EPOLLER_H
 #define EPOLLER_H
 
-#include <sys/epoll.h> 
-#include <fcntl.h> 
-#include <unistd.h> 
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <assert.h>
 #include <vector>
+#include <thread>
+#include <functional>
 #include <errno.h>
+#include "Log/lockfreequeue.hpp"
 
+/*
+Epoller除了封装epoll之外，还负责记录每个fd当前注册的事件（interest）
+1. masks_记录每个fd当前注册的事件，armed_记录EPOLLONESHOT的fd是否还处于激活状态，
+   如果要设置的事件和当前一致并且还处于激活状态，就跳过这次epoll_ctl
+2. 工作线程不直接调用epoll_ctl，而是通过PostModFd把修改放入无锁队列pending_，
+   然后通过eventfd唤醒主循环，由主循环在ApplyPending中批量处理，
+   主循环处理完之前的唤醒之前，后续的PostModFd不会再写eventfd
+3. 提交的修改带着连接的代数，ApplyPending时由调用者检查，
+   连接已经被关闭（fd可能被复用了）的修改直接丢掉
+除了PostModFd，其他函数都只能在主循环中调用；masks_和armed_在构造时就分配好，不会扩容
+*/
 class Epoller {
 public:
-    explicit Epoller(int maxEvent = 1024);
+    explicit Epoller(int maxEvent = 1024, int maxFd = 65536);
 
     ~Epoller();
 
@@ -20,16 +35,38 @@ public:
 
     bool DelFd(int fd);
 
+    void PostModFd(int fd, uint32_t events, uint32_t gen = 0);
+
+    // accept为空时全部应用，否则只应用accept(fd, gen)返回true的修改
+    void ApplyPending(const std::function<bool(int, uint32_t)> &accept = nullptr);
+
+    int GetWakeFd() const { return notifier_.Fd(); }
+
     int Wait(int timeoutMs = -1);
 
     int GetEventFd(size_t i) const;
 
     uint32_t GetEvents(size_t i) const;
-        
+
 private:
+    bool Ctl_(int op, int fd, uint32_t events);
+
     int epollFd_;
 
-    std::vector<struct epoll_event> events_;    
+    QueueNotifier notifier_;
+
+    std::vector<struct epoll_event> events_;
+
+    std::vector<uint32_t> masks_;
+
+    std::vector<uint8_t> armed_;
+
+    struct PendingMod {
+        int fd;
+        uint32_t events;
+        uint32_t gen;
+    };
+    MpscQueue<PendingMod> pending_;
 };
 
-#endif //EPOLLER_H
\ No newline at end of file
+#endif //EPOLLER_H
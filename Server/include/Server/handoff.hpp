@@ -0,0 +1,29 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <string>
+
+/*
+平滑重启时在新旧两个进程之间传递监听socket
+1. 旧进程在一个unix socket上等待，新进程启动时先去连接它
+2. 旧进程用SCM_RIGHTS把监听fd（HTTP和HTTPS各一个）发给新进程，两边拿到的是同一个socket，
+   内核中已经排队的连接不会丢，新进程收到之后马上可以accept
+3. 旧进程处理完已有的连接，保存好kv之后，在同一个连接上写一个字节通知新进程
+4. socket文件的权限是0600，两边都用SO_PEERCRED确认对方和自己是同一个用户，别的用户拿不到监听fd，
+   也不能冒充旧进程
+*/
+namespace handoff {
+    // 删除残留的socket文件之后监听path（只有自己的用户可以连接），返回非阻塞的fd，失败返回-1
+    int Listen(const std::string &path);
+    // 连接path上的旧进程，没有旧进程（或者对方不是同一个用户）时返回-1
+    int Connect(const std::string &path);
+    // 连接的对方和自己是不是同一个用户
+    bool SameUser(int sock);
+    static const int MAX_FDS = 4;
+    // 一次发送count个fd，附带一个字节的数据
+    bool SendFds(int sock, const int *fds, int count);
+    // 接收对方发来的fd，最多等待timeoutMS，返回收到的个数，失败返回-1
+    int RecvFds(int sock, int *fds, int maxCount, int timeoutMS);
+} // namespace handoff
+
+#endif // HANDOFF_H
@@ -0,0 +1,33 @@
+#ifndef IP_LIMITER_H
+#define IP_LIMITER_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+
+/*
+每个客户端IP同时打开的连接数上限，主循环accept之后TryAcquire，关闭连接的线程Release
+1. 固定大小的计数数组，按IP的哈希找槽位，不分配内存，也不需要删除
+2. 不同的IP可能落在同一个槽位上，相当于共享一个上限，槽位足够多时影响很小
+3. 上限为0时不限制
+*/
+class IpLimiter {
+public:
+    explicit IpLimiter(int limit = 1024, size_t slots = 65536);
+
+    // 连接数没有超过上限时加一并返回true
+    bool TryAcquire(uint32_t ip);
+    void Release(uint32_t ip);
+
+    void SetLimit(int limit) { limit_.store(limit, std::memory_order_relaxed); }
+    int Count(uint32_t ip) const { return counts_[Slot_(ip)].load(std::memory_order_relaxed); }
+
+private:
+    size_t Slot_(uint32_t ip) const;
+
+    std::atomic<int> limit_;
+    size_t mask_;
+    std::unique_ptr<std::atomic<int32_t>[]> counts_;
+};
+
+#endif // IP_LIMITER_H
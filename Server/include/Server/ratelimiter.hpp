@@ -0,0 +1,94 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+按客户端IP限速的令牌桶表
+1. 规则0是每个IP的总速率，另外可以按请求行的前缀加规则，同一个IP的每条规则各有一个桶
+   请求行是"方法 路径 版本"，比如"POST / "只匹配路径正好是/的POST（kv操作），"GET /images/"匹配一个目录
+2. 表的大小在构造时固定，不会随着IP的数量增长，检查时不分配内存：
+   按(IP, 规则)的哈希选分片，分片内再选一组，每组WAYS个桶；
+   组满了就替换其中最久没有访问的桶（近似LRU），被替换的IP下次来时重新从满桶开始
+   同时活跃的IP远多于桶的个数时限速会变松，但不会误伤
+3. 主循环在可读事件上用Check看一眼还有没有令牌（不取走），没有就直接拒绝，不进入线程池；
+   工作线程每解析出一个完整的请求用Allow取走一个令牌，流水线上的每个请求都会被计数
+4. 每个分片一把锁，分片按缓存行对齐，锁只在同一个分片上同时有几个线程检查时才有竞争
+5. 规则很少修改（启动和重新加载配置时），检查时不加锁：修改时复制一份新的规则表再原子地替换，
+   旧的规则表保留到限速器析构，正在检查的线程不会读到已经释放的内存；速率为0的规则不限制
+*/
+class RateLimiter {
+public:
+    static const int MAX_RULES = 16;
+    static const int IP_RULE = 0;
+
+    // capacity：桶的总数，会向上取整到分片数*组大小的倍数
+    explicit RateLimiter(size_t capacity = 1 << 18);
+
+    // 每个IP的总速率（每秒请求数）和突发上限
+    void SetIpRate(double rate, double burst);
+    // 请求行以prefix开头的请求再加一条规则，prefix已经存在时更新速率，返回规则编号，规则满了返回-1
+    int AddRule(const std::string &prefix, double rate, double burst);
+    void ClearRules();
+
+    bool Enabled() const { return rules_.load(std::memory_order_acquire)->enabled; }
+    // 有没有生效的请求行规则，没有时不需要看请求行
+    bool HasRequestRules() const { return rules_.load(std::memory_order_acquire)->hasRequestRules; }
+    // 最长前缀匹配的请求行规则，没有时返回-1
+    int Match(const char *line, size_t len) const;
+
+    // 规则rule下ip还有令牌时取走一个并返回true
+    bool Allow(uint32_t ip, int rule, int64_t nowNs);
+    // 和Allow一样判断，但不取走令牌，也不为没见过的IP占用桶
+    bool Check(uint32_t ip, int rule, int64_t nowNs);
+
+    size_t Capacity() const { return SHARDS * setsPerShard_ * WAYS; }
+    uint64_t Evictions() const { return evictions_.load(std::memory_order_relaxed); }
+
+private:
+    static const size_t SHARDS = 16;
+    static const size_t WAYS = 4;
+
+    struct Rule {
+        std::string prefix;
+        double rate = 0; // 每纳秒补充的令牌数
+        double burst = 0;
+    };
+
+    struct RuleSet {
+        Rule rules[MAX_RULES];
+        int count = 1;
+        bool enabled = false;
+        bool hasRequestRules = false;
+    };
+
+    struct Bucket {
+        uint64_t key; // 0表示空
+        int64_t lastNs;
+        double tokens;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mtx;
+        std::unique_ptr<Bucket[]> buckets;
+    };
+
+    // 复制当前的规则表，改完之后用Publish_替换
+    std::unique_ptr<RuleSet> Copy_() const;
+    void Publish_(std::unique_ptr<RuleSet> next);
+    bool Take_(uint32_t ip, int rule, int64_t nowNs, bool take);
+
+    size_t setsPerShard_;
+    std::atomic<const RuleSet *> rules_;
+    std::mutex updateMtx_; // 保护versions_，修改规则的线程之间互斥
+    std::vector<std::unique_ptr<RuleSet>> versions_;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<uint64_t> evictions_;
+};
+
+#endif // RATE_LIMITER_H
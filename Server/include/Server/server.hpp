@@ -1,7 +1,6 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
-#include <unordered_map>
 #include <fcntl.h>
 #include <unistd.h>
 #include <assert.h>
@@ -11,59 +10,143 @@
 #include <arpa/inet.h>
 
 #include "Server/epoller.hpp"
+#include "Server/conntable.hpp"
+#include "Server/iplimiter.hpp"
+#include "Server/ratelimiter.hpp"
+#include "Server/handoff.hpp"
+#include "Server/config.hpp"
 #include "Log/log.hpp"
 #include "Timer/heaptimer.hpp"
 #include "Pool/sqlconnpool.hpp"
 #include "Pool/threadpool.hpp"
 #include "Pool/sqlconnRALL.hpp"
+#include "Pool/sqlexecutor.hpp"
 #include "Http/httpconn.hpp"
+#include "Http/userauth.hpp"
 #include "SkipList/kvstore.hpp"
+#include "Metrics/metrics.hpp"
+#include "Metrics/tracer.hpp"
+#include "Metrics/slowlog.hpp"
 
+/*
+平滑重启：upgradePath不为空时，启动时先连接upgradePath上的旧进程，拿到它的监听socket，
+旧进程不再accept，处理完已有的连接（最多等drainMS）并保存kv之后退出，新进程再读回kv；
+连接不上说明没有旧进程，正常监听端口并加载上次保存的kv。之后自己在upgradePath上等待下一个进程
+*/
 class WebServer {
 public:
     WebServer(int port, int trigMode, int timeoutMS, bool OptLinger, int sqlPort,
               const char *sqlUser, const char *sqlPwd, const char *dbName, int connPoolNum,
-              int threadNum, bool openLog, int logLevel, int logQueSize);
+              int threadNum, bool openLog, int logLevel, int logQueSize,
+              const char *upgradePath = nullptr, int drainMS = 10000);
+    explicit WebServer(const ServerOptions &options);
 
     ~WebServer();
     void Start();
+    // 可以在其他线程中调用，主循环处理完当前这一批事件之后退出
+    void Stop();
+
+    // 收到SIGHUP时从config重新加载运行时可以修改的参数（线程数、超时、日志等级、缓存大小、限速）
+    // 没有调用过SetConfig时忽略SIGHUP
+    void SetConfig(const Config &config) {
+        config_ = config;
+        hasConfig_ = true;
+    }
+
+    // 过载保护，需要在Start之前设置
+    // 每个客户端IP最多同时打开的连接数，0为不限制
+    void SetMaxConnPerIp(int limit) { ipLimiter_.SetLimit(limit); }
+    // 线程池排队时间的目标和观察窗口（毫秒），持续超过目标时新请求直接回复503，targetMs为0时关闭
+    void SetQueueTarget(int targetMs, int intervalMs) {
+        threadpool_->SetQueueTarget(targetMs, intervalMs);
+    }
+    // 每个IP每秒的请求数和突发上限，超过的请求回复429，rate为0时不限制
+    void SetRateLimit(double rate, double burst) { rateLimiter_.SetIpRate(rate, burst); }
+    // 请求行以prefix开头的请求单独限速，比如"POST / "是kv操作
+    bool AddRateLimit(const std::string &prefix, double rate, double burst) {
+        return rateLimiter_.AddRule(prefix, rate, burst) >= 0;
+    }
 
 private:
-    bool InitSocket_();
+    int InitSocket_(int port, bool quiet = false);
+    bool InheritSocket_();
+    int PickListen_(int inherited, int fresh, int port);
+    void CloseListen_(int fd);
+    void DealUpgrade_();
+    void DealPredecessor_();
+    void CloseIdle_();
+    void CheckDrain_();
     void InitEventMode_(int trigMode);
-    void AddClient_(int fd, sockaddr_in addr);
+    void AddClient_(int fd, sockaddr_in addr, bool tls);
 
-    void DealListen_();
+    void DealListen_(int listenFd);
+    void DealHandshake_(HttpConn *client);
     void DealWrite_(HttpConn *client);
     void DealRead_(HttpConn *client);
 
     void SendError_(int fd, const char *info);
+    void Refuse_(HttpConn *client, const char *response);
+    bool CheckRate_(HttpConn *client);
+    bool Admit_(const HttpRequest &request);
     void ExtentTime_(HttpConn *client);
-    void CloseConn_(HttpConn *client);
+    void CloseConn_(HttpConn *client, uint32_t gen);
+    void CloseInLoop_(HttpConn *client, uint32_t gen);
+
+    void OnRead_(HttpConn *client, uint32_t gen);
+    void OnWrite_(HttpConn *client, uint32_t gen);
+    void OnProcess(HttpConn *client, uint32_t gen);
+    void StartVerify_(HttpConn *client, uint32_t gen);
+
+    void ApplyTunables_(const ServerOptions &options);
+    void Reload_();
 
-    void OnRead_(HttpConn *client);
-    void OnWrite_(HttpConn *client);
-    void OnProcess(HttpConn *client);
+    void QueueInLoop_(std::function<void()> task);
+    void RunLoopTasks_();
+    void RegisterAdmin_();
 
     static const int MAX_FD = 65536;
+    static const int MAX_LOOP_TASKS = 4096;
 
     static int SetFdNonblock(int fd);
 
+    ServerOptions options_;
+    Config config_;
+    bool hasConfig_ = false; // 参数不是从config来的（直接传给构造函数）时不能重新加载
     int port_;
     bool openLinger_;
     int timeoutMS_; /* 毫秒MS */
-    bool isClose_;
+    std::atomic<bool> isClose_;
     int listenFd_;
-    char *srcDir_;
+    int tlsPort_;     // HTTPS端口，0表示不打开
+    int tlsListenFd_;
+    std::string upgradePath_;
+    int upgradeFd_;     // 等待下一个进程连接的unix socket
+    int successorFd_;   // 接手的新进程，排空之后通知它
+    int predecessorFd_; // 被替换的旧进程，它退出之前会通知
+    std::atomic<bool> draining_; // 工作线程处理完请求时会读
+    int drainMS_;
+    int64_t drainDeadline_; // 排空的截止时间（Tracer::NowNs）
+    std::string srcDir_;
 
     uint32_t listenEvent_;
     uint32_t connEvent_;
+    int64_t wakeNs_; // 这一轮epoll_wait返回的时间，追踪和限速都用它
 
     std::unique_ptr<HeapTimer> timer_;
     std::unique_ptr<ThreadPool> threadpool_;
     std::unique_ptr<Epoller> epoller_;
-    std::unordered_map<int, HttpConn> users_;
     std::shared_ptr<KvStore> kv;
+    std::unique_ptr<ConnTable> users_;
+    std::unique_ptr<SqlBatchInserter> inserter_; // 注册用的合并写入器，析构时在连接池关闭之前停掉
+    IpLimiter ipLimiter_;
+    RateLimiter rateLimiter_;
+    HttpRequest::Admission admit_; // 调用Admit_，每个请求都用这一个，不用每次构造
+    // 其他线程（比如DB线程）投递给主循环执行的任务
+    MpscQueue<std::function<void()>> loopTasks_;
+    QueueNotifier loopNotifier_;
+    // 定时器只在主循环中访问，堆的大小由主循环每一轮写入
+    Gauge timerSize_;
+    CallbackGauge poolDepth_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include "Server/config.hpp"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+    string Trim(const string &s) {
+        size_t begin = s.find_first_not_of(" \t\r\n");
+        if (begin == string::npos) {
+            return "";
+        }
+        size_t end = s.find_last_not_of(" \t\r\n");
+        return s.substr(begin, end - begin + 1);
+    }
+
+    // 两边有双引号时去掉，用来保留值两端的空格
+    string Unquote(const string &s) {
+        if (s.size() >= 2 && s.front() == '"' && s.back() == '"') {
+            return s.substr(1, s.size() - 2);
+        }
+        return s;
+    }
+} // namespace
+
+bool Config::ParseArgs(int argc, char *argv[], string *err) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-c" && i + 1 < argc) {
+            path_ = argv[++i];
+        } else if (arg.compare(0, 9, "--config=") == 0) {
+            path_ = arg.substr(9);
+        } else if (arg.compare(0, 2, "--") == 0 && arg.find('=') != string::npos) {
+            size_t eq = arg.find('=');
+            overrides_.emplace_back(arg.substr(2, eq - 2), arg.substr(eq + 1));
+        } else {
+            *err = "unknown argument: " + arg + " (usage: [-c file] [--section.key=value ...])";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Config::Load(string *err) {
+    values_.clear();
+    if (!path_.empty()) {
+        ifstream in(path_);
+        if (!in) {
+            *err = "cannot open config file " + path_;
+            return false;
+        }
+        stringstream ss;
+        ss << in.rdbuf();
+        if (!LoadString(ss.str(), path_, err)) {
+            return false;
+        }
+    }
+    for (auto &item : overrides_) {
+        values_[item.first] = {item.second};
+    }
+    return true;
+}
+
+bool Config::LoadString(const string &text, const string &name, string *err) {
+    values_.clear();
+    istringstream in(text);
+    string line, section;
+    for (int lineNo = 1; getline(in, line); lineNo++) {
+        // 引号外面的#和;之后是注释
+        bool quoted = false;
+        for (size_t i = 0; i < line.size(); i++) {
+            if (line[i] == '"') {
+                quoted = !quoted;
+            } else if (!quoted && (line[i] == '#' || line[i] == ';')) {
+                line.resize(i);
+                break;
+            }
+        }
+        line = Trim(line);
+        if (line.empty()) {
+            continue;
+        }
+        if (line.front() == '[' && line.back() == ']') {
+            section = Trim(line.substr(1, line.size() - 2));
+            continue;
+        }
+        size_t eq = line.find('=');
+        if (eq == string::npos || Trim(line.substr(0, eq)).empty()) {
+            *err = name + ":" + to_string(lineNo) + ": expected key = value";
+            return false;
+        }
+        string key = Trim(line.substr(0, eq));
+        values_[section.empty() ? key : section + "." + key].push_back(Trim(line.substr(eq + 1)));
+    }
+    return true;
+}
+
+void Config::Set(const string &key, const string &value) {
+    overrides_.emplace_back(key, value);
+    values_[key] = {value};
+}
+
+vector<string> Config::GetAll(const string &key) const {
+    auto it = values_.find(key);
+    return it == values_.end() ? vector<string>() : it->second;
+}
+
+bool Config::Get(const string &key, string *value) const {
+    auto it = values_.find(key);
+    if (it != values_.end()) {
+        *value = Unquote(it->second.back());
+    }
+    return true;
+}
+
+bool Config::Get(const string &key, int *value) const {
+    auto it = values_.find(key);
+    if (it == values_.end()) {
+        return true;
+    }
+    const char *s = it->second.back().c_str();
+    char *end = nullptr;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || errno != 0 || v < INT32_MIN || v > INT32_MAX) {
+        return false;
+    }
+    *value = static_cast<int>(v);
+    return true;
+}
+
+bool Config::Get(const string &key, double *value) const {
+    auto it = values_.find(key);
+    if (it == values_.end()) {
+        return true;
+    }
+    const char *s = it->second.back().c_str();
+    char *end = nullptr;
+    double v = strtod(s, &end);
+    if (end == s || *end != '\0') {
+        return false;
+    }
+    *value = v;
+    return true;
+}
+
+bool Config::Get(const string &key, bool *value) const {
+    auto it = values_.find(key);
+    if (it == values_.end()) {
+        return true;
+    }
+    const string &s = it->second.back();
+    if (s == "1" || strcasecmp(s.c_str(), "true") == 0 || strcasecmp(s.c_str(), "on") == 0 ||
+        strcasecmp(s.c_str(), "yes") == 0) {
+        *value = true;
+    } else if (s == "0" || strcasecmp(s.c_str(), "false") == 0 ||
+               strcasecmp(s.c_str(), "off") == 0 || strcasecmp(s.c_str(), "no") == 0) {
+        *value = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+namespace {
+    // 按key读出一个参数，并检查范围
+    class Reader {
+    public:
+        Reader(const Config &config, string *err) : config_(config), err_(err), ok_(true) {}
+
+        template <class T>
+        void Get(const string &key, T *value) {
+            if (ok_ && !config_.Get(key, value)) {
+                Fail(key, "bad value");
+            }
+        }
+
+        template <class T>
+        void Get(const string &key, T *value, T min, T max) {
+            Get(key, value);
+            if (ok_ && (*value < min || *value > max)) {
+                Fail(key, "out of range");
+            }
+        }
+
+        void Fail(const string &key, const string &why) {
+            if (ok_) {
+                *err_ = key + ": " + why;
+                ok_ = false;
+            }
+        }
+
+        bool Ok() const { return ok_; }
+
+    private:
+        const Config &config_;
+        string *err_;
+        bool ok_;
+    };
+
+    // rule = 速率 突发 请求行前缀，前缀两端有空格时用双引号括起来
+    bool ParseRule(const string &text, RateRule *rule) {
+        const char *s = text.c_str();
+        char *end = nullptr;
+        rule->rate = strtod(s, &end);
+        if (end == s) {
+            return false;
+        }
+        s = end;
+        rule->burst = strtod(s, &end);
+        if (end == s) {
+            return false;
+        }
+        rule->prefix = Unquote(Trim(end));
+        return !rule->prefix.empty() && rule->rate >= 0 && rule->burst >= 0;
+    }
+} // namespace
+
+bool ServerOptions::FromConfig(const Config &config, ServerOptions *options, string *err) {
+    ServerOptions o;
+    Reader r(config, err);
+    r.Get("server.port", &o.port, 1024, 65535);
+    r.Get("server.trig_mode", &o.trigMode, 0, 3);
+    r.Get("server.linger", &o.optLinger);
+    r.Get("server.resources", &o.srcDir);
+    r.Get("server.upgrade_socket", &o.upgradePath);
+    r.Get("server.threads", &o.threadNum, 1, 1024);
+    r.Get("server.timeout_ms", &o.timeoutMS, 0, INT32_MAX);
+    r.Get("server.drain_ms", &o.drainMS, 0, INT32_MAX);
+    r.Get("mysql.host", &o.sqlHost);
+    r.Get("mysql.port", &o.sqlPort, 1, 65535);
+    r.Get("mysql.user", &o.sqlUser);
+    r.Get("mysql.password", &o.sqlPwd);
+    r.Get("mysql.database", &o.dbName);
+    r.Get("mysql.pool", &o.connPoolNum, 1, 1024);
+    r.Get("log.enable", &o.openLog);
+    r.Get("log.level", &o.logLevel, 0, 3);
+    r.Get("log.queue_size", &o.logQueSize, 1, INT32_MAX);
+    // 0表示不开HTTPS，和server.port一样不能用1024以下的端口
+    r.Get("tls.port", &o.tlsPort, 0, 65535);
+    if (o.tlsPort > 0 && o.tlsPort < 1024) {
+        r.Fail("tls.port", "out of range");
+    }
+    r.Get("tls.cert", &o.tlsCert);
+    r.Get("tls.key", &o.tlsKey);
+    r.Get("tls.ktls", &o.tlsKtls);
+    r.Get("tls.session_cache", &o.tlsSessionCache, 0, INT32_MAX);
+    r.Get("tls.session_timeout_sec", &o.tlsSessionTimeoutSec, 1, INT32_MAX);
+    if (o.tlsPort > 0 && (o.tlsCert.empty() || o.tlsKey.empty())) {
+        r.Fail("tls.cert", "cert and key are required when port is set");
+    }
+    r.Get("cache.auth_size", &o.authCacheSize, 1, INT32_MAX);
+    r.Get("cache.auth_ttl_sec", &o.authCacheTtlSec, 0, INT32_MAX);
+    r.Get("cache.auth_negative_ttl_sec", &o.authCacheNegativeTtlSec, 0, INT32_MAX);
+    r.Get("cache.trace_ring_size", &o.traceRingSize, 1, INT32_MAX);
+    r.Get("limits.max_conn_per_ip", &o.maxConnPerIp, 0, INT32_MAX);
+    r.Get("limits.queue_target_ms", &o.queueTargetMS, 0, INT32_MAX);
+    r.Get("limits.queue_interval_ms", &o.queueIntervalMS, 1, INT32_MAX);
+    r.Get("limits.rate", &o.rate, 0.0, 1e9);
+    r.Get("limits.burst", &o.burst, 0.0, 1e9);
+    for (const string &text : config.GetAll("limits.rule")) {
+        RateRule rule;
+        if (!ParseRule(text, &rule)) {
+            r.Fail("limits.rule", "expected: rate burst prefix");
+            break;
+        }
+        o.rateRules.push_back(rule);
+    }
+    if (!r.Ok()) {
+        return false;
+    }
+    *options = o;
+    return true;
+}
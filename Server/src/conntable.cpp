@@ -0,0 +1,82 @@
+#include "Server/conntable.hpp"
+
+ConnTable::ConnTable(int maxFd, std::shared_ptr<KvStore> kv)
+    : maxFd_(maxFd), slots_(new Slot[maxFd]), kv_(std::move(kv)) {
+    assert(maxFd > 0);
+}
+
+// 在主循环中调用，取出（或者第一次创建）fd对应的连接，并返回新的代数
+HttpConn *ConnTable::Open(int fd, const sockaddr_in &addr, uint32_t *gen) {
+    assert(fd >= 0 && fd < maxFd_);
+    Slot &slot = slots_[fd];
+    if (!slot.conn) {
+        slot.conn.reset(new HttpConn(kv_));
+    }
+    *gen = slot.gen.fetch_add(1, std::memory_order_acq_rel) + 1;
+    slot.dispatched = false;
+    slot.closePending = false;
+    slot.conn->init(fd, addr);
+    return slot.conn.get();
+}
+
+// 拿到fd当前对应的连接
+HttpConn *ConnTable::Get(int fd) const {
+    if (fd < 0 || fd >= maxFd_) {
+        return nullptr;
+    }
+    return slots_[fd].conn.get();
+}
+
+// 只有代数一致时才返回连接，否则说明是过期的定时器或者任务
+HttpConn *ConnTable::Get(int fd, uint32_t gen) const {
+    if (fd < 0 || fd >= maxFd_) {
+        return nullptr;
+    }
+    const Slot &slot = slots_[fd];
+    if (slot.gen.load(std::memory_order_acquire) != gen) {
+        return nullptr;
+    }
+    return slot.conn.get();
+}
+
+uint32_t ConnTable::Generation(int fd) const {
+    assert(fd >= 0 && fd < maxFd_);
+    return slots_[fd].gen.load(std::memory_order_acquire);
+}
+
+// 关闭连接前调用，只有一个调用者能成功（过期的定时器和任务可能关闭同一个连接）
+// 必须在close(fd)之前调用，保证fd被复用之前代数已经变了
+bool ConnTable::Retire(int fd, uint32_t gen) {
+    if (fd < 0 || fd >= maxFd_) {
+        return false;
+    }
+    return slots_[fd].gen.compare_exchange_strong(gen, gen + 1, std::memory_order_acq_rel);
+}
+
+// 以下都只在主循环中调用
+// 把连接交给工作线程之前调用
+void ConnTable::Dispatch(int fd) {
+    assert(fd >= 0 && fd < maxFd_);
+    slots_[fd].dispatched = true;
+}
+
+bool ConnTable::Dispatched(int fd) const {
+    assert(fd >= 0 && fd < maxFd_);
+    return slots_[fd].dispatched;
+}
+
+// 连接在工作线程手上时要关闭它，等交还时再关
+void ConnTable::DeferClose(int fd) {
+    assert(fd >= 0 && fd < maxFd_);
+    slots_[fd].closePending = true;
+}
+
+// 工作线程交还连接，返回这期间是否有人要关闭它
+bool ConnTable::HandBack(int fd) {
+    assert(fd >= 0 && fd < maxFd_);
+    Slot &slot = slots_[fd];
+    bool closePending = slot.closePending;
+    slot.dispatched = false;
+    slot.closePending = false;
+    return closePending;
+}
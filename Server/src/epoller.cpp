@@ -1,46 +1,97 @@
 #include "Server/epoller.hpp"
 
-// 构造函数
-Epoller::Epoller(int maxEvent) : epollFd_(epoll_create(512)), events_(maxEvent) {
+// 构造函数，notifier_的eventfd用于工作线程唤醒主循环
+// 每个fd同一时刻最多只有一个待处理的修改（EPOLLONESHOT），pending_按maxFd分配
+Epoller::Epoller(int maxEvent, int maxFd)
+    : epollFd_(epoll_create(512)), events_(maxEvent), masks_(maxFd, 0), armed_(maxFd, 0),
+      pending_(maxFd) {
     assert(epollFd_ >= 0 && events_.size() > 0);
+    AddFd(notifier_.Fd(), EPOLLIN);
+    notifier_.Arm();
 }
 
 // 析构函数
-Epoller::~Epoller() {
-    close(epollFd_);
+Epoller::~Epoller() { close(epollFd_); }
+
+// 真正调用epoll_ctl的地方，同时更新记录的事件
+bool Epoller::Ctl_(int op, int fd, uint32_t events) {
+    epoll_event ev = {0};
+    ev.data.fd = fd;
+    ev.events = events;
+    if (epoll_ctl(epollFd_, op, fd, &ev) != 0) {
+        return false;
+    }
+    if (static_cast<size_t>(fd) < masks_.size()) {
+        masks_[fd] = events;
+        armed_[fd] = 1;
+    }
+    return true;
 }
 
 // 添加事件
 bool Epoller::AddFd(int fd, uint32_t events) {
     if (fd < 0)
         return false;
-    epoll_event ev = {0};
-    ev.data.fd = fd;
-    ev.events = events;
-    return 0 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+    return Ctl_(EPOLL_CTL_ADD, fd, events);
 }
 
-// 修改事件
+// 修改事件，如果事件没变并且fd还处于激活状态，就不需要再调用epoll_ctl
 bool Epoller::ModFd(int fd, uint32_t events) {
     if (fd < 0)
         return false;
-    epoll_event ev = {0};
-    ev.data.fd = fd;
-    ev.events = events;
-    return 0 == epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+    if (static_cast<size_t>(fd) < masks_.size() && armed_[fd] && masks_[fd] == events) {
+        return true;
+    }
+    return Ctl_(EPOLL_CTL_MOD, fd, events);
 }
 
-// 删除事件
+// 删除事件，工作线程要关闭连接时交给主循环来删
 bool Epoller::DelFd(int fd) {
     if (fd < 0)
         return false;
+    if (static_cast<size_t>(fd) < masks_.size()) {
+        masks_[fd] = 0;
+        armed_[fd] = 0;
+    }
     epoll_event ev = {0};
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, &ev);
 }
 
-// epoll_wait
+// 工作线程提交修改，主循环Arm之后第一个提交的线程负责写eventfd，多次修改合并为一次唤醒
+void Epoller::PostModFd(int fd, uint32_t events, uint32_t gen) {
+    if (fd < 0)
+        return;
+    while (!pending_.TryPush(PendingMod{fd, events, gen})) {
+        // 正常情况下不会满，满了就让主循环先处理
+        notifier_.Wake();
+        std::this_thread::yield();
+    }
+    notifier_.Notify();
+}
+
+// 主循环批量处理工作线程提交的修改，先Arm再取，Arm之后提交的修改一定会再次唤醒主循环
+void Epoller::ApplyPending(const std::function<bool(int, uint32_t)> &accept) {
+    notifier_.Drain();
+    notifier_.Arm();
+    pending_.PopBatch(
+        [this, &accept](PendingMod &mod) {
+            if (!accept || accept(mod.fd, mod.gen)) {
+                ModFd(mod.fd, mod.events);
+            }
+        },
+        pending_.Capacity());
+}
+
+// epoll_wait，EPOLLONESHOT的fd触发之后就不再处于激活状态
 int Epoller::Wait(int timeoutMs) {
-    return epoll_wait(epollFd_, &events_[0], static_cast<int>(events_.size()), timeoutMs);
+    int n = epoll_wait(epollFd_, &events_[0], static_cast<int>(events_.size()), timeoutMs);
+    for (int i = 0; i < n; i++) {
+        int fd = events_[i].data.fd;
+        if (static_cast<size_t>(fd) < masks_.size() && (masks_[fd] & EPOLLONESHOT)) {
+            armed_[fd] = 0;
+        }
+    }
+    return n;
 }
 
 // 拿到监听的第i个事件的fd
@@ -52,4 +103,4 @@ int Epoller::GetEventFd(size_t i) const {
 uint32_t Epoller::GetEvents(size_t i) const {
     assert(i < events_.size() && i >= 0);
     return events_[i].events;
-}
\ No newline at end of file
+}
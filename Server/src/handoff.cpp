@@ -0,0 +1,124 @@
+#include "Server/handoff.hpp"
+#include <poll.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+    bool MakeAddr(const string &path, sockaddr_un *addr) {
+        if (path.empty() || path.size() >= sizeof(addr->sun_path)) {
+            return false;
+        }
+        memset(addr, 0, sizeof(*addr));
+        addr->sun_family = AF_UNIX;
+        memcpy(addr->sun_path, path.c_str(), path.size());
+        return true;
+    }
+} // namespace
+
+int handoff::Listen(const string &path) {
+    sockaddr_un addr;
+    if (!MakeAddr(path, &addr)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path.c_str());
+    // 在listen之前改好权限，之间没有别人能连上来
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0 || chmod(path.c_str(), 0600) < 0 ||
+        listen(fd, 1) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int handoff::Connect(const string &path) {
+    sockaddr_un addr;
+    if (!MakeAddr(path, &addr)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    // 文件不存在或者是上一个进程崩溃之后留下的（ECONNREFUSED），都说明没有旧进程
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0 || !SameUser(fd)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool handoff::SameUser(int sock) {
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+        return false;
+    }
+    return cred.uid == geteuid();
+}
+
+bool handoff::SendFds(int sock, const int *fds, int count) {
+    if (count <= 0 || count > MAX_FDS) {
+        return false;
+    }
+    char data = 'L';
+    iovec iov = {&data, 1};
+    char control[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+    memset(control, 0, sizeof(control));
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+int handoff::RecvFds(int sock, int *fds, int maxCount, int timeoutMS) {
+    pollfd pfd = {sock, POLLIN, 0};
+    if (poll(&pfd, 1, timeoutMS) != 1) {
+        return -1;
+    }
+    char data;
+    iovec iov = {&data, 1};
+    char control[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != 1) {
+        return -1;
+    }
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+    int count = static_cast<int>((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+    int received[MAX_FDS];
+    memcpy(received, CMSG_DATA(cmsg), sizeof(int) * count);
+    // 多出来的用不上，关掉
+    for (int i = 0; i < count; i++) {
+        if (i < maxCount) {
+            fds[i] = received[i];
+        } else {
+            close(received[i]);
+        }
+    }
+    return count < maxCount ? count : maxCount;
+}
@@ -0,0 +1,28 @@
+#include "Server/iplimiter.hpp"
+#include <assert.h>
+
+IpLimiter::IpLimiter(int limit, size_t slots) : limit_(limit), mask_(slots - 1) {
+    // 槽位数必须是2的幂
+    assert(slots > 0 && (slots & (slots - 1)) == 0);
+    counts_.reset(new std::atomic<int32_t>[slots]);
+    for (size_t i = 0; i < slots; i++) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+// 乘法哈希取高位，同一个网段的地址也能分散开
+size_t IpLimiter::Slot_(uint32_t ip) const {
+    return static_cast<size_t>((ip * 0x9E3779B97F4A7C15ull) >> 32) & mask_;
+}
+
+bool IpLimiter::TryAcquire(uint32_t ip) {
+    int limit = limit_.load(std::memory_order_relaxed);
+    std::atomic<int32_t> &count = counts_[Slot_(ip)];
+    if (count.fetch_add(1, std::memory_order_relaxed) >= limit && limit > 0) {
+        count.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void IpLimiter::Release(uint32_t ip) { counts_[Slot_(ip)].fetch_sub(1, std::memory_order_relaxed); }
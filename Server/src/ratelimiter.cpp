@@ -0,0 +1,125 @@
+#include "Server/ratelimiter.hpp"
+#include <string.h>
+#include <algorithm>
+
+using namespace std;
+
+RateLimiter::RateLimiter(size_t capacity) : shards_(new Shard[SHARDS]), evictions_(0) {
+    setsPerShard_ = max<size_t>((capacity + SHARDS * WAYS - 1) / (SHARDS * WAYS), 1);
+    for (size_t i = 0; i < SHARDS; i++) {
+        shards_[i].buckets.reset(new Bucket[setsPerShard_ * WAYS]());
+    }
+    versions_.emplace_back(new RuleSet());
+    rules_.store(versions_.back().get(), memory_order_release);
+}
+
+void RateLimiter::SetIpRate(double rate, double burst) {
+    lock_guard<mutex> locker(updateMtx_);
+    unique_ptr<RuleSet> next = Copy_();
+    next->rules[IP_RULE].rate = rate / 1e9;
+    next->rules[IP_RULE].burst = max(burst, 1.0);
+    Publish_(std::move(next));
+}
+
+int RateLimiter::AddRule(const string &prefix, double rate, double burst) {
+    lock_guard<mutex> locker(updateMtx_);
+    unique_ptr<RuleSet> next = Copy_();
+    int rule = 1;
+    while (rule < next->count && next->rules[rule].prefix != prefix) {
+        rule++;
+    }
+    if (rule == MAX_RULES) {
+        return -1;
+    }
+    next->rules[rule] = {prefix, rate / 1e9, max(burst, 1.0)};
+    next->count = max(next->count, rule + 1);
+    Publish_(std::move(next));
+    return rule;
+}
+
+void RateLimiter::ClearRules() {
+    lock_guard<mutex> locker(updateMtx_);
+    unique_ptr<RuleSet> next = Copy_();
+    next->count = 1;
+    Publish_(std::move(next));
+}
+
+unique_ptr<RateLimiter::RuleSet> RateLimiter::Copy_() const {
+    return unique_ptr<RuleSet>(new RuleSet(*rules_.load(memory_order_relaxed)));
+}
+
+void RateLimiter::Publish_(unique_ptr<RuleSet> next) {
+    next->hasRequestRules = false;
+    for (int i = 1; i < next->count; i++) {
+        next->hasRequestRules = next->hasRequestRules || next->rules[i].rate > 0;
+    }
+    next->enabled = next->hasRequestRules || next->rules[IP_RULE].rate > 0;
+    rules_.store(next.get(), memory_order_release);
+    versions_.push_back(std::move(next));
+}
+
+int RateLimiter::Match(const char *line, size_t len) const {
+    const RuleSet &set = *rules_.load(memory_order_acquire);
+    int best = -1;
+    size_t bestLen = 0;
+    for (int i = 1; i < set.count; i++) {
+        const string &prefix = set.rules[i].prefix;
+        if (prefix.size() <= len && prefix.size() >= bestLen &&
+            memcmp(line, prefix.data(), prefix.size()) == 0) {
+            best = i;
+            bestLen = prefix.size();
+        }
+    }
+    return best;
+}
+
+bool RateLimiter::Allow(uint32_t ip, int rule, int64_t nowNs) { return Take_(ip, rule, nowNs, true); }
+
+bool RateLimiter::Check(uint32_t ip, int rule, int64_t nowNs) { return Take_(ip, rule, nowNs, false); }
+
+bool RateLimiter::Take_(uint32_t ip, int rule, int64_t nowNs, bool take) {
+    // rule可能是替换之前的规则表给出的编号，编号总在MAX_RULES之内，最多用错一次规则
+    const Rule &r = rules_.load(memory_order_acquire)->rules[rule];
+    if (r.rate <= 0) {
+        return true;
+    }
+    // 规则编号放在低位，key不会是0
+    uint64_t key = (static_cast<uint64_t>(ip) << 8) | static_cast<uint64_t>(rule + 1);
+    uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+    Shard &shard = shards_[hash >> 60];
+    Bucket *set = &shard.buckets[((hash >> 20) % setsPerShard_) * WAYS];
+
+    lock_guard<mutex> locker(shard.mtx);
+    Bucket *victim = set;
+    for (size_t i = 0; i < WAYS; i++) {
+        Bucket &bucket = set[i];
+        if (bucket.key == key) {
+            // 按距离上次访问的时间补充令牌，几个线程的时间可能有先后，时间倒退时不补充
+            int64_t elapsed = max<int64_t>(nowNs - bucket.lastNs, 0);
+            double tokens = bucket.tokens + static_cast<double>(elapsed) * r.rate;
+            bucket.tokens = min(tokens, r.burst);
+            bucket.lastNs = max(bucket.lastNs, nowNs);
+            if (bucket.tokens < 1) {
+                return false;
+            }
+            if (take) {
+                bucket.tokens -= 1;
+            }
+            return true;
+        }
+        if (bucket.key == 0 || (victim->key != 0 && bucket.lastNs < victim->lastNs)) {
+            victim = &bucket;
+        }
+    }
+    // 第一次出现（或者已经被替换掉）的IP从满桶开始
+    if (!take) {
+        return true;
+    }
+    if (victim->key != 0) {
+        evictions_.fetch_add(1, memory_order_relaxed);
+    }
+    victim->key = key;
+    victim->lastNs = nowNs;
+    victim->tokens = r.burst - 1;
+    return true;
+}
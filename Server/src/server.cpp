@@ -1,50 +1,259 @@
 #include "Server/server.hpp"
+#include "Http/httprouter.hpp"
 #include <libgen.h>
+#include <signal.h>
 
 using namespace std;
 
+static Counter accepts("server_accepts_total", "Accepted client connections");
+static Counter rejects("server_rejects_total", "Connections refused because the server was full");
+static Counter shedQueue("server_shed_total", "Requests or connections refused by overload protection",
+                         "reason=\"queue\"");
+static Counter shedIp("server_shed_total", "Requests or connections refused by overload protection",
+                      "reason=\"ip_limit\"");
+static Counter shedRate("server_shed_total", "Requests or connections refused by overload protection",
+                        "reason=\"rate_limit\"");
+
+// 过载时直接回复的内容，不经过HttpConn和线程池
+static const char SERVICE_UNAVAILABLE[] = "HTTP/1.1 503 Service Unavailable\r\n"
+                                          "Retry-After: 1\r\n"
+                                          "Connection: close\r\n"
+                                          "Content-Length: 0\r\n\r\n";
+static const char TOO_MANY_REQUESTS[] = "HTTP/1.1 429 Too Many Requests\r\n"
+                                        "Retry-After: 1\r\n"
+                                        "Connection: close\r\n"
+                                        "Content-Length: 0\r\n\r\n";
+
+// 信号处理函数中只设置标志并唤醒主循环，由主循环处理
+// SIGUSR1：把追踪数据导出到文件，SIGHUP：重新加载配置
+static std::atomic<bool> traceDumpRequested(false);
+static std::atomic<bool> reloadRequested(false);
+static std::atomic<int> signalWakeFd(-1);
+
+static void WakeLoop() {
+    int fd = signalWakeFd.load();
+    if (fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ret = write(fd, &one, sizeof(one));
+        (void)ret;
+    }
+}
+
+static void OnTraceSignal(int) {
+    traceDumpRequested.store(true);
+    WakeLoop();
+}
+
+static void OnReloadSignal(int) {
+    reloadRequested.store(true);
+    WakeLoop();
+}
+
+// 监听socket实际绑定的端口，失败返回-1
+static int LocalPort(int fd) {
+    sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(fd, (sockaddr *)&addr, &len) < 0 || addr.sin_family != AF_INET) {
+        return -1;
+    }
+    return ntohs(addr.sin_port);
+}
+
+static ServerOptions MakeOptions(int port, int trigMode, int timeoutMS, bool OptLinger, int sqlPort,
+                                 const char *sqlUser, const char *sqlPwd, const char *dbName,
+                                 int connPoolNum, int threadNum, bool openLog, int logLevel,
+                                 int logQueSize, const char *upgradePath, int drainMS) {
+    ServerOptions options;
+    options.port = port;
+    options.trigMode = trigMode;
+    options.timeoutMS = timeoutMS;
+    options.optLinger = OptLinger;
+    options.sqlPort = sqlPort;
+    options.sqlUser = sqlUser;
+    options.sqlPwd = sqlPwd;
+    options.dbName = dbName;
+    options.connPoolNum = connPoolNum;
+    options.threadNum = threadNum;
+    options.openLog = openLog;
+    options.logLevel = logLevel;
+    options.logQueSize = logQueSize;
+    options.upgradePath = upgradePath ? upgradePath : "";
+    options.drainMS = drainMS;
+    return options;
+}
+
 WebServer::WebServer(int port, int trigMode, int timeoutMS, bool OptLinger, int sqlPort,
                      const char *sqlUser, const char *sqlPwd, const char *dbName, int connPoolNum,
-                     int threadNum, bool openLog, int logLevel, int logQueSize)
-    : port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS), isClose_(false),
-      timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller()) {
-    srcDir_ = getcwd(nullptr, 256);
-    assert(srcDir_);
-    // 获取上一级目录，当前目录是build目录
-    srcDir_ = dirname(srcDir_);
-    printf("%s\n", srcDir_);
-    strncat(srcDir_, "/resources/", 16);
+                     int threadNum, bool openLog, int logLevel, int logQueSize,
+                     const char *upgradePath, int drainMS)
+    : WebServer(MakeOptions(port, trigMode, timeoutMS, OptLinger, sqlPort, sqlUser, sqlPwd, dbName,
+                            connPoolNum, threadNum, openLog, logLevel, logQueSize, upgradePath,
+                            drainMS)) {}
+
+WebServer::WebServer(const ServerOptions &options)
+    : options_(options), port_(options.port), openLinger_(options.optLinger),
+      timeoutMS_(options.timeoutMS), isClose_(false), listenFd_(-1), tlsPort_(options.tlsPort),
+      tlsListenFd_(-1),
+      upgradePath_(options.upgradePath), upgradeFd_(-1), successorFd_(-1), predecessorFd_(-1),
+      draining_(false), drainMS_(options.drainMS), drainDeadline_(0), wakeNs_(0),
+      timer_(new HeapTimer()), threadpool_(new ThreadPool(options.threadNum)),
+      epoller_(new Epoller()),
+      admit_([this](const HttpRequest &request) { return Admit_(request); }),
+      loopTasks_(MAX_LOOP_TASKS),
+      timerSize_("timer_heap_size", "Pending timers in the main loop"),
+      poolDepth_("threadpool_queue_depth", "Tasks waiting for a worker thread",
+                 [this] { return static_cast<double>(threadpool_->QueueSize()); }) {
+    if (options.srcDir.empty()) {
+        // 获取上一级目录，当前目录是build目录
+        char *cwd = getcwd(nullptr, 0);
+        assert(cwd);
+        srcDir_ = string(dirname(cwd)) + "/resources/";
+        free(cwd);
+    } else {
+        srcDir_ = options.srcDir;
+        if (srcDir_.back() != '/') {
+            srcDir_ += '/';
+        }
+    }
     HttpConn::userCount = 0;
-    HttpConn::srcDir = srcDir_;
-    SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
+    HttpConn::srcDir = srcDir_.c_str();
+    // 客户端提前关闭连接时write会触发SIGPIPE，默认行为是结束进程，忽略它，由write返回EPIPE
+    signal(SIGPIPE, SIG_IGN);
+    SqlConnPool::Instance()->Init(options.sqlHost.c_str(), options.sqlPort, options.sqlUser.c_str(),
+                                  options.sqlPwd.c_str(), options.dbName.c_str(),
+                                  options.connPoolNum);
+    // 数据库操作在单独的线程池中执行，每个线程对应一个连接
+    SqlExecutor::Instance()->Init(options.connPoolNum);
+    inserter_ = UserAuth::NewInserter();
+    UserAuth::SetInserter(inserter_.get());
+    // 初始化跳表kv存储，以及以fd为下标的连接表
+    kv = std::make_shared<KvStore>();
+    users_.reset(new ConnTable(MAX_FD, kv));
+    RegisterAdmin_();
     // 初始化epoll相关
-    InitEventMode_(trigMode);
-    if (!InitSocket_()) {
-        isClose_ = true;
+    InitEventMode_(options.trigMode);
+    epoller_->AddFd(loopNotifier_.Fd(), EPOLLIN);
+    loopNotifier_.Arm();
+    signalWakeFd.store(loopNotifier_.Fd());
+    signal(SIGUSR1, OnTraceSignal);
+    signal(SIGHUP, OnReloadSignal);
+    // 证书有问题时直接退出，不能去接手旧进程（旧进程会开始排空）
+    if (tlsPort_ > 0) {
+        string err;
+        if (!TlsContext::Instance()->Init(options.tlsCert, options.tlsKey, options.tlsKtls,
+                                          options.tlsSessionCache, options.tlsSessionTimeoutSec,
+                                          &err)) {
+            LOG_ERROR("TLS init error: %s", err.c_str());
+            isClose_ = true;
+        }
     }
-    // 初始化跳表kv存储
-    kv = std::make_shared<KvStore>();
+    // 有旧进程时kv等它退出之后再加载，否则加载上次保存的
+    // 接手之后旧进程已经在排空了，只是HTTPS端口没监听上时照常提供HTTP
+    if (!isClose_) {
+        bool inherited = InheritSocket_();
+        if (listenFd_ < 0 || (!inherited && tlsPort_ > 0 && tlsListenFd_ < 0)) {
+            isClose_ = true;
+        } else if (!inherited) {
+            kv->Load();
+        }
+    }
+    if (!isClose_ && !upgradePath_.empty()) {
+        upgradeFd_ = handoff::Listen(upgradePath_);
+        if (upgradeFd_ < 0 || !epoller_->AddFd(upgradeFd_, EPOLLIN)) {
+            LOG_ERROR("Listen upgrade socket %s error!", upgradePath_.c_str());
+        }
+    }
+    ApplyTunables_(options);
     // 日志设置
-    if (openLog) {
-        Log::Instance()->init(logLevel, "./log", ".log", logQueSize);
+    if (options.openLog) {
+        Log::Instance()->init(options.logLevel, "./log", ".log", options.logQueSize);
         if (isClose_) {
             LOG_ERROR("========== Server init error!==========");
         } else {
             LOG_INFO("========== Server init ==========");
-            LOG_INFO("Port:%d, OpenLinger: %s", port_, OptLinger ? "true" : "false");
+            LOG_INFO("Port:%d, TLS port:%d, OpenLinger: %s", port_, tlsPort_,
+                     options.optLinger ? "true" : "false");
             LOG_INFO("Listen Mode: %s, OpenConn Mode: %s", (listenEvent_ & EPOLLET ? "ET" : "LT"),
                      (connEvent_ & EPOLLET ? "ET" : "LT"));
-            LOG_INFO("LogSys level: %d", logLevel);
+            LOG_INFO("LogSys level: %d", options.logLevel);
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", options.connPoolNum,
+                     options.threadNum);
+        }
+    }
+}
+
+// 可以在运行时修改的参数，构造时和重新加载配置时调用（都在主循环所在的线程）
+void WebServer::ApplyTunables_(const ServerOptions &options) {
+    threadpool_->Resize(options.threadNum);
+    // 已有的连接只在打开超时时才有定时器，超时的开关只能在重启时修改
+    if ((timeoutMS_ > 0) == (options.timeoutMS > 0)) {
+        timeoutMS_ = options.timeoutMS;
+    } else {
+        LOG_WARN("Turning connection timeout on/off takes effect after restart");
+    }
+    drainMS_ = options.drainMS;
+    Log::Instance()->SetLevel(options.logLevel);
+    UserAuth::Cache().SetLimits(options.authCacheSize, chrono::seconds(options.authCacheTtlSec),
+                                chrono::seconds(options.authCacheNegativeTtlSec));
+    Tracer::Instance()->SetRingCapacity(options.traceRingSize);
+    ipLimiter_.SetLimit(options.maxConnPerIp);
+    threadpool_->SetQueueTarget(options.queueTargetMS, options.queueIntervalMS);
+    rateLimiter_.SetIpRate(options.rate, options.burst);
+    rateLimiter_.ClearRules();
+    for (const RateRule &rule : options.rateRules) {
+        if (!AddRateLimit(rule.prefix, rule.rate, rule.burst)) {
+            LOG_WARN("Too many rate limit rules, \"%s\" ignored", rule.prefix.c_str());
         }
     }
 }
 
+// SIGHUP：重新读配置文件（再应用命令行的覆盖），只更新运行时可以修改的参数
+// 配置有错时保持原来的参数不变
+void WebServer::Reload_() {
+    // 参数直接传给构造函数时没有config，重新加载只会得到默认值
+    if (!hasConfig_) {
+        LOG_WARN("No config to reload, SIGHUP ignored");
+        return;
+    }
+    string err;
+    ServerOptions options;
+    if (!config_.Load(&err) || !ServerOptions::FromConfig(config_, &options, &err)) {
+        LOG_ERROR("Reload config failed: %s", err.c_str());
+        return;
+    }
+    if (options.port != options_.port || options.trigMode != options_.trigMode ||
+        options.sqlHost != options_.sqlHost || options.sqlPort != options_.sqlPort ||
+        options.dbName != options_.dbName || options.connPoolNum != options_.connPoolNum ||
+        options.srcDir != options_.srcDir || options.upgradePath != options_.upgradePath ||
+        options.tlsPort != options_.tlsPort || options.tlsCert != options_.tlsCert ||
+        options.tlsKey != options_.tlsKey) {
+        LOG_WARN("Listen/MySQL/resources/TLS options changed, they take effect after restart");
+    }
+    ApplyTunables_(options);
+    // 已有连接的定时器还是按照原来的超时时间，下次有数据时按新的时间续期
+    options_ = options;
+    LOG_INFO("Config reloaded: threads %d, timeout %dms, log level %d, rate %.1f/%.1f, %d rules",
+             options.threadNum, options.timeoutMS, options.logLevel, options.rate, options.burst,
+             static_cast<int>(options.rateRules.size()));
+}
+
 WebServer::~WebServer() {
-    close(listenFd_);
+    signalWakeFd.store(-1);
+    if (listenFd_ >= 0) {
+        close(listenFd_);
+    }
+    if (tlsListenFd_ >= 0) {
+        close(tlsListenFd_);
+    }
+    if (upgradeFd_ >= 0) {
+        close(upgradeFd_);
+        unlink(upgradePath_.c_str());
+    }
     isClose_ = true;
-    free(srcDir_);
+    // 合并写入器析构时会提交剩下的行并等它们执行完，所以要在关闭连接池之前
+    UserAuth::SetInserter(nullptr);
+    inserter_.reset();
     SqlConnPool::Instance()->ClosePool();
 }
 /*
@@ -86,102 +295,462 @@ void WebServer::Start() {
         // 获取最近的一个定时器的时间
         if (timeoutMS_ > 0) {
             timeMS = timer_->GetNextTick();
+            timerSize_.Set(timer_->size());
+        }
+        // 排空期间要定期检查连接是否都关闭了
+        if (draining_ && (timeMS < 0 || timeMS > 100)) {
+            timeMS = 100;
         }
         // epoll_wait
         int eventCnt = epoller_->Wait(timeMS);
+        wakeNs_ = Tracer::NowNs();
         for (int i = 0; i < eventCnt; i++) {
             // 处理事件
             int fd = epoller_->GetEventFd(i);
             uint32_t events = epoller_->GetEvents(i);
             // 新的连接
-            if (fd == listenFd_) {
-                DealListen_();
+            if (fd == listenFd_ || fd == tlsListenFd_) {
+                DealListen_(fd);
+            }
+            // 工作线程提交的事件修改，批量处理；重新监听就是把连接交还给主循环，这期间要关闭的连接现在关闭
+            else if (fd == epoller_->GetWakeFd()) {
+                epoller_->ApplyPending([this](int connFd, uint32_t gen) {
+                    HttpConn *conn = users_->Get(connFd, gen);
+                    if (!conn) {
+                        return false;
+                    }
+                    if (users_->HandBack(connFd)) {
+                        CloseConn_(conn, gen);
+                        return false;
+                    }
+                    return true;
+                });
+            }
+            // 其他线程投递过来的任务
+            else if (fd == loopNotifier_.Fd()) {
+                RunLoopTasks_();
+            }
+            // 新进程来接手
+            else if (fd == upgradeFd_) {
+                DealUpgrade_();
+            }
+            // 旧进程已经退出
+            else if (fd == predecessorFd_) {
+                DealPredecessor_();
             }
             // 关闭连接
             else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                assert(users_.count(fd) > 0);
-                CloseConn_(&users_[fd]);
+                assert(users_->Get(fd));
+                CloseConn_(users_->Get(fd), users_->Generation(fd));
             }
             // 可读
             else if (events & EPOLLIN) {
-                assert(users_.count(fd) > 0);
-                DealRead_(&users_[fd]);
+                assert(users_->Get(fd));
+                DealRead_(users_->Get(fd));
             }
             // 可写
             else if (events & EPOLLOUT) {
-                assert(users_.count(fd) > 0);
-                DealWrite_(&users_[fd]);
+                assert(users_->Get(fd));
+                DealWrite_(users_->Get(fd));
             } else {
                 LOG_ERROR("Unexpected event");
             }
         }
+        if (draining_) {
+            CheckDrain_();
+        }
+    }
+}
+
+// 打开HTTP和HTTPS的监听socket，接手了旧进程的返回true，没有旧进程（或者没有配置升级路径）返回false
+// 一连上旧进程它就会交出监听socket并开始排空，之后再失败就没有进程在监听了，所以连接之前先自己监听：
+// 端口和旧进程的相同时绑定会失败，用它传过来的；端口换了（或者旧进程没有HTTPS）时用自己的
+bool WebServer::InheritSocket_() {
+    listenFd_ = InitSocket_(port_, true);
+    tlsListenFd_ = tlsPort_ > 0 ? InitSocket_(tlsPort_, true) : -1;
+    int sock = upgradePath_.empty() ? -1 : handoff::Connect(upgradePath_);
+    int fds[2] = {-1, -1};
+    int count = sock >= 0 ? handoff::RecvFds(sock, fds, 2, 5000) : -1;
+    if (count < 1 || !epoller_->AddFd(sock, EPOLLIN)) {
+        if (sock >= 0) {
+            LOG_ERROR("Inherit listen socket from %s error!", upgradePath_.c_str());
+            close(sock);
+        }
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        if (listenFd_ < 0) {
+            LOG_ERROR("Bind Port:%d error!", port_);
+        }
+        if (tlsPort_ > 0 && tlsListenFd_ < 0) {
+            LOG_ERROR("Bind Port:%d error!", tlsPort_);
+        }
+        return false;
+    }
+    listenFd_ = PickListen_(fds[0], listenFd_, port_);
+    tlsListenFd_ = PickListen_(fds[1], tlsListenFd_, tlsPort_);
+    predecessorFd_ = sock;
+    if (tlsPort_ > 0 && tlsListenFd_ < 0) {
+        LOG_ERROR("Listen TLS port:%d error, HTTPS disabled!", tlsPort_);
+    }
+    LOG_INFO("Inherit listen socket from %s", upgradePath_.c_str());
+    return true;
+}
+
+// 旧进程传过来的socket绑定的端口对得上就用它，否则关掉它，用自己监听的fresh
+// 端口相同时fresh一定没有绑定成功（端口被旧进程占着），port为0表示不需要这个监听socket
+int WebServer::PickListen_(int inherited, int fresh, int port) {
+    if (inherited >= 0 && port > 0 && LocalPort(inherited) == port &&
+        epoller_->AddFd(inherited, listenEvent_ | EPOLLIN)) {
+        SetFdNonblock(inherited);
+        CloseListen_(fresh);
+        return inherited;
+    }
+    if (inherited >= 0) {
+        close(inherited);
+    }
+    return fresh;
+}
+
+void WebServer::CloseListen_(int fd) {
+    if (fd >= 0) {
+        epoller_->DelFd(fd);
+        close(fd);
+    }
+}
+
+// 新进程连上来了：把监听socket交给它，自己不再accept，开始排空已有的连接
+void WebServer::DealUpgrade_() {
+    int sock = accept4(upgradeFd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (sock < 0) {
+        return;
+    }
+    // 只把监听socket交给同一个用户的进程
+    if (!handoff::SameUser(sock)) {
+        LOG_WARN("Upgrade request from another user refused");
+        close(sock);
+        return;
+    }
+    // 发送失败时继续服务，升级socket保持原样，可以再试一次
+    int fds[2] = {listenFd_, tlsListenFd_};
+    if (!handoff::SendFds(sock, fds, tlsListenFd_ >= 0 ? 2 : 1)) {
+        LOG_ERROR("Send listen socket error!");
+        close(sock);
+        return;
+    }
+    // 新进程收到fd之后会在同一个路径上监听（先unlink再bind），这里只关闭不unlink，
+    // 否则可能删掉新进程刚建好的socket文件
+    epoller_->DelFd(upgradeFd_);
+    close(upgradeFd_);
+    upgradeFd_ = -1;
+    for (int fd : fds) {
+        if (fd >= 0) {
+            epoller_->DelFd(fd);
+            close(fd);
+        }
     }
+    listenFd_ = tlsListenFd_ = -1;
+    successorFd_ = sock;
+    draining_ = true;
+    drainDeadline_ = Tracer::NowNs() + static_cast<int64_t>(drainMS_) * 1000000;
+    CloseIdle_();
+    LOG_INFO("Listen socket handed off, draining %d connections", HttpConn::userCount.load());
+}
+
+// 旧进程通知已经保存好kv（或者它异常退出了），加载进来，已经写过的key保留新值
+void WebServer::DealPredecessor_() {
+    epoller_->DelFd(predecessorFd_);
+    close(predecessorFd_);
+    predecessorFd_ = -1;
+    kv->Load();
+    LOG_INFO("Predecessor exited, kv loaded");
 }
 
+// 开始排空时关掉手上没有请求的长连接（没在工作线程手上，没有读到一半的请求，也没有没发完的回复），
+// 不用等它们的下一个事件；其他连接处理完手上的请求之后由OnProcess关闭
+void WebServer::CloseIdle_() {
+    for (int fd = 0; fd < users_->MaxFd(); fd++) {
+        // 打开和关闭时代数都会加一，奇数说明还开着
+        HttpConn *conn = users_->Get(fd);
+        uint32_t gen = conn ? users_->Generation(fd) : 0;
+        if ((gen & 1) && !users_->Dispatched(fd) && conn->Idle()) {
+            CloseConn_(conn, gen);
+        }
+    }
+}
+
+// 到了截止时间还开着的连接全部关闭，在工作线程手上的由CloseConn_记下来，等工作线程交还时再关
+// 连接都关闭之后（工作线程手上不再有连接）保存kv，通知新进程，退出主循环
+void WebServer::CheckDrain_() {
+    if (HttpConn::userCount > 0) {
+        if (Tracer::NowNs() >= drainDeadline_) {
+            LOG_WARN("Drain deadline reached, closing %d connections", HttpConn::userCount.load());
+            for (int fd = 0; fd < users_->MaxFd(); fd++) {
+                HttpConn *conn = users_->Get(fd);
+                uint32_t gen = conn ? users_->Generation(fd) : 0;
+                if (gen & 1) {
+                    CloseConn_(conn, gen);
+                }
+            }
+            // 只强制关闭一次，之后等工作线程交还
+            drainDeadline_ = INT64_MAX;
+        }
+        return;
+    }
+    // 转储失败时继任者读到的是上一次的转储，仍然通知它，不让它一直等
+    if (!kv->Dump()) {
+        LOG_ERROR("Dump kv to %s error, keep the previous dump", STORE_FILE);
+    }
+    char done = 'D';
+    if (write(successorFd_, &done, 1) != 1) {
+        LOG_WARN("Notify successor error!");
+    }
+    close(successorFd_);
+    successorFd_ = -1;
+    draining_ = false;
+    isClose_ = true;
+    LOG_INFO("Drain finished, kv dumped");
+}
+
+void WebServer::Stop() {
+    isClose_ = true;
+    loopNotifier_.Wake();
+}
+
+// 在主循环中调用，新的连接还是阻塞的，这里不能阻塞，发不出去就算了
 void WebServer::SendError_(int fd, const char *info) {
     assert(fd > 0);
-    int ret = send(fd, info, strlen(info), 0);
+    int ret = send(fd, info, strlen(info), MSG_DONTWAIT | MSG_NOSIGNAL);
     if (ret < 0) {
         LOG_WARN("send error to client[%d] error!", fd);
     }
     close(fd);
 }
 
-// 删除客户端连接
-void WebServer::CloseConn_(HttpConn *client) {
+// 在主循环中直接拒绝请求：最多读一次请求（减少close时因为有未读数据发RST的机会），回复固定的内容，
+// 先shutdown(SHUT_WR)让回复后面跟着FIN，再关闭连接
+// 对方不停地发数据也只读一次，被拒绝的请求只花主循环固定的几次系统调用，不会进入线程池
+void WebServer::Refuse_(HttpConn *client, const char *response) {
+    static char discard[4096];
+    int fd = client->GetFd();
+    if (recv(fd, discard, sizeof(discard), MSG_DONTWAIT) < 0 && errno != EAGAIN) {
+        LOG_DEBUG("Client[%d] recv before refuse error", fd);
+    }
+    client->WriteNow(response, strlen(response));
+    shutdown(fd, SHUT_WR);
+    CloseConn_(client, users_->Generation(fd));
+}
+
+// 先按IP的总速率检查，再按请求行匹配的规则检查，只看有没有令牌，不取走（令牌在Admit_中按请求取走）
+// 请求还没有读，用MSG_PEEK看一眼请求行，数据留在内核中，工作线程照常读取
+// 令牌已经用完的IP在这里直接拒绝，不进入线程池
+bool WebServer::CheckRate_(HttpConn *client) {
+    uint32_t ip = client->GetAddr().sin_addr.s_addr;
+    if (!rateLimiter_.Check(ip, RateLimiter::IP_RULE, wakeNs_)) {
+        return false;
+    }
+    // 没有kTLS的HTTPS连接，内核中的数据是密文，只能按IP检查
+    if (!rateLimiter_.HasRequestRules() || (client->Tls().Active() && !client->Tls().KtlsRecv())) {
+        return true;
+    }
+    char line[256];
+    ssize_t len = recv(client->GetFd(), line, sizeof(line), MSG_PEEK | MSG_DONTWAIT);
+    if (len <= 0) {
+        return true;
+    }
+    int rule = rateLimiter_.Match(line, len);
+    return rule < 0 || rateLimiter_.Check(ip, rule, wakeNs_);
+}
+
+// 在工作线程中，每解析出一个完整的请求、执行之前取走令牌，流水线上的每个请求都单独计数
+bool WebServer::Admit_(const HttpRequest &request) {
+    if (!rateLimiter_.Enabled()) {
+        return true;
+    }
+    uint32_t ip = request.PeerIp();
+    int64_t now = Tracer::NowNs();
+    const string &line = request.RequestLine();
+    int rule = rateLimiter_.Match(line.data(), line.size());
+    // 两个桶都有令牌才放行，先只看IP的桶，规则的桶通过之后才从IP的桶里取令牌，
+    // 被任何一个桶拒绝的请求不会白白消耗另一个桶的令牌
+    if (rateLimiter_.Check(ip, RateLimiter::IP_RULE, now) &&
+        (rule < 0 || rateLimiter_.Allow(ip, rule, now)) &&
+        rateLimiter_.Allow(ip, RateLimiter::IP_RULE, now)) {
+        return true;
+    }
+    shedRate.Add();
+    // 在工作线程中调用，不能用inet_ntoa的静态缓冲区
+    char ipStr[INET_ADDRSTRLEN];
+    in_addr addr = {ip};
+    inet_ntop(AF_INET, &addr, ipStr, sizeof(ipStr));
+    LOG_WARN("Client(%s) rate limited: %s", ipStr, line.c_str());
+    return false;
+}
+
+// 删除客户端连接，代数对不上说明已经被别人关闭了；只在主循环中调用
+// 连接在工作线程手上时不能关闭（工作线程还在读写它），记下来等交还时再关
+void WebServer::CloseConn_(HttpConn *client, uint32_t gen) {
     assert(client);
+    if (users_->Get(client->GetFd(), gen) != client) {
+        return;
+    }
+    if (users_->Dispatched(client->GetFd())) {
+        users_->DeferClose(client->GetFd());
+        return;
+    }
+    if (!users_->Retire(client->GetFd(), gen)) {
+        return;
+    }
     LOG_INFO("Client[%d] quit!", client->GetFd());
+    // fd在Close之前不会被复用，地址还是这个连接的
+    ipLimiter_.Release(client->GetAddr().sin_addr.s_addr);
     epoller_->DelFd(client->GetFd());
+    // Close会释放SSL（SSL_free），工作线程可能正在SSL_read/SSL_write，所以上面把在工作线程手上的连接
+    // 留到交还之后才关；走到这里的连接一定不在工作线程手上
+    assert(!users_->Dispatched(client->GetFd()));
     client->Close();
 }
 
-// 添加新的客户端
-void WebServer::AddClient_(int fd, sockaddr_in addr) {
+// 工作线程要关闭连接时交给主循环，epoll的状态只由主循环修改；同时把连接交还给主循环
+void WebServer::CloseInLoop_(HttpConn *client, uint32_t gen) {
+    int fd = client->GetFd();
+    QueueInLoop_([this, client, fd, gen] {
+        if (users_->Get(fd, gen) != client) {
+            return;
+        }
+        users_->HandBack(fd);
+        CloseConn_(client, gen);
+    });
+}
+
+// 添加新的客户端，HTTPS的连接先握手
+void WebServer::AddClient_(int fd, sockaddr_in addr, bool tls) {
 
     assert(fd > 0);
-    users_[fd].init(fd, addr);
-    // 一个客户端最长连接时间
+    uint32_t gen = 0;
+    HttpConn *client = users_->Open(fd, addr, &gen);
+    client->Trace().Mark(RequestTrace::ACCEPT);
+    if (tls) {
+        ssl_st *ssl = TlsContext::Instance()->NewSsl(fd);
+        if (!ssl) {
+            LOG_ERROR("Client[%d] create SSL error!", fd);
+            users_->Retire(fd, gen);
+            ipLimiter_.Release(addr.sin_addr.s_addr);
+            client->Close();
+            return;
+        }
+        client->StartTls(ssl);
+    }
+    // 一个客户端最长连接时间，定时器只记录fd和代数，触发时连接可能已经不存在了
     if (timeoutMS_ > 0) {
-        timer_->add(fd, timeoutMS_, std::bind(&WebServer::CloseConn_, this, &users_[fd]));
+        timer_->add(fd, timeoutMS_, [this, fd, gen] {
+            HttpConn *conn = users_->Get(fd, gen);
+            if (conn) {
+                CloseConn_(conn, gen);
+            }
+        });
     }
     epoller_->AddFd(fd, EPOLLIN | connEvent_);
     SetFdNonblock(fd);
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    LOG_INFO("Client[%d] in!", client->GetFd());
 }
 
 // 处理新的客户端连接
-void WebServer::DealListen_() {
-    LOG(INFO) << "新的客户端连接";
+void WebServer::DealListen_(int listenFd) {
+    LOG_DEBUG("Listen fd[%d] readable", listenFd);
     struct sockaddr_in addr;
     socklen_t len = sizeof(addr);
-    // 如果是边缘触发，就要保证读干净了
+    bool tls = (listenFd == tlsListenFd_);
+    // HTTPS还没有握手，不能回复明文，直接关闭
+    auto refuse = [this, tls](int fd) {
+        if (tls) {
+            close(fd);
+        } else {
+            SendError_(fd, SERVICE_UNAVAILABLE);
+        }
+    };
+    // 如果是边缘触发，就要保证读干净了，拒绝一个连接之后也要继续accept
     do {
-        int fd = accept(listenFd_, (struct sockaddr *)&addr, &len);
+        int fd = accept(listenFd, (struct sockaddr *)&addr, &len);
         if (fd <= 0) {
             return;
-        } else if (HttpConn::userCount >= MAX_FD) {
-            SendError_(fd, "Server busy!");
+        } else if (HttpConn::userCount >= MAX_FD || fd >= users_->MaxFd()) {
+            rejects.Add();
+            refuse(fd);
             LOG_WARN("Clients is full!");
-            return;
+            continue;
+        } else if (!ipLimiter_.TryAcquire(addr.sin_addr.s_addr)) {
+            shedIp.Add();
+            refuse(fd);
+            LOG_WARN("Client %s has too many connections!", inet_ntoa(addr.sin_addr));
+            continue;
         }
-        AddClient_(fd, addr);
+        accepts.Add();
+        AddClient_(fd, addr, tls);
     } while (listenEvent_ & EPOLLET);
 }
 
+// 在主循环中继续TLS握手，完成之后按普通的可读事件处理（客户端可能已经把请求跟在握手后面发过来了）
+void WebServer::DealHandshake_(HttpConn *client) {
+    int fd = client->GetFd();
+    ExtentTime_(client);
+    bool wantWrite = false;
+    int ret = client->Tls().Handshake(&wantWrite);
+    if (ret < 0) {
+        LOG_DEBUG("Client[%d] TLS handshake failed", fd);
+        CloseConn_(client, users_->Generation(fd));
+    } else if (ret == 0) {
+        epoller_->ModFd(fd, connEvent_ | (wantWrite ? EPOLLOUT : EPOLLIN));
+    } else {
+        LOG_DEBUG("Client[%d] TLS established, kTLS send:%d recv:%d", fd, client->Tls().KtlsSend(),
+                  client->Tls().KtlsRecv());
+        DealRead_(client);
+    }
+}
+
 // 处理可读事件，分发到线程池
 void WebServer::DealRead_(HttpConn *client) {
-    LOG(INFO) << "客户端有请求";
     assert(client);
+    if (client->Tls().Handshaking()) {
+        DealHandshake_(client);
+        return;
+    }
+    LOG_DEBUG("Client[%d] readable", client->GetFd());
     ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client));
+    // 线程池积压时直接拒绝，让积压尽快消退
+    if (threadpool_->ShouldShed()) {
+        shedQueue.Add();
+        LOG_WARN("Client[%d] shed, worker queue is overloaded", client->GetFd());
+        Refuse_(client, SERVICE_UNAVAILABLE);
+        return;
+    }
+    if (rateLimiter_.Enabled() && !CheckRate_(client)) {
+        shedRate.Add();
+        LOG_WARN("Client[%d] rate limited", client->GetFd());
+        Refuse_(client, TOO_MANY_REQUESTS);
+        return;
+    }
+    uint32_t gen = users_->Generation(client->GetFd());
+    client->Trace().Mark(RequestTrace::WAKE, wakeNs_);
+    client->Trace().Mark(RequestTrace::DISPATCH);
+    users_->Dispatch(client->GetFd());
+    threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client, gen));
 }
 
 // 处理可写事件，分发到线程池
 void WebServer::DealWrite_(HttpConn *client) {
-    LOG(INFO) << "发东西给客户端";
     assert(client);
+    if (client->Tls().Handshaking()) {
+        DealHandshake_(client);
+        return;
+    }
+    LOG_DEBUG("Client[%d] writable", client->GetFd());
     ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnWrite_, this, client));
+    uint32_t gen = users_->Generation(client->GetFd());
+    users_->Dispatch(client->GetFd());
+    threadpool_->AddTask(std::bind(&WebServer::OnWrite_, this, client, gen));
 }
 
 // 给客户端续命（超出一定时间没有发消息，就会删除这个客户端）
@@ -193,33 +762,151 @@ void WebServer::ExtentTime_(HttpConn *client) {
 }
 
 // 工作线程从客户端的http连接中读取客户端发来的信息
-void WebServer::OnRead_(HttpConn *client) {
+void WebServer::OnRead_(HttpConn *client, uint32_t gen) {
     assert(client);
+    // 任务排队期间连接被关闭了
+    if (users_->Get(client->GetFd(), gen) != client) {
+        return;
+    }
+    client->Trace().Mark(RequestTrace::DEQUEUE);
     int ret = -1;
     int readErrno = 0;
     ret = client->read(&readErrno);
 
     if (ret <= 0 && readErrno != EAGAIN) {
-        CloseConn_(client);
+        CloseInLoop_(client, gen);
         return;
     }
-    OnProcess(client);
+    OnProcess(client, gen);
 }
 
 // 处理客户端的请求
-void WebServer::OnProcess(HttpConn *client) {
-    // 如果现在是在读事件，处理完之后就设置为监听写事件
-    if (client->process()) {
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+void WebServer::OnProcess(HttpConn *client, uint32_t gen) {
+    // 处理完请求之后直接尝试写，只有写不完（内核缓冲区满了）才去监听写事件
+    if (client->process(admit_)) {
+        OnWrite_(client, gen);
+    } else if (client->IsVerifying()) {
+        StartVerify_(client, gen);
+    } else if (draining_) {
+        // 正在排空，处理完手上的请求就关闭长连接
+        CloseInLoop_(client, gen);
     } else {
-        // 这个else代表是写事件调用的，写事件处理完了，就开始继续监听读事件
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+        // 没有待处理的请求了，继续监听读事件（交给主循环批量修改）
+        epoller_->PostModFd(client->GetFd(), connEvent_ | EPOLLIN, gen);
+    }
+}
+
+// 登录/注册交给DB线程池，验证完成之后交给工作线程准备回复并发送，主循环只负责之后的重新监听
+// 验证期间连接一直算在工作线程手上，定时器到期也只是记下要关闭，等发送完交还时再关
+void WebServer::StartVerify_(HttpConn *client, uint32_t gen) {
+    UserAuth::VerifyAsync(client->VerifyUser(), client->VerifyPwd(), client->VerifyIsLogin(),
+                          [this, client, gen](bool ok) {
+                              threadpool_->AddTask([this, client, gen, ok] {
+                                  client->FinishVerify(ok);
+                                  OnWrite_(client, gen);
+                              });
+                          });
+}
+
+// 服务器自己生成内容的管理路径
+// /metrics：监控指标，Prometheus文本格式
+// /trace：导出追踪数据（Chrome trace JSON），/trace/start 清空并打开追踪，/trace/stop 关闭追踪
+// /slowlog：最慢的请求和各阶段的耗时，/slowlog/reset 重新统计
+// /hotkeys：最近访问最多的kv key，/hotkeys/reset 重新统计
+// 这些路径和普通请求共用端口，只接受本机的请求；会修改状态的几个只接受POST
+void WebServer::RegisterAdmin_() {
+    HttpRouter::Register("/metrics", [](const HttpRequest &, string &body, string &type) {
+        body = MetricsRegistry::Instance()->Render();
+        type = "text/plain; version=0.0.4";
+        return 200;
+    }, HttpRouter::LOCAL_ONLY);
+    HttpRouter::Register("/trace", [](const HttpRequest &, string &body, string &type) {
+        body = Tracer::Instance()->DumpJson();
+        type = "application/json";
+        return 200;
+    }, HttpRouter::LOCAL_ONLY);
+    HttpRouter::Register("/trace/start", [](const HttpRequest &, string &body, string &) {
+        Tracer::Instance()->Clear();
+        Tracer::Instance()->SetEnabled(true);
+        body = "tracing on\n";
+        return 200;
+    }, HttpRouter::LOCAL_ONLY | HttpRouter::POST_ONLY);
+    HttpRouter::Register("/trace/stop", [](const HttpRequest &, string &body, string &) {
+        Tracer::Instance()->SetEnabled(false);
+        body = "tracing off\n";
+        return 200;
+    }, HttpRouter::LOCAL_ONLY | HttpRouter::POST_ONLY);
+    HttpRouter::Register("/slowlog", [](const HttpRequest &, string &body, string &) {
+        body = SlowLog::Instance()->Render();
+        return 200;
+    }, HttpRouter::LOCAL_ONLY);
+    HttpRouter::Register("/slowlog/reset", [](const HttpRequest &, string &body, string &) {
+        SlowLog::Instance()->Clear();
+        body = "OK\n";
+        return 200;
+    }, HttpRouter::LOCAL_ONLY | HttpRouter::POST_ONLY);
+    // 路由表比服务器活得久，只持有kv的弱引用
+    weak_ptr<KvStore> weakKv = kv;
+    HttpRouter::Register("/hotkeys", [weakKv](const HttpRequest &, string &body, string &) {
+        shared_ptr<KvStore> store = weakKv.lock();
+        if (!store) {
+            return 404;
+        }
+        body = store->Hot().Render();
+        return 200;
+    }, HttpRouter::LOCAL_ONLY);
+    HttpRouter::Register("/hotkeys/reset", [weakKv](const HttpRequest &, string &body, string &) {
+        shared_ptr<KvStore> store = weakKv.lock();
+        if (!store) {
+            return 404;
+        }
+        store->Hot().Clear();
+        body = "OK\n";
+        return 200;
+    }, HttpRouter::LOCAL_ONLY | HttpRouter::POST_ONLY);
+}
+
+// 投递一个任务给主循环执行，主循环Arm之后第一个投递的线程负责唤醒
+void WebServer::QueueInLoop_(std::function<void()> task) {
+    while (!loopTasks_.TryPush(std::move(task))) {
+        loopNotifier_.Wake();
+        std::this_thread::yield();
+    }
+    loopNotifier_.Notify();
+}
+
+// 主循环执行其他线程投递过来的任务
+void WebServer::RunLoopTasks_() {
+    loopNotifier_.Drain();
+    loopNotifier_.Arm();
+    if (reloadRequested.exchange(false)) {
+        Reload_();
     }
+    // 导出追踪数据比较慢，交给工作线程
+    if (traceDumpRequested.exchange(false)) {
+        threadpool_->AddTask([] {
+            string path = "./trace-" + to_string(getpid()) + "-" + to_string(time(nullptr)) + ".json";
+            if (Tracer::Instance()->DumpToFile(path)) {
+                LOG_INFO("Trace dumped to %s", path.c_str());
+            } else {
+                LOG_ERROR("Trace dump to %s failed!", path.c_str());
+            }
+        });
+    }
+    loopTasks_.PopBatch(
+        [](std::function<void()> &task) {
+            task();
+            task = nullptr;
+        },
+        MAX_LOOP_TASKS);
 }
 
 // 处理客户端写事件
-void WebServer::OnWrite_(HttpConn *client) {
+void WebServer::OnWrite_(HttpConn *client, uint32_t gen) {
     assert(client);
+    if (users_->Get(client->GetFd(), gen) != client) {
+        return;
+    }
     int ret = -1;
     int writeErrno = 0;
     // 将给客户端的http回复写到fd中
@@ -227,32 +914,31 @@ void WebServer::OnWrite_(HttpConn *client) {
     // 如果写完了，并且是长连接
     if (client->ToWriteBytes() == 0) {
         if (client->IsKeepAlive()) {
-            OnProcess(client);
+            OnProcess(client, gen);
             return;
         }
     }
-    // 如果写操作没成功，并且是因为内核缓冲区满了，那就再接再厉，继续监听可写事件
-    else if (ret < 0) {
-        if (writeErrno == EAGAIN) {
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
-            return;
-        }
+    // 如果没写完，并且是因为内核缓冲区满了，那就再接再厉，继续监听可写事件
+    else if (ret >= 0 || writeErrno == EAGAIN) {
+        epoller_->PostModFd(client->GetFd(), connEvent_ | EPOLLOUT, gen);
+        return;
     }
     // 如果写成功了，并且是短连接，那处理完一次http事件后就关闭连接
-    CloseConn_(client);
+    CloseInLoop_(client, gen);
 }
 
-// 初始化listen的fd到epoll中
-bool WebServer::InitSocket_() {
+// 监听port并加入epoll，返回监听的fd，失败返回-1；quiet时绑定失败（端口被旧进程占着）不记日志
+int WebServer::InitSocket_(int port, bool quiet) {
+    int listenFd;
     int ret;
     struct sockaddr_in addr;
-    if (port_ > 65535 || port_ < 1024) {
-        LOG_ERROR("Port:%d error!", port_);
-        return false;
+    if (port > 65535 || port < 1024) {
+        LOG_ERROR("Port:%d error!", port);
+        return -1;
     }
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    addr.sin_port = htons(port_);
+    addr.sin_port = htons(port);
     // 设置关闭fd时的模式
     struct linger optLinger = {0};
     if (openLinger_) {
@@ -260,51 +946,53 @@ bool WebServer::InitSocket_() {
         optLinger.l_linger = 1;
     }
 
-    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (listenFd_ < 0) {
-        LOG_ERROR("Create socket error!", port_);
-        return false;
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        LOG_ERROR("Create socket error!", port);
+        return -1;
     }
 
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
     if (ret < 0) {
-        close(listenFd_);
-        LOG_ERROR("Init linger error!", port_);
-        return false;
+        close(listenFd);
+        LOG_ERROR("Init linger error!", port);
+        return -1;
     }
 
     int optval = 1;
     // 避免重启时之前的socket还没有被销毁导致无法监听端口
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, (const void *)&optval, sizeof(int));
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, (const void *)&optval, sizeof(int));
     if (ret == -1) {
         LOG_ERROR("set socket setsockopt error !");
-        close(listenFd_);
-        return false;
+        close(listenFd);
+        return -1;
     }
 
-    ret = bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr));
+    ret = bind(listenFd, (struct sockaddr *)&addr, sizeof(addr));
     if (ret < 0) {
-        LOG_ERROR("Bind Port:%d error!", port_);
-        close(listenFd_);
-        return false;
+        if (!quiet) {
+            LOG_ERROR("Bind Port:%d error!", port);
+        }
+        close(listenFd);
+        return -1;
     }
 
-    ret = listen(listenFd_, 6);
+    ret = listen(listenFd, 6);
     if (ret < 0) {
-        LOG_ERROR("Listen port:%d error!", port_);
-        close(listenFd_);
-        return false;
+        LOG_ERROR("Listen port:%d error!", port);
+        close(listenFd);
+        return -1;
     }
-    ret = epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN);
+    ret = epoller_->AddFd(listenFd, listenEvent_ | EPOLLIN);
     if (ret == 0) {
         LOG_ERROR("Add listen error!");
-        close(listenFd_);
-        return false;
+        close(listenFd);
+        return -1;
     }
     // 设置listenFd为非阻塞的，这样在没有数据时调用read函数也不会阻塞，而是返回一个错误值
-    SetFdNonblock(listenFd_);
-    LOG_INFO("Server port:%d", port_);
-    return true;
+    SetFdNonblock(listenFd);
+    LOG_INFO("Server port:%d", port);
+    return listenFd;
 }
 
 // 设置fd为非阻塞
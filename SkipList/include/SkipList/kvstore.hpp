@@ -1,16 +1,23 @@
 #ifndef KVSTORE
 #define KVSTORE
 #include "SkipList/newskiplist.hpp"
+#include "Metrics/hotkeys.hpp"
 
+// set/get/del都会采样记录到hotKeys_中，用Hot()查看最近的热点key
+// Dump把所有数据写到STORE_FILE（写失败时返回false，原来的文件不变），Load读回来，已经存在的key保留现在的值
 class KvStore {
 public:
     KvStore() : skip_list(5) {}
     bool set(std::string, std::string);
     std::string get(std::string);
     void del(std::string);
+    bool Dump() { return skip_list.dump_file(); }
+    void Load() { skip_list.load_file(); }
     void print() { printf("hehe\n"); }
+    HotKeys &Hot() { return hotKeys_; }
 
 private:
     SkipList<std::string, std::string> skip_list;
+    HotKeys hotKeys_;
 };
 #endif
\ No newline at end of file
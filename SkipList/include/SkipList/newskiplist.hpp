@@ -7,12 +7,16 @@
 #include <memory>
 #include <vector>
 #include <fstream>
+#include <sstream>
 #include <filesystem>
+#include <system_error>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #define STORE_FILE "store/dumpFile"
 #define STORE_PRE "store"
+// 转储文件的第一行，没有这一行的是旧格式（每行一个"key:value"）
+#define STORE_HEADER "skiplist dump v2"
 
 const std::string delimiter = ":";
 
@@ -43,7 +47,7 @@ template <typename K, typename V>
 class SkipList {
 public:
     SkipList(){};
-    ~SkipList(){};
+    ~SkipList();
     SkipList(int);
     int get_random_level();
     std::shared_ptr<Node<K, V>> create_node(K, V, int);
@@ -52,7 +56,8 @@ public:
     bool search_element(K);
     void delete_element(K);
     V get_element(K);
-    void dump_file();
+    // 写失败时返回false，之前的转储文件保持不变
+    bool dump_file();
     void load_file();
     int size();
 
@@ -88,6 +93,25 @@ SkipList<K, V>::SkipList(int _max_level) {
     this->_element_count = 0;
 }
 
+// 节点之间用shared_ptr串起来，默认的析构会沿着第0层递归释放，节点很多时会栈溢出，这里逐个断开
+template <typename K, typename V>
+SkipList<K, V>::~SkipList() {
+    if (!_header) {
+        return;
+    }
+    std::shared_ptr<Node<K, V>> node = _header->forward[0];
+    for (auto &next : _header->forward) {
+        next.reset();
+    }
+    while (node) {
+        std::shared_ptr<Node<K, V>> next = node->forward[0];
+        for (auto &forward : node->forward) {
+            forward.reset();
+        }
+        node = std::move(next);
+    }
+}
+
 template <typename K, typename V>
 std::shared_ptr<Node<K, V>> SkipList<K, V>::create_node(const K k, const V v, int level) {
     return std::make_shared<Node<K, V>>(k, v, level);
@@ -136,7 +160,6 @@ int SkipList<K, V>::insert_element(const K key, const V value) {
     // if current node have key equal to searched key, we get it
     // 如果已存在，则返回1
     if (current && current->get_key() == key) {
-        std::cout << "key: " << key << ", exists" << std::endl;
         return 1;
     }
 
@@ -165,7 +188,6 @@ int SkipList<K, V>::insert_element(const K key, const V value) {
             inserted_node->forward[i] = update[i]->forward[i];
             update[i]->forward[i] = inserted_node;
         }
-        std::cout << "Successfully inserted key:" << key << ", value:" << value << std::endl;
         _element_count++;
     }
     return 0;
@@ -187,45 +209,92 @@ void SkipList<K, V>::display_list() {
     }
 }
 
+/*
+转储文件的格式：第一行是STORE_HEADER，之后每条数据写成"key长度:value长度:keyvalue\n"
+按长度读取，key和value中出现':'或者换行也不会被拆错
+*/
 template <typename K, typename V>
-void SkipList<K, V>::dump_file() {
+bool SkipList<K, V>::dump_file() {
 
-    std::cout << "dump_file-----------------" << std::endl;
+    std::lock_guard<std::mutex> lgmtx(mtx);
     // C++不能直接创建文件夹，因此需要先创建文件夹，再创建文件。其中文件时可以通过ofstream默认操作的
     if (!std::filesystem::exists(STORE_PRE)) {
         mkdir(STORE_PRE, S_IRUSR | S_IWUSR | S_IXUSR | S_IRWXG | S_IRWXO);
     }
-    _file_writer.open(STORE_FILE);
+    // 先写到临时文件再改名，写到一半退出或者写失败时不会破坏之前的文件
+    _file_writer.open(STORE_FILE ".tmp", std::ios::out | std::ios::trunc | std::ios::binary);
+    _file_writer << STORE_HEADER << "\n";
 
     std::shared_ptr<Node<K, V>> Node2 = this->_header->forward[0];
 
-    while (Node2 != NULL) {
-        _file_writer << Node2->get_key() << ":" << Node2->get_value() << "\n";
-        std::cout << Node2->get_key() << ":" << Node2->get_value() << ";\n";
+    while (Node2 != NULL && _file_writer) {
+        std::ostringstream key, value;
+        key << Node2->get_key();
+        value << Node2->get_value();
+        _file_writer << key.str().size() << ":" << value.str().size() << ":" << key.str()
+                     << value.str() << "\n";
         Node2 = Node2->forward[0];
     }
 
     _file_writer.flush();
+    bool ok = _file_writer.good();
     _file_writer.close();
-    return;
+    ok = ok && !_file_writer.fail();
+    _file_writer.clear();
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(STORE_FILE ".tmp", STORE_FILE, ec);
+    }
+    if (!ok || ec) {
+        std::filesystem::remove(STORE_FILE ".tmp", ec);
+        return false;
+    }
+    return true;
 }
 
 template <typename K, typename V>
 void SkipList<K, V>::load_file() {
-    _file_reader.open(STORE_FILE);
-    std::cout << "load_file-----------------" << std::endl;
+    _file_reader.open(STORE_FILE, std::ios::in | std::ios::binary);
+    std::error_code ec;
+    uintmax_t fileSize = std::filesystem::file_size(STORE_FILE, ec);
     std::string line;
     std::string key;
     std::string value;
-    while (getline(_file_reader, line)) {
-        get_key_value_from_string(line, key, value);
-        if (key.empty() || value.empty()) {
-            continue;
+    if (ec || !getline(_file_reader, line)) {
+        _file_reader.close();
+        _file_reader.clear();
+        return;
+    }
+    if (line == STORE_HEADER) {
+        size_t keyLen = 0, valueLen = 0;
+        char sep1 = 0, sep2 = 0;
+        while (_file_reader >> keyLen >> sep1 >> valueLen >> sep2) {
+            // 长度不对说明文件被截断或者损坏，后面的数据都不要了
+            if (sep1 != ':' || sep2 != ':' || keyLen > fileSize || valueLen > fileSize - keyLen) {
+                break;
+            }
+            key.assign(keyLen, '\0');
+            value.assign(valueLen, '\0');
+            if (!_file_reader.read(&key[0], keyLen) || !_file_reader.read(&value[0], valueLen) ||
+                _file_reader.get() != '\n') {
+                break;
+            }
+            insert_element(key, value);
         }
-        insert_element(key, value);
-        std::cout << "key:" << key << "value:" << value << std::endl;
+    } else {
+        // 旧格式，按第一个':'拆开
+        do {
+            key.clear();
+            value.clear();
+            get_key_value_from_string(line, key, value);
+            if (key.empty() || value.empty()) {
+                continue;
+            }
+            insert_element(key, value);
+        } while (getline(_file_reader, line));
     }
     _file_reader.close();
+    _file_reader.clear();
 }
 
 template <typename K, typename V>
@@ -285,7 +354,6 @@ void SkipList<K, V>::delete_element(K key) {
             _skip_list_level--;
         }
 
-        std::cout << "Successfully deleted key " << key << std::endl;
         _element_count--;
     }
     return;
@@ -313,7 +381,6 @@ level 0         1    4   9 10         30   40    50+-->60      70       100
 template <typename K, typename V>
 bool SkipList<K, V>::search_element(K key) {
     std::lock_guard<std::mutex> lgmtx(mtx);
-    std::cout << "search_element-----------------" << std::endl;
     std::shared_ptr<Node<K, V>> current = _header;
 
     // start from highest level of skip list
@@ -328,11 +395,9 @@ bool SkipList<K, V>::search_element(K key) {
 
     // if current Node2 have key equal to searched key, we get it
     if (current and current->get_key() == key) {
-        std::cout << "Found key: " << key << ", value: " << current->get_value() << std::endl;
         return true;
     }
 
-    std::cout << "Not Found Key:" << key << std::endl;
     return false;
 }
 
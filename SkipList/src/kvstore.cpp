@@ -1,7 +1,14 @@
 #include "SkipList/kvstore.hpp"
 
 bool KvStore::set(std::string key, std::string value) {
+    hotKeys_.Record(key);
     return skip_list.insert_element(key, value);
 }
-std::string KvStore::get(std::string key) { return skip_list.get_element(key); }
-void KvStore::del(std::string key) { skip_list.delete_element(key); }
\ No newline at end of file
+std::string KvStore::get(std::string key) {
+    hotKeys_.Record(key);
+    return skip_list.get_element(key);
+}
+void KvStore::del(std::string key) {
+    hotKeys_.Record(key);
+    skip_list.delete_element(key);
+}
\ No newline at end of file
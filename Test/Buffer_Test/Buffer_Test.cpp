@@ -19,3 +19,32 @@ TEST(BufferPool_Test, test_buffer) {
     CHECK(bytes == str1.size());
     close(newFd);
 }
+
+// 池化的Buffer只在有数据时才持有缓冲块
+TEST(BufferPool_Test, test_lazy_attach) {
+    Buffer buffer(0);
+    CHECK(buffer.Capacity() == 0);
+    buffer.Append("GET / HTTP/1.1\r\n");
+    CHECK(buffer.Capacity() == BufferPool::CHUNK_SIZE);
+    size_t freeCount = BufferPool::Instance()->FreeCount();
+    buffer.Retrieve(buffer.ReadableBytes());
+    CHECK(buffer.Capacity() == 0);
+    CHECK(BufferPool::Instance()->FreeCount() == freeCount + 1);
+}
+
+// 没有读到数据时（EAGAIN）不持有缓冲块
+TEST(BufferPool_Test, test_read_eagain) {
+    int fds[2];
+    ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+    Buffer buffer(0);
+    int err = 0;
+    EXPECT_EQ(buffer.ReadFd(fds[0], &err), -1);
+    EXPECT_EQ(err, EAGAIN);
+    EXPECT_EQ(buffer.Capacity(), 0u);
+
+    ASSERT_EQ(write(fds[1], "abc", 3), 3);
+    EXPECT_EQ(buffer.ReadFd(fds[0], &err), 3);
+    EXPECT_EQ(buffer.Capacity(), BufferPool::CHUNK_SIZE);
+    close(fds[0]);
+    close(fds[1]);
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include "glog/logging.h"
+#include "Buffer/chainbuffer.hpp"
+#include <string>
+
+// 超过一块的数据通过writev写出，再通过readv直接读进缓冲块
+TEST(ChainBuffer_Test, test_read_write) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::string data(BufferPool::CHUNK_SIZE * 3 + 100, 'x');
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = 'a' + i % 26;
+    }
+    ChainBuffer out;
+    out.Append(data);
+    EXPECT_EQ(out.BlockCount(), 4u);
+    int err = 0;
+    EXPECT_EQ(out.WriteFd(fds[1], &err), static_cast<ssize_t>(data.size()));
+    EXPECT_EQ(out.ReadableBytes(), 0u);
+
+    ChainBuffer in;
+    EXPECT_EQ(in.ReadFd(fds[0], &err), static_cast<ssize_t>(data.size()));
+    EXPECT_EQ(in.RetrieveAllToStr(), data);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// Splice不拷贝数据，只有一块时MoveInto直接交出缓冲块
+TEST(ChainBuffer_Test, test_splice) {
+    ChainBuffer a, b;
+    a.Append("hello ");
+    b.Append("world");
+    a.Splice(b);
+    EXPECT_EQ(b.ReadableBytes(), 0u);
+    EXPECT_EQ(a.BlockCount(), 2u);
+    a.Retrieve(6);
+    EXPECT_EQ(a.BlockCount(), 1u);
+
+    Buffer buff(0);
+    a.MoveInto(buff);
+    EXPECT_EQ(a.ReadableBytes(), 0u);
+    EXPECT_EQ(buff.RetrieveAllToStr(), "world");
+}
+
+// 跨块查找和取出，pattern正好被两块分开
+TEST(ChainBuffer_Test, test_find) {
+    ChainBuffer buff;
+    std::string first(BufferPool::CHUNK_SIZE - 1, 'a');
+    buff.Append(first + "\r\nbody\r\n");
+    ASSERT_EQ(buff.BlockCount(), 2u);
+    EXPECT_EQ(buff.Find("\r\n", 2), first.size());
+    EXPECT_EQ(buff.Find("\r\n", 2, first.size() + 1), first.size() + 6);
+    EXPECT_EQ(buff.Find("\r\n\r\n", 4), ChainBuffer::npos);
+    EXPECT_EQ(buff.Substr(first.size() - 2, 8), "aa\r\nbody");
+    buff.Retrieve(first.size() + 2);
+    EXPECT_EQ(buff.Find("\r\n", 2), 4u);
+    EXPECT_EQ(buff.Substr(0, 4), "body");
+}
+
+// 大的string直接接管为一块，短的拷贝到最后一块中
+TEST(ChainBuffer_Test, test_append_string) {
+    ChainBuffer buff;
+    std::string big(ChainBuffer::MIN_ADOPT * 4, 'v');
+    const char *data = big.data();
+    buff.Append("head ");
+    buff.AppendString(std::move(big));
+    EXPECT_EQ(buff.BlockCount(), 2u);
+    struct iovec iov[4];
+    ASSERT_EQ(buff.ExportIov(iov, 4), 2);
+    EXPECT_EQ(iov[1].iov_base, data);
+    buff.Append("\n", 1);
+    buff.AppendString(std::string("tail"));
+    EXPECT_EQ(buff.BlockCount(), 3u);
+    EXPECT_EQ(buff.RetrieveAllToStr(), "head " + std::string(ChainBuffer::MIN_ADOPT * 4, 'v') + "\ntail");
+}
+
+// 读完的块回到本线程的空闲块，反复读写时不经过池
+TEST(ChainBuffer_Test, test_read_spare) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    ChainBuffer buff;
+    int err = 0;
+    ASSERT_EQ(write(fds[1], "abc", 3), 3);
+    ASSERT_EQ(buff.ReadFd(fds[0], &err), 3);
+    buff.RetrieveAll();
+    size_t freeCount = BufferPool::Instance()->FreeCount();
+    for (int i = 0; i < ChainBuffer::MAX_IOV * 2; i++) {
+        ASSERT_EQ(write(fds[1], "abc", 3), 3);
+        ASSERT_EQ(buff.ReadFd(fds[0], &err), 3);
+        EXPECT_EQ(buff.RetrieveAllToStr(), "abc");
+    }
+    EXPECT_EQ(BufferPool::Instance()->FreeCount(), freeCount);
+    close(fds[0]);
+    close(fds[1]);
+}
@@ -0,0 +1,102 @@
+#ifndef TEST_CERT_H
+#define TEST_CERT_H
+
+#ifdef HTTP_HAVE_TLS
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+/*
+测试用的自签名证书（EC P-256，CN=localhost，一小时有效）
+证书和私钥写在mkdtemp建的目录中（只有自己能访问），每个对象一个目录，析构时删掉
+*/
+class TestCert {
+public:
+    TestCert() = default;
+    TestCert(const TestCert &) = delete;
+    TestCert &operator=(const TestCert &) = delete;
+
+    ~TestCert() {
+        if (dir_.empty()) {
+            return;
+        }
+        unlink(cert_.c_str());
+        unlink(key_.c_str());
+        rmdir(dir_.c_str());
+    }
+
+    // 生成证书和私钥，失败返回false
+    bool Make() {
+        if (dir_.empty()) {
+            char dir[] = "/tmp/test_cert_XXXXXX";
+            if (!mkdtemp(dir)) {
+                return false;
+            }
+            dir_ = dir;
+            cert_ = dir_ + "/cert.pem";
+            key_ = dir_ + "/key.pem";
+        }
+        EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+        EVP_PKEY *key = nullptr;
+        bool ok = pctx && EVP_PKEY_keygen_init(pctx) == 1 &&
+                  EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) == 1 &&
+                  EVP_PKEY_keygen(pctx, &key) == 1;
+        EVP_PKEY_CTX_free(pctx);
+        X509 *cert = X509_new();
+        if (ok) {
+            ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+            X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+            X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+            X509_set_pubkey(cert, key);
+            X509_NAME *name = X509_get_subject_name(cert);
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                       reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+            X509_set_issuer_name(cert, name);
+            ok = X509_sign(cert, key, EVP_sha256()) > 0;
+        }
+        FILE *certFp = Open_(cert_, 0644);
+        FILE *keyFp = Open_(key_, 0600);
+        ok = ok && certFp && keyFp && PEM_write_X509(certFp, cert) == 1 &&
+             PEM_write_PrivateKey(keyFp, key, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+        if (certFp) {
+            ok = fclose(certFp) == 0 && ok;
+        }
+        if (keyFp) {
+            ok = fclose(keyFp) == 0 && ok;
+        }
+        X509_free(cert);
+        EVP_PKEY_free(key);
+        return ok;
+    }
+
+    const std::string &CertFile() const { return cert_; }
+    const std::string &KeyFile() const { return key_; }
+
+private:
+    // 按给定的权限创建（或截断）文件
+    static FILE *Open_(const std::string &path, mode_t mode) {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+        if (fd < 0) {
+            return nullptr;
+        }
+        FILE *fp = fdopen(fd, "w");
+        if (!fp) {
+            close(fd);
+        }
+        return fp;
+    }
+
+    std::string dir_;
+    std::string cert_;
+    std::string key_;
+};
+
+#endif // HTTP_HAVE_TLS
+
+#endif // TEST_CERT_H
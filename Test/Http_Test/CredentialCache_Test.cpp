@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "glog/logging.h"
+#include "Http/credentialcache.hpp"
+
+static std::string Hex(const Sha256::Digest &digest) {
+    static const char *HEX = "0123456789abcdef";
+    std::string out;
+    for (uint8_t b : digest) {
+        out += HEX[b >> 4];
+        out += HEX[b & 0xf];
+    }
+    return out;
+}
+
+// FIPS 180-4的测试向量，再加一个跨越两个分组的长输入
+TEST(CredentialCache_Test, test_sha256) {
+    EXPECT_EQ(Hex(Sha256::Hash("")),
+              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    EXPECT_EQ(Hex(Sha256::Hash("abc")),
+              "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    EXPECT_EQ(Hex(Sha256::Hash("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")),
+              "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    Sha256 sha;
+    std::string million(1000000, 'a');
+    for (size_t i = 0; i < million.size(); i += 999) {
+        sha.Update(million.data() + i, std::min<size_t>(999, million.size() - i));
+    }
+    EXPECT_EQ(Hex(sha.Final()), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST(CredentialCache_Test, test_check) {
+    CredentialCache cache(16, std::chrono::seconds(60), std::chrono::seconds(60));
+    EXPECT_EQ(cache.Check("alice", "pwd"), CredentialCache::MISS);
+    cache.Put("alice", "pwd");
+    cache.PutUnknown("bob");
+    EXPECT_EQ(cache.Check("alice", "pwd"), CredentialCache::MATCH);
+    EXPECT_EQ(cache.Check("alice", "pwd2"), CredentialCache::MISMATCH);
+    EXPECT_EQ(cache.Check("bob", "pwd"), CredentialCache::UNKNOWN_USER);
+    // 注册之后负缓存被覆盖
+    cache.Erase("bob");
+    EXPECT_EQ(cache.Check("bob", "pwd"), CredentialCache::MISS);
+    cache.Put("bob", "secret");
+    EXPECT_EQ(cache.Check("bob", "secret"), CredentialCache::MATCH);
+    EXPECT_EQ(cache.Hits(), 4u);
+    EXPECT_EQ(cache.Misses(), 2u);
+    EXPECT_TRUE(CredentialCache::SecretEqual("abc", "abc"));
+    EXPECT_FALSE(CredentialCache::SecretEqual("abc", "abd"));
+}
+
+// 超过容量时淘汰最久没有用过的，过期的条目当作没有缓存
+TEST(CredentialCache_Test, test_lru_ttl) {
+    CredentialCache cache(3, std::chrono::seconds(60), std::chrono::milliseconds(20));
+    cache.Put("a", "1");
+    cache.Put("b", "2");
+    cache.Put("c", "3");
+    EXPECT_EQ(cache.Check("a", "1"), CredentialCache::MATCH);
+    cache.Put("d", "4");
+    EXPECT_EQ(cache.Size(), 3u);
+    EXPECT_EQ(cache.Check("b", "2"), CredentialCache::MISS);
+    EXPECT_EQ(cache.Check("a", "1"), CredentialCache::MATCH);
+    cache.PutUnknown("e");
+    EXPECT_EQ(cache.Check("c", "3"), CredentialCache::MISS);
+    EXPECT_EQ(cache.Check("e", ""), CredentialCache::UNKNOWN_USER);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_EQ(cache.Check("e", ""), CredentialCache::MISS);
+    EXPECT_EQ(cache.Check("d", "4"), CredentialCache::MATCH);
+}
+
+// 运行时把容量调小，淘汰最久没有用过的
+TEST(CredentialCache_Test, test_set_limits) {
+    CredentialCache cache(4, std::chrono::seconds(60), std::chrono::seconds(5));
+    cache.Put("a", "1");
+    cache.Put("b", "2");
+    cache.Put("c", "3");
+    EXPECT_EQ(cache.Check("a", "1"), CredentialCache::MATCH);
+    cache.SetLimits(2, std::chrono::seconds(60), std::chrono::seconds(5));
+    EXPECT_EQ(cache.Size(), 2u);
+    EXPECT_EQ(cache.Check("b", "2"), CredentialCache::MISS);
+    EXPECT_EQ(cache.Check("a", "1"), CredentialCache::MATCH);
+    EXPECT_EQ(cache.Check("c", "3"), CredentialCache::MATCH);
+}
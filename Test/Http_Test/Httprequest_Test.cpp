@@ -2,9 +2,160 @@
 #include "glog/logging.h"
 #include "Http/httprequest.hpp"
 #include "Http/httpconn.hpp"
+#include "Http/httprouter.hpp"
 
 TEST(Httprequest_Test, test_basic) {
     HttpConn hc;
     hc.kv->print();
     hc.kv->set("1", "2");
 }
+
+// 流水线上的多个请求：请求体按Content-Length取，不会吞掉下一个请求
+TEST(Httprequest_Test, test_pipeline) {
+    auto kv = std::make_shared<KvStore>();
+    HttpRequest request(kv);
+    ChainBuffer buff;
+    buff.Append("GET /index.html HTTP/1.1\r\nConnection: keep-alive\r\n\r\n"
+                "POST / HTTP/1.1\r\nContent-Length: 7\r\n\r\nset a 1"
+                "POST / HTTP/1.1\r\ncontent-length: 5\r\n\r\nget a"
+                "GET /login HTTP/1.1\r\n\r\n");
+    request.Init();
+    ASSERT_EQ(request.parse(buff), HttpRequest::GET_REQUEST);
+    EXPECT_EQ(request.method(), "GET");
+    EXPECT_EQ(request.path(), "/index.html");
+    EXPECT_TRUE(request.IsKeepAlive());
+    request.Init();
+    ASSERT_EQ(request.parse(buff), HttpRequest::GET_REQUEST);
+    EXPECT_EQ(request.method(), "POST");
+    EXPECT_EQ(request.value, "OK");
+    request.Init();
+    ASSERT_EQ(request.parse(buff), HttpRequest::GET_REQUEST);
+    EXPECT_EQ(request.value, "1");
+    request.Init();
+    ASSERT_EQ(request.parse(buff), HttpRequest::GET_REQUEST);
+    EXPECT_EQ(request.path(), "/login.html");
+    EXPECT_EQ(buff.ReadableBytes(), 0u);
+}
+
+// 请求跨越多个缓冲块时也能解析，换行正好落在两块之间
+TEST(Httprequest_Test, test_cross_block) {
+    HttpRequest request(std::make_shared<KvStore>());
+    std::string head = "POST / HTTP/1.1\r\nX-Pad: ";
+    std::string pad(BufferPool::CHUNK_SIZE - head.size() - 1, 'x');
+    std::string value(BufferPool::CHUNK_SIZE, 'v');
+    std::string body = "set big " + value;
+    ChainBuffer buff;
+    buff.Append(head + pad + "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body);
+    ASSERT_GT(buff.BlockCount(), 1u);
+    request.Init();
+    ASSERT_EQ(request.parse(buff), HttpRequest::GET_REQUEST);
+    EXPECT_EQ(request.value, "OK");
+    EXPECT_EQ(buff.ReadableBytes(), 0u);
+    EXPECT_EQ(request.kv_req->get("big"), value);
+}
+
+// 请求分几次到达：头部或者请求体没读全时不取走任何数据，读全之后才执行
+TEST(Httprequest_Test, test_partial) {
+    HttpRequest request(std::make_shared<KvStore>());
+    std::string value(20000, 'v');
+    std::string body = "set big " + value;
+    std::string req = "POST / HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    ChainBuffer buff;
+    size_t headLen = req.size() - body.size();
+    buff.Append(req.substr(0, headLen - 3));
+    request.Init();
+    EXPECT_EQ(request.parse(buff), HttpRequest::NO_REQUEST);
+    EXPECT_EQ(buff.ReadableBytes(), headLen - 3);
+    buff.Append(req.substr(headLen - 3, 1000));
+    request.Init();
+    EXPECT_EQ(request.parse(buff), HttpRequest::NO_REQUEST);
+    EXPECT_EQ(buff.ReadableBytes(), headLen - 3 + 1000);
+    EXPECT_EQ(request.kv_req->get("big"), "None");
+    buff.Append(req.substr(headLen - 3 + 1000));
+    request.Init();
+    ASSERT_EQ(request.parse(buff), HttpRequest::GET_REQUEST);
+    EXPECT_EQ(request.value, "OK");
+    EXPECT_EQ(buff.ReadableBytes(), 0u);
+    EXPECT_EQ(request.kv_req->get("big"), value);
+}
+
+// 格式错误的请求行
+TEST(Httprequest_Test, test_bad_request) {
+    HttpRequest request(std::make_shared<KvStore>());
+    ChainBuffer buff;
+    buff.Append("NOT A REQUEST\r\n\r\n");
+    request.Init();
+    EXPECT_EQ(request.parse(buff), HttpRequest::BAD_REQUEST);
+}
+
+// kv命令的参数个数不对：回复400，不会越界访问，也不会修改数据
+TEST(Httprequest_Test, test_bad_kv) {
+    auto kv = std::make_shared<KvStore>();
+    for (const char *body : {"set k", "get", "del", "set", "get a b", "set k v x"}) {
+        HttpRequest request(kv);
+        ChainBuffer buff;
+        buff.Append("POST / HTTP/1.1\r\nContent-Length: " + std::to_string(strlen(body)) + "\r\n\r\n" +
+                    body);
+        request.Init();
+        EXPECT_EQ(request.parse(buff), HttpRequest::BAD_REQUEST) << body;
+        EXPECT_EQ(buff.ReadableBytes(), 0u);
+    }
+    EXPECT_EQ(kv->get("k"), "None");
+    // 不是kv命令的请求体不受影响
+    HttpRequest request(kv);
+    ChainBuffer buff;
+    buff.Append("POST / HTTP/1.1\r\nContent-Length: 9\r\n\r\nname=test");
+    request.Init();
+    EXPECT_EQ(request.parse(buff), HttpRequest::GET_REQUEST);
+}
+
+// 只接受本机/只接受POST的路径：不满足条件时不执行Handler
+TEST(Httprequest_Test, test_router_flags) {
+    int calls = 0;
+    HttpRouter::Register("/test/reset", [&calls](const HttpRequest &, std::string &body, std::string &) {
+        calls++;
+        body = "OK\n";
+        return 200;
+    }, HttpRouter::LOCAL_ONLY | HttpRouter::POST_ONLY);
+    auto Run = [](const char *peer, const std::string &req) {
+        HttpRequest request(std::make_shared<KvStore>());
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        inet_pton(AF_INET, peer, &addr.sin_addr);
+        request.SetPeer(addr);
+        ChainBuffer buff;
+        buff.Append(req);
+        request.Init();
+        EXPECT_EQ(request.parse(buff), HttpRequest::GET_REQUEST);
+        int code = 0;
+        std::string body, type;
+        EXPECT_TRUE(HttpRouter::Dispatch(request, &code, &body, &type));
+        return code;
+    };
+    EXPECT_EQ(Run("10.0.0.1", "POST /test/reset HTTP/1.1\r\n\r\n"), 403);
+    EXPECT_EQ(Run("127.0.0.1", "GET /test/reset HTTP/1.1\r\n\r\n"), 405);
+    EXPECT_EQ(calls, 0);
+    EXPECT_EQ(Run("127.0.0.1", "POST /test/reset HTTP/1.1\r\n\r\n"), 200);
+    EXPECT_EQ(calls, 1);
+}
+
+// admit拒绝的请求整个从缓冲区中取走，但不执行，流水线上的下一个请求照常解析
+TEST(Httprequest_Test, test_admit) {
+    HttpRequest request(std::make_shared<KvStore>());
+    ChainBuffer buff;
+    buff.Append("POST / HTTP/1.1\r\nContent-Length: 7\r\n\r\nset a 1"
+                "POST / HTTP/1.1\r\nContent-Length: 5\r\n\r\nget a");
+    std::vector<std::string> lines;
+    HttpRequest::Admission admit = [&lines](const HttpRequest &req) {
+        lines.push_back(req.RequestLine());
+        return lines.size() > 1;
+    };
+    request.Init();
+    EXPECT_EQ(request.parse(buff, admit), HttpRequest::REFUSED_REQUEST);
+    request.Init();
+    ASSERT_EQ(request.parse(buff, admit), HttpRequest::GET_REQUEST);
+    EXPECT_EQ(request.value, "None");
+    EXPECT_EQ(buff.ReadableBytes(), 0u);
+    ASSERT_EQ(lines.size(), 2u);
+    EXPECT_EQ(lines[0], "POST / HTTP/1.1");
+}
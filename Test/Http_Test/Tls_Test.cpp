@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "Http/tlscontext.hpp"
+
+#ifdef HTTP_HAVE_TLS
+
+#include <openssl/ssl.h>
+#include "../Common/testcert.hpp"
+
+// 整个测试套件共用一个证书，进程退出时删掉
+static TestCert cert;
+
+// 一对非阻塞的socket，服务端用TlsConn，客户端直接用OpenSSL
+class Tls_Test : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        ASSERT_TRUE(cert.Make());
+        std::string err;
+        ASSERT_TRUE(TlsContext::Instance()->Init(cert.CertFile(), cert.KeyFile(), true, 128, 300, &err))
+            << err;
+    }
+
+    void SetUp() override {
+        clientCtx_ = SSL_CTX_new(TLS_client_method());
+        ASSERT_NE(clientCtx_, nullptr);
+    }
+
+    void TearDown() override {
+        Close();
+        SSL_CTX_free(clientCtx_);
+    }
+
+    // 建立连接并完成握手，session不为空时客户端尝试复用
+    bool Connect(SSL_SESSION *session) {
+        Close();
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            return false;
+        }
+        serverFd_ = fds[0];
+        clientFd_ = fds[1];
+        fcntl(serverFd_, F_SETFL, O_NONBLOCK);
+        fcntl(clientFd_, F_SETFL, O_NONBLOCK);
+        server_.Start(TlsContext::Instance()->NewSsl(serverFd_));
+        client_ = SSL_new(clientCtx_);
+        SSL_set_fd(client_, clientFd_);
+        if (session) {
+            SSL_set_session(client_, session);
+        }
+        SSL_set_connect_state(client_);
+        // 两边轮流推进，直到都完成
+        bool serverDone = false, clientDone = false;
+        for (int i = 0; i < 100 && !(serverDone && clientDone); i++) {
+            if (!clientDone) {
+                int ret = SSL_do_handshake(client_);
+                if (ret == 1) {
+                    clientDone = true;
+                } else if (SSL_get_error(client_, ret) != SSL_ERROR_WANT_READ) {
+                    return false;
+                }
+            }
+            if (!serverDone) {
+                bool wantWrite = false;
+                int ret = server_.Handshake(&wantWrite);
+                if (ret < 0) {
+                    return false;
+                }
+                serverDone = (ret == 1);
+            }
+        }
+        return serverDone && clientDone;
+    }
+
+    void Close() {
+        server_.Reset();
+        if (client_) {
+            SSL_set_shutdown(client_, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+        }
+        SSL_free(client_);
+        client_ = nullptr;
+        if (serverFd_ >= 0) {
+            close(serverFd_);
+            close(clientFd_);
+        }
+        serverFd_ = clientFd_ = -1;
+    }
+
+    // 客户端读，没有数据时返回空
+    std::string ClientRead() {
+        char buf[256];
+        int ret = SSL_read(client_, buf, sizeof(buf));
+        return ret > 0 ? std::string(buf, ret) : std::string();
+    }
+
+    SSL_CTX *clientCtx_ = nullptr;
+    SSL *client_ = nullptr;
+    TlsConn server_;
+    int serverFd_ = -1;
+    int clientFd_ = -1;
+};
+
+// 握手之后两个方向的数据都能通过，没有数据时返回EAGAIN
+TEST_F(Tls_Test, test_exchange) {
+    ASSERT_TRUE(Connect(nullptr));
+    EXPECT_TRUE(server_.Active());
+    EXPECT_FALSE(server_.Handshaking());
+    // socketpair不支持kTLS，两个方向都退回SSL_read/SSL_write
+    EXPECT_FALSE(server_.KtlsSend());
+    EXPECT_FALSE(server_.KtlsRecv());
+
+    char buf[64];
+    EXPECT_EQ(server_.Read(buf, sizeof(buf)), -1);
+    EXPECT_EQ(errno, EAGAIN);
+
+    const char request[] = "GET / HTTP/1.1\r\n\r\n";
+    ASSERT_EQ(SSL_write(client_, request, sizeof(request) - 1), static_cast<int>(sizeof(request) - 1));
+    ssize_t len = server_.Read(buf, sizeof(buf));
+    ASSERT_EQ(len, static_cast<ssize_t>(sizeof(request) - 1));
+    EXPECT_EQ(std::string(buf, len), request);
+
+    char header[] = "HTTP/1.1 200 OK\r\n\r\n";
+    char body[] = "hello";
+    struct iovec iov[3] = {{header, sizeof(header) - 1}, {nullptr, 0}, {body, sizeof(body) - 1}};
+    EXPECT_EQ(server_.Writev(iov, 3), static_cast<ssize_t>(sizeof(header) + sizeof(body) - 2));
+    std::string got;
+    for (int i = 0; i < 10 && got.size() < sizeof(header) + sizeof(body) - 2; i++) {
+        got += ClientRead();
+    }
+    EXPECT_EQ(got, "HTTP/1.1 200 OK\r\n\r\nhello");
+
+    // 对方关闭之后读到0
+    SSL_shutdown(client_);
+    EXPECT_EQ(server_.Read(buf, sizeof(buf)), 0);
+}
+
+// 用上一次的会话重连，不需要完整握手
+TEST_F(Tls_Test, test_resumption) {
+    ASSERT_TRUE(Connect(nullptr));
+    char reply[] = "ok";
+    struct iovec iov = {reply, 2};
+    ASSERT_EQ(server_.Writev(&iov, 1), 2);
+    // TLS1.3的ticket在握手之后才发，客户端读一次才能拿到
+    EXPECT_EQ(ClientRead(), "ok");
+    EXPECT_FALSE(SSL_session_reused(client_));
+    SSL_SESSION *session = SSL_get1_session(client_);
+    ASSERT_NE(session, nullptr);
+    EXPECT_TRUE(SSL_SESSION_is_resumable(session));
+
+    ASSERT_TRUE(Connect(session));
+    EXPECT_TRUE(SSL_session_reused(client_));
+    SSL_SESSION_free(session);
+}
+
+// 证书不存在时失败，原来的配置不变
+TEST_F(Tls_Test, test_bad_cert) {
+    std::string err;
+    EXPECT_FALSE(TlsContext::Instance()->Init("/nonexistent.pem", cert.KeyFile(), true, 128, 300, &err));
+    EXPECT_FALSE(err.empty());
+    EXPECT_TRUE(TlsContext::Instance()->Enabled());
+    ASSERT_TRUE(Connect(nullptr));
+}
+
+#else // HTTP_HAVE_TLS
+
+// 没有OpenSSL时HTTPS打不开
+TEST(Tls_Test, test_disabled) {
+    std::string err;
+    EXPECT_FALSE(TlsContext::Instance()->Init("cert.pem", "key.pem", true, 128, 300, &err));
+    EXPECT_FALSE(TlsContext::Instance()->Enabled());
+    EXPECT_EQ(TlsContext::Instance()->NewSsl(0), nullptr);
+}
+
+#endif // HTTP_HAVE_TLS
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "glog/logging.h"
+#include "Log/lockfreequeue.hpp"
+
+TEST(LockFreeQueue_Test, test_spsc_wrap) {
+    SpscQueue<int> queue(3);
+    EXPECT_EQ(queue.Capacity(), 4u);
+    int v = 0;
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 4; i++) {
+            EXPECT_TRUE(queue.TryPush(round * 10 + i));
+        }
+        EXPECT_FALSE(queue.TryPush(100));
+        EXPECT_TRUE(queue.TryPop(v));
+        EXPECT_EQ(v, round * 10);
+        std::vector<int> out;
+        EXPECT_EQ(queue.PopBatch([&](int &x) { out.push_back(x); }, 8), 3u);
+        EXPECT_EQ(out, std::vector<int>({round * 10 + 1, round * 10 + 2, round * 10 + 3}));
+        EXPECT_TRUE(queue.Empty());
+    }
+}
+
+TEST(LockFreeQueue_Test, test_spsc_threads) {
+    SpscQueue<int> queue(64);
+    const int N = 200000;
+    std::thread producer([&] {
+        for (int i = 0; i < N; i++) {
+            while (!queue.TryPush(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    int expect = 0;
+    while (expect < N) {
+        queue.PopBatch([&](int &x) { EXPECT_EQ(x, expect++); }, 16);
+    }
+    producer.join();
+    EXPECT_TRUE(queue.Empty());
+}
+
+// 多个生产者，每个生产者自己的数据保持顺序，总数不丢不重
+TEST(LockFreeQueue_Test, test_mpsc_threads) {
+    MpscQueue<std::pair<int, int>> queue(128);
+    const int P = 4, N = 50000;
+    QueueNotifier notifier;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < P; p++) {
+        producers.emplace_back([&, p] {
+            for (int i = 0; i < N; i++) {
+                while (!queue.TryPush(std::make_pair(p, i))) {
+                    std::this_thread::yield();
+                }
+                notifier.Notify();
+            }
+        });
+    }
+    std::vector<int> next(P, 0);
+    int total = 0;
+    while (total < P * N) {
+        size_t n = queue.PopBatch(
+            [&](std::pair<int, int> &item) { EXPECT_EQ(item.second, next[item.first]++); }, 64);
+        total += n;
+        if (n == 0) {
+            notifier.Arm();
+            if (queue.Empty()) {
+                notifier.Wait(10);
+            }
+        }
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    EXPECT_TRUE(queue.Empty());
+}
+
+// 没有Arm时Notify不会写eventfd，Arm之后只有第一次Notify写
+TEST(LockFreeQueue_Test, test_notifier) {
+    QueueNotifier notifier;
+    notifier.Notify();
+    EXPECT_FALSE(notifier.Wait(0));
+    notifier.Arm();
+    notifier.Notify();
+    notifier.Notify();
+    EXPECT_TRUE(notifier.Wait(0));
+    EXPECT_FALSE(notifier.Wait(0));
+}
@@ -2,9 +2,275 @@
 #include "glog/logging.h"
 #include "Log/log.hpp"
 #include "Log/blockqueue.hpp"
+#include "Log/logarchiver.hpp"
+#include <dirent.h>
+#include <algorithm>
+#include <sstream>
+#include <thread>
 
 TEST(Log_Test, test_log) {
     
     Log::Instance()->init();
     LOG_INFO("hello world %d",520);
 }
+
+TEST(Log_Test, test_codec_format_args) {
+    char args[256];
+    const char *name = "127.0.0.1";
+    size_t len = LogCodec::Encode(args, sizeof(args), 7, name, 8080u, 2.5, std::string("ok"));
+    char out[256];
+    size_t n = LogCodec::FormatArgs(out, sizeof(out), "Client[%d](%s:%u) %.1f %5s %d%%", args, len);
+    EXPECT_EQ(std::string(out, n), "Client[7](127.0.0.1:8080) 2.5    ok <?>%");
+}
+
+TEST(Log_Test, test_codec_truncate) {
+    char args[8];
+    size_t len = LogCodec::Encode(args, sizeof(args), "a long string argument");
+    char out[64];
+    size_t n = LogCodec::FormatArgs(out, sizeof(out), "[%s]", args, len);
+    EXPECT_EQ(std::string(out, n), "[a lon]");
+}
+
+TEST(Log_Test, test_min_level_elision) {
+    Log::Instance()->init(0);
+    int evaluated = 0;
+    LOG_DEBUG("elided %d", ++evaluated);
+    LOG_ERROR("kept %d", ++evaluated);
+    EXPECT_EQ(evaluated, LOG_MIN_LEVEL > 0 ? 1 : 2);
+}
+
+TEST(Log_Test, test_cached_prefix) {
+    int64_t usec = static_cast<int64_t>(time(nullptr)) * 1000000;
+    char first[64], second[64];
+    LogCodec::FormatPrefix(first, sizeof(first), 1, usec + 42);
+    size_t n = LogCodec::FormatPrefix(second, sizeof(second), 3, usec + 999999);
+    // 同一秒内只有微秒和级别不同
+    EXPECT_EQ(strncmp(first, second, 20), 0);
+    EXPECT_EQ(std::string(first + 20), "000042 [info] : ");
+    EXPECT_EQ(std::string(second + 20, n - 20), "999999 [error]: ");
+}
+
+TEST(Log_Test, test_archiver_retention) {
+    std::string dir = "./archiver_test";
+    mkdir(dir.c_str(), 0777);
+    std::vector<std::string> files;
+    for (int i = 0; i < 5; i++) {
+        files.push_back(dir + "/seg-" + std::to_string(i) + ".log");
+        int fd = open(files.back().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(::write(fd, "line\n", 5), 5);
+        close(fd);
+        usleep(2000);
+    }
+    LogArchiver archiver;
+    archiver.Start(dir, ".log", 2, false);
+    // 最后一个是当前正在写的文件，不参与保留
+    archiver.Submit(files[3], files[4]);
+    archiver.Stop();
+    for (int i = 0; i < 5; i++) {
+        bool kept = access(files[i].c_str(), F_OK) == 0;
+        EXPECT_EQ(kept, i >= 2) << files[i];
+        unlink(files[i].c_str());
+    }
+    rmdir(dir.c_str());
+}
+
+TEST(Log_Test, test_ring_sink) {
+    RingSink sink(32);
+    sink.Write("0123456789\n", 11);
+    sink.Write("abcdefghij\n", 11);
+    sink.Write("ABCDEFGHIJ\n", 11);
+    // 超出容量时按整行丢弃最早的日志
+    EXPECT_EQ(sink.Snapshot(), "abcdefghij\nABCDEFGHIJ\n");
+}
+
+// 删除目录和其中的文件
+static void RemoveDir(const std::string &dir) {
+    DIR *dp = opendir(dir.c_str());
+    if (!dp) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != nullptr) {
+        if (entry->d_name[0] != '.') {
+            unlink((dir + "/" + entry->d_name).c_str());
+        }
+    }
+    closedir(dp);
+    rmdir(dir.c_str());
+}
+
+// 按文件名排好序的目录中的文件
+static std::vector<std::string> ListDir(const std::string &dir) {
+    std::vector<std::string> names;
+    DIR *dp = opendir(dir.c_str());
+    if (!dp) {
+        return names;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != nullptr) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(dir + "/" + entry->d_name);
+        }
+    }
+    closedir(dp);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static std::string ReadFile(const std::string &name) {
+    std::string content;
+    FILE *fp = fopen(name.c_str(), "rb");
+    if (!fp) {
+        return content;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        content.append(buf, n);
+    }
+    fclose(fp);
+    return content;
+}
+
+// 按文件名顺序读出目录中所有文件的内容
+static std::string ReadDir(const std::string &dir) {
+    std::string content;
+    for (auto &name : ListDir(dir)) {
+        content += ReadFile(name);
+    }
+    return content;
+}
+
+// 环形缓冲反复绕回，取出的顺序和写入一致；满了之后BeginPush返回空，取走一条又能写
+TEST(Log_Test, test_ring_wraparound) {
+    LogRing ring(4);
+    EXPECT_FALSE(ring.orphaned.load());
+    int next = 0, expect = 0;
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 3; i++) {
+            LogLine *line = ring.BeginPush();
+            ASSERT_NE(line, nullptr);
+            line->len = snprintf(line->data, LogLine::LINE_SIZE, "%d", next++);
+            ring.CommitPush();
+        }
+        for (int i = 0; i < 3; i++) {
+            LogLine *line = ring.Front();
+            ASSERT_NE(line, nullptr);
+            EXPECT_EQ(std::string(line->data, line->len), std::to_string(expect++));
+            ring.Pop();
+        }
+    }
+    EXPECT_EQ(ring.Front(), nullptr);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_NE(ring.BeginPush(), nullptr);
+        ring.CommitPush();
+    }
+    EXPECT_EQ(ring.BeginPush(), nullptr);
+    ring.Pop();
+    EXPECT_NE(ring.BeginPush(), nullptr);
+}
+
+// 每个线程的缓冲只有2条，写日志的线程要等后台线程腾出空间，日志不丢也不乱序；
+// 进程退出时后台线程把剩下的日志写完。Log是单例，在一个新的进程中（threadsafe方式重新执行）测试
+TEST(Log_Test, test_ring_full_and_shutdown_flush) {
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+    const std::string dir = "./log_ring_test";
+    const int threadCnt = 4, lineCnt = 2000;
+    RemoveDir(dir);
+    EXPECT_EXIT(
+        {
+            Log::Instance()->init(1, dir.c_str(), ".log", 2);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < threadCnt; t++) {
+                threads.emplace_back([t] {
+                    for (int i = 0; i < lineCnt; i++) {
+                        LOG_INFO("ring t%d seq%d", t, i);
+                    }
+                });
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            // 不等后台线程，由Log析构时写完
+            exit(0);
+        },
+        ::testing::ExitedWithCode(0), "");
+
+    std::vector<int> next(threadCnt, 0);
+    std::istringstream in(ReadDir(dir));
+    std::string line;
+    while (std::getline(in, line)) {
+        int t = -1, seq = -1;
+        size_t pos = line.find("ring t");
+        if (pos == std::string::npos || sscanf(line.c_str() + pos, "ring t%d seq%d", &t, &seq) != 2) {
+            continue;
+        }
+        ASSERT_TRUE(t >= 0 && t < threadCnt);
+        EXPECT_EQ(seq, next[t]) << "thread " << t;
+        next[t] = seq + 1;
+    }
+    for (int t = 0; t < threadCnt; t++) {
+        EXPECT_EQ(next[t], lineCnt) << "thread " << t;
+    }
+    RemoveDir(dir);
+}
+
+// 在一个新的进程中用mode写几条日志然后退出，返回写出的文本（二进制日志用LogCodec::Decode还原）
+static std::string LogInChild(LogMode mode, const std::string &dir) {
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+    RemoveDir(dir);
+    EXPECT_EXIT(
+        {
+            Log::Instance()->init(1, dir.c_str(), ".log", 64, mode);
+            LOG_INFO("Client[%d](%s:%u) in, %s", 7, "127.0.0.1", 8080u, std::string("ok"));
+            LOG_WARN("ratio %.2f done %d%%", 0.5, 42);
+            LOG_DEBUG("below level %d", 1);
+            exit(0);
+        },
+        ::testing::ExitedWithCode(0), "");
+    if (mode != LogMode::BINARY) {
+        std::string text = ReadDir(dir);
+        RemoveDir(dir);
+        return text;
+    }
+    std::string text;
+    for (auto &name : ListDir(dir)) {
+        std::string raw = ReadFile(name);
+        EXPECT_EQ(raw.compare(0, sizeof(LogCodec::MAGIC), LogCodec::MAGIC, sizeof(LogCodec::MAGIC)), 0);
+        EXPECT_EQ(raw.find("127.0.0.1:8080"), std::string::npos);
+        FILE *in = fopen(name.c_str(), "rb");
+        if (!in) {
+            ADD_FAILURE() << "open " << name;
+            continue;
+        }
+        char *buf = nullptr;
+        size_t len = 0;
+        FILE *out = open_memstream(&buf, &len);
+        std::string err;
+        EXPECT_TRUE(LogCodec::Decode(in, out, &err)) << err;
+        EXPECT_TRUE(err.empty()) << err;
+        fclose(out);
+        fclose(in);
+        text.append(buf, len);
+        free(buf);
+    }
+    RemoveDir(dir);
+    return text;
+}
+
+// 延迟格式化模式：后台线程还原出的文本和直接格式化一致
+TEST(Log_Test, test_deferred_end_to_end) {
+    std::string text = LogInChild(LogMode::DEFERRED, "./log_deferred_test");
+    EXPECT_NE(text.find("[info] : Client[7](127.0.0.1:8080) in, ok\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("[warn] : ratio 0.50 done 42%\n"), std::string::npos) << text;
+    EXPECT_EQ(text.find("below level"), std::string::npos);
+}
+
+// 二进制模式：文件中没有格式化的文本，解码之后和直接格式化一致
+TEST(Log_Test, test_binary_end_to_end) {
+    std::string text = LogInChild(LogMode::BINARY, "./log_binary_test");
+    EXPECT_NE(text.find("[info] : Client[7](127.0.0.1:8080) in, ok\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("[warn] : ratio 0.50 done 42%\n"), std::string::npos) << text;
+    EXPECT_EQ(text.find("below level"), std::string::npos);
+}
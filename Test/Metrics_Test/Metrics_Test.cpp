@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "Metrics/metrics.hpp"
+
+// 多个线程同时加，合并之后不能丢
+TEST(Metrics_Test, test_counter) {
+    Counter counter("test_counter_total", "test");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&counter] {
+            for (int i = 0; i < 100000; i++) {
+                counter.Add();
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(counter.Value(), 800000u);
+}
+
+TEST(Metrics_Test, test_histogram) {
+    Histogram hist("test_seconds", "test");
+    for (uint64_t i = 1; i <= 1000; i++) {
+        hist.Record(i * 1000); // 1us到1ms
+    }
+    Histogram::Snapshot snap = hist.Snap();
+    EXPECT_EQ(snap.count, 1000u);
+    EXPECT_EQ(snap.max, 1000000u);
+    EXPECT_EQ(snap.sum, 500500000u);
+    // 分桶的相对误差在6%以内
+    EXPECT_NEAR(static_cast<double>(snap.Percentile(0.5)), 500000.0, 500000.0 * 0.07);
+    EXPECT_NEAR(static_cast<double>(snap.Percentile(0.99)), 990000.0, 990000.0 * 0.07);
+    EXPECT_EQ(snap.Percentile(1.0), 1000000u);
+    EXPECT_NEAR(static_cast<double>(snap.CountBelow(100000)), 100.0, 7.0);
+    // 很大的值记在最后一个桶
+    hist.Record(UINT64_MAX / 2);
+    EXPECT_EQ(hist.Snap().buckets.back(), 1u);
+}
+
+TEST(Metrics_Test, test_counter_vec) {
+    IntCounterVec vec("test_codes_total", "test", "code");
+    vec.With(200).Add(3);
+    vec.With(404).Add();
+    vec.With(200).Add();
+    EXPECT_EQ(vec.With(200).Value(), 4u);
+    EXPECT_EQ(vec.With(404).Value(), 1u);
+    EXPECT_EQ(&vec.With(200), &vec.With(200));
+    // 超过表的容量之后都记在other中
+    for (int i = 0; i < 100; i++) {
+        vec.With(1000 + i).Add();
+    }
+    EXPECT_EQ(vec.With(200).Value(), 4u);
+    EXPECT_EQ(vec.With(5000).Value(), 100u - 62u);
+}
+
+// 同名的指标只输出一次HELP和TYPE，析构之后不再输出
+TEST(Metrics_Test, test_render) {
+    std::string text;
+    {
+        Counter a("test_render_total", "render test", "verb=\"get\"");
+        Counter b("test_render_total", "render test", "verb=\"set\"");
+        Gauge gauge("test_render_gauge", "gauge test");
+        CallbackGauge callback("test_render_callback", "callback test", [] { return 2.5; });
+        Histogram hist("test_render_seconds", "histogram test");
+        a.Add(2);
+        gauge.Set(-3);
+        hist.Record(1500000); // 1.5ms
+        text = MetricsRegistry::Instance()->Render();
+    }
+    EXPECT_NE(text.find("# HELP test_render_total render test\n"
+                        "# TYPE test_render_total counter\n"
+                        "test_render_total{verb=\"get\"} 2\n"
+                        "test_render_total{verb=\"set\"} 0\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("test_render_gauge -3\n"), std::string::npos);
+    EXPECT_NE(text.find("test_render_callback 2.5\n"), std::string::npos);
+    EXPECT_NE(text.find("# TYPE test_render_seconds histogram\n"), std::string::npos);
+    EXPECT_NE(text.find("test_render_seconds_bucket{le=\"0.001\"} 0\n"), std::string::npos);
+    EXPECT_NE(text.find("test_render_seconds_bucket{le=\"0.002\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("test_render_seconds_bucket{le=\"+Inf\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("test_render_seconds_count 1\n"), std::string::npos);
+    EXPECT_EQ(MetricsRegistry::Instance()->Render().find("test_render"), std::string::npos);
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "Metrics/slowlog.hpp"
+#include "Metrics/hotkeys.hpp"
+
+static RequestTrace MakeTrace(int64_t dispatch, int64_t dequeue, int64_t parse, int64_t handler,
+                              int64_t last) {
+    RequestTrace trace;
+    trace.Mark(RequestTrace::WAKE, dispatch);
+    trace.Mark(RequestTrace::DISPATCH, dispatch);
+    trace.Mark(RequestTrace::DEQUEUE, dequeue);
+    trace.Mark(RequestTrace::PARSE, parse);
+    trace.Mark(RequestTrace::HANDLER, handler);
+    trace.Mark(RequestTrace::FIRST_BYTE, last);
+    trace.Mark(RequestTrace::LAST_BYTE, last);
+    return trace;
+}
+
+// 只保留最慢的N个，从慢到快输出，各阶段的耗时分开记录
+TEST(Sampler_Test, test_slowlog) {
+    SlowLog slowLog(3);
+    for (int i = 1; i <= 10; i++) {
+        int64_t base = i * 1000000;
+        RequestTrace trace = MakeTrace(base, base + i * 100, base + i * 200, base + i * 300, base + i * 1000);
+        if (slowLog.IsSlow(trace.Since(RequestTrace::LAST_BYTE))) {
+            slowLog.Add(trace, i, "GET", "/" + std::to_string(i));
+        }
+    }
+    std::vector<SlowLog::Entry> entries = slowLog.Entries();
+    ASSERT_EQ(entries.size(), 3u);
+    EXPECT_EQ(entries[0].path, "/10");
+    EXPECT_EQ(entries[2].path, "/8");
+    EXPECT_EQ(entries[0].totalNs, 10000);
+    EXPECT_EQ(entries[0].queueNs, 1000);
+    EXPECT_EQ(entries[0].parseNs, 1000);
+    EXPECT_EQ(entries[0].handlerNs, 1000);
+    EXPECT_EQ(entries[0].writeNs, 7000);
+    // 比第3慢的还快，不会进来
+    EXPECT_FALSE(slowLog.IsSlow(8000));
+    EXPECT_TRUE(slowLog.IsSlow(8001));
+    EXPECT_NE(slowLog.Render().find("10.0 1.0 1.0 1.0 7.0 10 "), std::string::npos);
+    slowLog.Clear();
+    EXPECT_TRUE(slowLog.Entries().empty());
+    EXPECT_TRUE(slowLog.IsSlow(1));
+}
+
+// 估计值不会偏小，热点key能从大量冷key中找出来
+TEST(Sampler_Test, test_hotkeys) {
+    HotKeys hot(4, 1024, 1);
+    for (int i = 0; i < 5000; i++) {
+        hot.Add("cold" + std::to_string(i));
+        if (i % 5 == 0) {
+            hot.Add("hot1");
+        }
+        if (i % 10 == 0) {
+            hot.Add("hot2");
+        }
+    }
+    EXPECT_GE(hot.Estimate("hot1"), 1000u);
+    EXPECT_GE(hot.Estimate("hot2"), 500u);
+    EXPECT_GE(hot.Estimate("cold7"), 1u);
+    std::vector<HotKeys::Item> top = hot.Top();
+    ASSERT_GE(top.size(), 2u);
+    EXPECT_EQ(top[0].key, "hot1");
+    EXPECT_EQ(top[1].key, "hot2");
+    hot.Clear();
+    EXPECT_TRUE(hot.Top().empty());
+    EXPECT_EQ(hot.Estimate("hot1"), 0u);
+}
+
+// 多个线程同时记录，采样之后热点key仍然排在前面
+TEST(Sampler_Test, test_hotkeys_sampled) {
+    HotKeys hot(8, 4096, 8);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&hot, t] {
+            for (int i = 0; i < 20000; i++) {
+                hot.Record(i % 3 == 0 ? "hot" : "key" + std::to_string(t * 100000 + i));
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    std::vector<HotKeys::Item> top = hot.Top();
+    ASSERT_FALSE(top.empty());
+    EXPECT_EQ(top[0].key, "hot");
+    // 4个线程一共80000次，三分之一是hot，每8次采样一次
+    EXPECT_NEAR(static_cast<double>(top[0].count), 80000.0 / 3 / 8, 80000.0 / 3 / 8 * 0.2);
+}
+
+// 每个线程的采样种子不同：几个线程记录同样的key序列，不会每次都采到同一批key
+TEST(Sampler_Test, test_hotkeys_seed_per_thread) {
+    HotKeys hot(8, 4096, 8);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&hot] {
+            for (int i = 0; i < 1000; i++) {
+                hot.Record("k" + std::to_string(i));
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    // 种子相同的话大约125个key会被4个线程都采到
+    int sampledByAll = 0;
+    for (int i = 0; i < 1000; i++) {
+        if (hot.Estimate("k" + std::to_string(i)) >= 4) {
+            sampledByAll++;
+        }
+    }
+    EXPECT_LT(sampledByAll, 10);
+}
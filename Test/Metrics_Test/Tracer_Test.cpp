@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "Metrics/tracer.hpp"
+
+static size_t Count(const std::string &text, const std::string &word) {
+    size_t n = 0;
+    for (size_t pos = text.find(word); pos != std::string::npos; pos = text.find(word, pos + 1)) {
+        n++;
+    }
+    return n;
+}
+
+// 关闭时照样打点，但是不会写出span
+TEST(Tracer_Test, test_disabled) {
+    Tracer::Instance()->SetEnabled(false);
+    Tracer::Instance()->Clear();
+    RequestTrace trace;
+    trace.Mark(RequestTrace::WAKE);
+    trace.Mark(RequestTrace::LAST_BYTE);
+    EXPECT_TRUE(trace.Marked(RequestTrace::WAKE));
+    trace.Finish(5);
+    EXPECT_FALSE(trace.Marked(RequestTrace::WAKE));
+    EXPECT_EQ(Count(Tracer::Instance()->DumpJson(), "\"ph\""), 0u);
+}
+
+// 每个请求一个request span，相邻两个打过点的阶段之间一个子span，没打点的阶段跳过
+TEST(Tracer_Test, test_request_spans) {
+    Tracer::Instance()->Clear();
+    Tracer::Instance()->SetEnabled(true);
+    RequestTrace trace;
+    trace.Mark(RequestTrace::ACCEPT, 1000);
+    trace.Mark(RequestTrace::WAKE, 2000);
+    trace.Mark(RequestTrace::DISPATCH, 3000);
+    trace.Mark(RequestTrace::DEQUEUE, 7000);
+    trace.Mark(RequestTrace::PARSE, 8000);
+    trace.Mark(RequestTrace::HANDLER, 9000);
+    trace.Mark(RequestTrace::LAST_BYTE, 12000);
+    EXPECT_EQ(trace.Since(RequestTrace::LAST_BYTE), 10000);
+    EXPECT_EQ(trace.Gap(RequestTrace::DEQUEUE), 4000);
+    EXPECT_EQ(trace.Gap(RequestTrace::LAST_BYTE), 3000);
+    EXPECT_EQ(trace.Gap(RequestTrace::FIRST_BYTE), 0);
+    trace.Finish(7);
+    std::string json = Tracer::Instance()->DumpJson();
+    EXPECT_EQ(Count(json, "\"ph\":\"X\""), 7u);
+    EXPECT_NE(json.find("\"name\":\"request\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":2.000,\"dur\":10.000"),
+              std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"idle\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":1.000,\"dur\":1.000"),
+              std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"queue\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":3.000,\"dur\":4.000"),
+              std::string::npos);
+    // 没有FIRST_BYTE，write从HANDLER开始算
+    EXPECT_NE(json.find("\"name\":\"write\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":9.000,\"dur\":3.000"),
+              std::string::npos);
+    EXPECT_EQ(json.find("respond"), std::string::npos);
+    EXPECT_NE(json.find("\"tid\":7"), std::string::npos);
+    // Finish之后清空，ACCEPT只属于第一个请求
+    EXPECT_FALSE(trace.Marked(RequestTrace::ACCEPT));
+    Tracer::Instance()->SetEnabled(false);
+}
+
+// 每个线程有自己的ring，写满之后只保留最近的
+TEST(Tracer_Test, test_ring) {
+    Tracer::Instance()->Clear();
+    Tracer::Instance()->SetRingCapacity(4);
+    std::thread worker([] {
+        for (int i = 1; i <= 10; i++) {
+            Tracer::Instance()->Record({"span", i * 1000, 1000, static_cast<uint64_t>(i), 1});
+        }
+    });
+    worker.join();
+    std::string json = Tracer::Instance()->DumpJson();
+    EXPECT_EQ(Count(json, "\"name\":\"span\""), 4u);
+    EXPECT_EQ(json.find("\"req\":6,"), std::string::npos);
+    EXPECT_NE(json.find("\"req\":7,"), std::string::npos);
+    EXPECT_NE(json.find("\"req\":10,"), std::string::npos);
+    Tracer::Instance()->SetRingCapacity(8192);
+}
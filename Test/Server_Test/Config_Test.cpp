@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "Server/config.hpp"
+
+// 节、注释、引号、重复的key
+TEST(Config_Test, test_parse) {
+    Config config;
+    std::string err;
+    ASSERT_TRUE(config.LoadString("top = 1\n"
+                                  "[server]\n"
+                                  "  port = 8080   # 注释\n"
+                                  "; 整行注释\n"
+                                  "\n"
+                                  "[limits]\n"
+                                  "rule = 1 2 \"POST / \"\n"
+                                  "rule = 3 4 GET /a#b\n",
+                                  "test", &err))
+        << err;
+    int port = 0;
+    EXPECT_TRUE(config.Get("server.port", &port));
+    EXPECT_EQ(port, 8080);
+    EXPECT_TRUE(config.Has("top"));
+    std::vector<std::string> rules = config.GetAll("limits.rule");
+    ASSERT_EQ(rules.size(), 2u);
+    EXPECT_EQ(rules[0], "1 2 \"POST / \"");
+    EXPECT_EQ(rules[1], "3 4 GET /a");
+    // 不存在时不修改，格式不对时返回false
+    int missing = 7;
+    EXPECT_TRUE(config.Get("server.missing", &missing));
+    EXPECT_EQ(missing, 7);
+    EXPECT_FALSE(config.LoadString("[server]\nport\n", "bad", &err));
+    EXPECT_EQ(err, "bad:2: expected key = value");
+}
+
+// 命令行覆盖配置文件，参数检查范围
+TEST(Config_Test, test_options) {
+    const char *argv[] = {"myServer", "--server.threads=3", "--limits.rate=50.5"};
+    Config config;
+    std::string err;
+    ASSERT_TRUE(config.ParseArgs(3, const_cast<char **>(argv), &err)) << err;
+    ASSERT_TRUE(config.Load(&err)) << err;
+    ServerOptions options;
+    ASSERT_TRUE(ServerOptions::FromConfig(config, &options, &err)) << err;
+    EXPECT_EQ(options.threadNum, 3);
+    EXPECT_DOUBLE_EQ(options.rate, 50.5);
+    EXPECT_EQ(options.port, 1316);
+
+    config.Set("limits.rule", "10 20 \"POST / \"");
+    config.Set("log.enable", "off");
+    ASSERT_TRUE(ServerOptions::FromConfig(config, &options, &err)) << err;
+    ASSERT_EQ(options.rateRules.size(), 1u);
+    EXPECT_EQ(options.rateRules[0].prefix, "POST / ");
+    EXPECT_DOUBLE_EQ(options.rateRules[0].burst, 20);
+    EXPECT_FALSE(options.openLog);
+
+    config.Set("server.threads", "0");
+    EXPECT_FALSE(ServerOptions::FromConfig(config, &options, &err));
+    EXPECT_EQ(err, "server.threads: out of range");
+    EXPECT_EQ(options.threadNum, 3);
+    config.Set("server.threads", "abc");
+    EXPECT_FALSE(ServerOptions::FromConfig(config, &options, &err));
+    EXPECT_EQ(err, "server.threads: bad value");
+    config.Set("server.threads", "3");
+    config.Set("tls.port", "1443");
+    EXPECT_FALSE(ServerOptions::FromConfig(config, &options, &err));
+    EXPECT_EQ(err, "tls.cert: cert and key are required when port is set");
+    config.Set("tls.cert", "cert.pem");
+    config.Set("tls.key", "key.pem");
+    ASSERT_TRUE(ServerOptions::FromConfig(config, &options, &err)) << err;
+    EXPECT_EQ(options.tlsPort, 1443);
+    EXPECT_TRUE(options.tlsKtls);
+    // 0表示不开HTTPS，其他的和server.port一样不能低于1024
+    config.Set("tls.port", "443");
+    EXPECT_FALSE(ServerOptions::FromConfig(config, &options, &err));
+    EXPECT_EQ(err, "tls.port: out of range");
+    config.Set("tls.port", "0");
+    ASSERT_TRUE(ServerOptions::FromConfig(config, &options, &err)) << err;
+    EXPECT_EQ(options.tlsPort, 0);
+
+    const char *bad[] = {"myServer", "extra"};
+    Config other;
+    EXPECT_FALSE(other.ParseArgs(2, const_cast<char **>(bad), &err));
+}
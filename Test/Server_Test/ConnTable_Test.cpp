@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include "glog/logging.h"
+#include "Server/conntable.hpp"
+
+// 关闭之后旧的代数失效，fd复用之后拿到的是新的代数
+TEST(ConnTable_Test, test_generation) {
+    ConnTable table(64, std::make_shared<KvStore>());
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    sockaddr_in addr = {0};
+
+    uint32_t gen = 0;
+    HttpConn *conn = table.Open(fds[0], addr, &gen);
+    ASSERT_NE(conn, nullptr);
+    EXPECT_EQ(table.Get(fds[0], gen), conn);
+
+    EXPECT_TRUE(table.Retire(fds[0], gen));
+    EXPECT_FALSE(table.Retire(fds[0], gen));
+    EXPECT_EQ(table.Get(fds[0], gen), nullptr);
+    conn->Close();
+    close(fds[1]);
+
+    ASSERT_EQ(pipe(fds), 0);
+    uint32_t newGen = 0;
+    HttpConn *reused = table.Open(fds[0], addr, &newGen);
+    EXPECT_NE(newGen, gen);
+    EXPECT_EQ(table.Get(fds[0], newGen), reused);
+    EXPECT_EQ(table.Get(fds[0], gen), nullptr);
+    close(fds[1]);
+}
+
+// 分发出去的连接要关闭时只记下来，交还时才告诉调用者要关闭；重新打开时清掉标记
+TEST(ConnTable_Test, test_dispatch) {
+    ConnTable table(64, std::make_shared<KvStore>());
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    sockaddr_in addr = {0};
+
+    uint32_t gen = 0;
+    HttpConn *conn = table.Open(fds[0], addr, &gen);
+    EXPECT_FALSE(table.Dispatched(fds[0]));
+    table.Dispatch(fds[0]);
+    EXPECT_TRUE(table.Dispatched(fds[0]));
+    EXPECT_FALSE(table.HandBack(fds[0]));
+    EXPECT_FALSE(table.Dispatched(fds[0]));
+
+    table.Dispatch(fds[0]);
+    table.DeferClose(fds[0]);
+    EXPECT_TRUE(table.HandBack(fds[0]));
+    EXPECT_FALSE(table.HandBack(fds[0]));
+
+    table.Dispatch(fds[0]);
+    table.DeferClose(fds[0]);
+    EXPECT_TRUE(table.Retire(fds[0], gen));
+    conn->Close();
+    close(fds[1]);
+    ASSERT_EQ(pipe(fds), 0);
+    table.Open(fds[0], addr, &gen);
+    EXPECT_FALSE(table.Dispatched(fds[0]));
+    EXPECT_FALSE(table.HandBack(fds[0]));
+    close(fds[1]);
+}
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include "glog/logging.h"
+#include "Server/epoller.hpp"
+
+// EPOLLONESHOT的fd触发一次之后不会再触发，工作线程通过PostModFd重新激活，由主循环批量处理
+TEST(Epoller_Test, test_post_mod) {
+    Epoller epoller;
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    ASSERT_TRUE(epoller.AddFd(fds[0], EPOLLIN | EPOLLONESHOT));
+    ASSERT_EQ(write(fds[1], "a", 1), 1);
+
+    ASSERT_EQ(epoller.Wait(100), 1);
+    EXPECT_EQ(epoller.GetEventFd(0), fds[0]);
+    EXPECT_EQ(epoller.Wait(0), 0);
+
+    // 两次提交只唤醒一次
+    epoller.PostModFd(fds[0], EPOLLIN | EPOLLONESHOT);
+    epoller.PostModFd(fds[0], EPOLLIN | EPOLLONESHOT);
+    ASSERT_EQ(epoller.Wait(100), 1);
+    EXPECT_EQ(epoller.GetEventFd(0), epoller.GetWakeFd());
+    epoller.ApplyPending();
+
+    ASSERT_EQ(epoller.Wait(100), 1);
+    EXPECT_EQ(epoller.GetEventFd(0), fds[0]);
+    EXPECT_TRUE(epoller.DelFd(fds[0]));
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 连接关闭之后才处理到的修改（代数对不上）被丢掉，不会重新激活复用了这个fd的连接
+TEST(Epoller_Test, test_stale_mod) {
+    Epoller epoller;
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    ASSERT_TRUE(epoller.AddFd(fds[0], EPOLLIN | EPOLLONESHOT));
+    ASSERT_EQ(write(fds[1], "a", 1), 1);
+    ASSERT_EQ(epoller.Wait(100), 1);
+
+    uint32_t current = 4;
+    epoller.PostModFd(fds[0], EPOLLIN | EPOLLONESHOT, 3);
+    ASSERT_EQ(epoller.Wait(100), 1);
+    epoller.ApplyPending([&](int, uint32_t gen) { return gen == current; });
+    EXPECT_EQ(epoller.Wait(50), 0);
+
+    epoller.PostModFd(fds[0], EPOLLIN | EPOLLONESHOT, 4);
+    ASSERT_EQ(epoller.Wait(100), 1);
+    epoller.ApplyPending([&](int, uint32_t gen) { return gen == current; });
+    ASSERT_EQ(epoller.Wait(100), 1);
+    EXPECT_EQ(epoller.GetEventFd(0), fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+}
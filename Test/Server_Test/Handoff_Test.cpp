@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "Server/handoff.hpp"
+
+// 通过unix socket传过去的fd和原来的是同一个文件
+TEST(Handoff_Test, test_send_fd) {
+    std::string path = "./handoff_test.sock";
+    int listenFd = handoff::Listen(path);
+    ASSERT_GE(listenFd, 0);
+    int client = handoff::Connect(path);
+    ASSERT_GE(client, 0);
+    int server = accept(listenFd, nullptr, nullptr);
+    ASSERT_GE(server, 0);
+
+    int pipeFd[2];
+    ASSERT_EQ(pipe(pipeFd), 0);
+    EXPECT_TRUE(handoff::SendFds(server, pipeFd, 2));
+    int received[2] = {-1, -1};
+    ASSERT_EQ(handoff::RecvFds(client, received, 2, 1000), 2);
+    EXPECT_NE(received[1], pipeFd[1]);
+    close(pipeFd[0]);
+    close(pipeFd[1]);
+    ASSERT_EQ(write(received[1], "x", 1), 1);
+    char c = 0;
+    ASSERT_EQ(read(received[0], &c, 1), 1);
+    EXPECT_EQ(c, 'x');
+
+    // 只要一个时多出来的被关掉
+    EXPECT_TRUE(handoff::SendFds(server, received, 2));
+    int one = -1;
+    ASSERT_EQ(handoff::RecvFds(client, &one, 1, 1000), 1);
+    EXPECT_GE(one, 0);
+    close(one);
+
+    // 没有fd可以收时超时返回-1
+    EXPECT_EQ(handoff::RecvFds(client, &one, 1, 10), -1);
+    close(received[0]);
+    close(received[1]);
+    close(client);
+    close(server);
+    close(listenFd);
+    unlink(path.c_str());
+    // 没有进程在监听时连接失败
+    EXPECT_EQ(handoff::Connect(path), -1);
+}
+
+// socket文件只有自己的用户可以连接，同一个用户的连接SameUser为true
+TEST(Handoff_Test, test_same_user) {
+    std::string path = "./handoff_user.sock";
+    int listenFd = handoff::Listen(path);
+    ASSERT_GE(listenFd, 0);
+    struct stat st;
+    ASSERT_EQ(stat(path.c_str(), &st), 0);
+    EXPECT_EQ(st.st_mode & 0777, 0600u);
+    int client = handoff::Connect(path);
+    ASSERT_GE(client, 0);
+    int server = accept(listenFd, nullptr, nullptr);
+    ASSERT_GE(server, 0);
+    EXPECT_TRUE(handoff::SameUser(server));
+    close(client);
+    close(server);
+
+    // 需要root才能换成别的用户来连接
+    if (geteuid() != 0) {
+        close(listenFd);
+        unlink(path.c_str());
+        GTEST_SKIP();
+    }
+    // 放开文件权限，只看SO_PEERCRED的检查
+    ASSERT_EQ(chmod(path.c_str(), 0666), 0);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (setuid(65534) != 0) {
+            _exit(2);
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path.c_str());
+        _exit(connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0 ? 0 : 1);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+    server = accept(listenFd, nullptr, nullptr);
+    ASSERT_GE(server, 0);
+    EXPECT_FALSE(handoff::SameUser(server));
+    close(server);
+    close(listenFd);
+    unlink(path.c_str());
+}
@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include "Server/iplimiter.hpp"
+
+// 每个IP单独计数，超过上限之后拒绝，释放之后可以再次打开
+TEST(IpLimiter_Test, test_limit) {
+    IpLimiter limiter(3);
+    uint32_t a = inet_addr("10.0.0.1");
+    uint32_t b = inet_addr("10.0.0.2");
+    for (int i = 0; i < 3; i++) {
+        EXPECT_TRUE(limiter.TryAcquire(a));
+    }
+    EXPECT_FALSE(limiter.TryAcquire(a));
+    EXPECT_EQ(limiter.Count(a), 3);
+    EXPECT_TRUE(limiter.TryAcquire(b));
+    limiter.Release(a);
+    EXPECT_TRUE(limiter.TryAcquire(a));
+    EXPECT_FALSE(limiter.TryAcquire(a));
+}
+
+// 上限为0时不限制，计数照常，之后再设置上限也不会出错
+TEST(IpLimiter_Test, test_unlimited) {
+    IpLimiter limiter(0);
+    uint32_t a = inet_addr("192.168.1.1");
+    for (int i = 0; i < 100; i++) {
+        EXPECT_TRUE(limiter.TryAcquire(a));
+    }
+    limiter.SetLimit(50);
+    EXPECT_FALSE(limiter.TryAcquire(a));
+    for (int i = 0; i < 60; i++) {
+        limiter.Release(a);
+    }
+    EXPECT_TRUE(limiter.TryAcquire(a));
+    EXPECT_EQ(limiter.Count(a), 41);
+}
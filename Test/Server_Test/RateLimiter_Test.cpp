@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <thread>
+#include "Server/ratelimiter.hpp"
+
+static const int64_t SEC = 1000000000;
+
+// 先用完突发的令牌，之后按速率补充，不同IP互不影响
+TEST(RateLimiter_Test, test_ip_rate) {
+    RateLimiter limiter(1024);
+    EXPECT_FALSE(limiter.Enabled());
+    EXPECT_TRUE(limiter.Allow(inet_addr("10.0.0.1"), RateLimiter::IP_RULE, SEC));
+    limiter.SetIpRate(10, 5);
+    EXPECT_TRUE(limiter.Enabled());
+    uint32_t a = inet_addr("10.0.0.2");
+    uint32_t b = inet_addr("10.0.0.3");
+    for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE(limiter.Allow(a, RateLimiter::IP_RULE, SEC));
+    }
+    EXPECT_FALSE(limiter.Allow(a, RateLimiter::IP_RULE, SEC));
+    EXPECT_TRUE(limiter.Allow(b, RateLimiter::IP_RULE, SEC));
+    // 100ms补充一个
+    EXPECT_TRUE(limiter.Allow(a, RateLimiter::IP_RULE, SEC + SEC / 10));
+    EXPECT_FALSE(limiter.Allow(a, RateLimiter::IP_RULE, SEC + SEC / 10));
+    // 很久之后最多补满到突发上限
+    for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE(limiter.Allow(a, RateLimiter::IP_RULE, 100 * SEC));
+    }
+    EXPECT_FALSE(limiter.Allow(a, RateLimiter::IP_RULE, 100 * SEC));
+}
+
+// 最长前缀匹配，同一个IP在不同规则下各有一个桶
+TEST(RateLimiter_Test, test_request_rules) {
+    RateLimiter limiter(1024);
+    int kv = limiter.AddRule("POST / ", 1, 2);
+    int login = limiter.AddRule("POST /", 0, 0);
+    EXPECT_TRUE(limiter.HasRequestRules());
+    const char *set = "POST / HTTP/1.1\r\n";
+    const char *page = "POST /login HTTP/1.1\r\n";
+    const char *get = "GET / HTTP/1.1\r\n";
+    EXPECT_EQ(limiter.Match(set, strlen(set)), kv);
+    EXPECT_EQ(limiter.Match(page, strlen(page)), login);
+    EXPECT_EQ(limiter.Match(get, strlen(get)), -1);
+    uint32_t a = inet_addr("10.0.0.1");
+    EXPECT_TRUE(limiter.Allow(a, kv, SEC));
+    EXPECT_TRUE(limiter.Allow(a, kv, SEC));
+    EXPECT_FALSE(limiter.Allow(a, kv, SEC));
+    // 速率为0的规则不限制，IP总速率也没有设置
+    EXPECT_TRUE(limiter.Allow(a, login, SEC));
+    EXPECT_TRUE(limiter.Allow(a, RateLimiter::IP_RULE, SEC));
+    // 再加同样的前缀只更新速率
+    EXPECT_EQ(limiter.AddRule("POST / ", 100, 100), kv);
+    limiter.ClearRules();
+    EXPECT_FALSE(limiter.HasRequestRules());
+    EXPECT_EQ(limiter.Match(set, strlen(set)), -1);
+}
+
+// 表的大小固定，大量不同的IP只会替换最久没有访问的桶，最近活跃的IP仍然受限
+TEST(RateLimiter_Test, test_eviction) {
+    RateLimiter limiter(256);
+    EXPECT_EQ(limiter.Capacity(), 256u);
+    limiter.SetIpRate(1, 1);
+    uint32_t hot = inet_addr("10.0.0.1");
+    EXPECT_TRUE(limiter.Allow(hot, RateLimiter::IP_RULE, SEC));
+    for (uint32_t i = 0; i < 100000; i++) {
+        int64_t now = SEC + i;
+        EXPECT_TRUE(limiter.Allow(htonl(0x0b000000 + i), RateLimiter::IP_RULE, now));
+        // 一直在访问的IP不会被替换掉，令牌一直是空的
+        if (i % 64 == 0) {
+            ASSERT_FALSE(limiter.Allow(hot, RateLimiter::IP_RULE, now)) << i;
+        }
+    }
+    EXPECT_GT(limiter.Evictions(), 90000u);
+}
+
+// Check只看有没有令牌，不取走，也不为没见过的IP占用桶
+TEST(RateLimiter_Test, test_check) {
+    RateLimiter limiter(1024);
+    limiter.SetIpRate(1, 2);
+    uint32_t a = inet_addr("10.0.0.1");
+    for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE(limiter.Check(a, RateLimiter::IP_RULE, SEC));
+    }
+    EXPECT_TRUE(limiter.Allow(a, RateLimiter::IP_RULE, SEC));
+    EXPECT_TRUE(limiter.Check(a, RateLimiter::IP_RULE, SEC));
+    EXPECT_TRUE(limiter.Allow(a, RateLimiter::IP_RULE, SEC));
+    EXPECT_FALSE(limiter.Check(a, RateLimiter::IP_RULE, SEC));
+    EXPECT_FALSE(limiter.Allow(a, RateLimiter::IP_RULE, SEC));
+    // 时间倒退（另一个线程拿到的时间稍早）不会补充令牌
+    EXPECT_FALSE(limiter.Check(a, RateLimiter::IP_RULE, SEC / 2));
+    EXPECT_TRUE(limiter.Check(a, RateLimiter::IP_RULE, 2 * SEC));
+}
+
+// 检查和修改规则可以在不同的线程中同时进行
+TEST(RateLimiter_Test, test_update_while_checking) {
+    RateLimiter limiter(1024);
+    limiter.SetIpRate(1e6, 1e6);
+    std::atomic<bool> stop(false);
+    std::thread checker([&limiter, &stop] {
+        const char *set = "POST / HTTP/1.1";
+        while (!stop.load()) {
+            int rule = limiter.Match(set, strlen(set));
+            limiter.Allow(inet_addr("10.0.0.1"), rule < 0 ? RateLimiter::IP_RULE : rule, SEC);
+        }
+    });
+    for (int i = 0; i < 1000; i++) {
+        limiter.ClearRules();
+        limiter.AddRule("POST / ", 1e6, 1e6);
+        limiter.AddRule("GET /images/", 1e6, 1e6);
+    }
+    stop.store(true);
+    checker.join();
+    EXPECT_TRUE(limiter.HasRequestRules());
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <string>
+#include <thread>
+#include "glog/logging.h"
+#include "Server/server.hpp"
+
+#ifdef HTTP_HAVE_TLS
+
+#include <openssl/ssl.h>
+#include "../Common/testcert.hpp"
+
+static const int HTTP_PORT = 18330;
+static const int TLS_PORT = 18331;
+
+// 在单独的线程中运行打开了HTTPS端口的WebServer，客户端用阻塞的socket加OpenSSL
+// 不用kTLS，服务端走SSL_read/SSL_write
+class ServerTls_Test : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(cert_.Make());
+        ServerOptions options;
+        options.port = HTTP_PORT;
+        options.tlsPort = TLS_PORT;
+        options.tlsCert = cert_.CertFile();
+        options.tlsKey = cert_.KeyFile();
+        options.tlsKtls = false;
+        options.upgradePath = "";
+        options.openLog = false;
+        options.connPoolNum = 2;
+        options.threadNum = 2;
+        options.maxConnPerIp = 1;
+        options.rate = 1;
+        options.burst = 3;
+        server_.reset(new WebServer(options));
+        loop_ = std::thread([this] { server_->Start(); });
+        ctx_ = SSL_CTX_new(TLS_client_method());
+        ASSERT_NE(ctx_, nullptr);
+    }
+
+    // SetUp中途ASSERT失败时server_或者loop_可能还没有建好
+    void TearDown() override {
+        if (server_) {
+            server_->Stop();
+        }
+        if (loop_.joinable()) {
+            loop_.join();
+        }
+        server_.reset();
+        if (ctx_) {
+            SSL_CTX_free(ctx_);
+        }
+    }
+
+    // 连接HTTPS端口并握手，失败返回nullptr
+    SSL *Connect(int *fd) {
+        *fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct timeval tv = {2, 0};
+        setsockopt(*fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(TLS_PORT);
+        if (connect(*fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            return nullptr;
+        }
+        SSL *ssl = SSL_new(ctx_);
+        SSL_set_fd(ssl, *fd);
+        if (SSL_connect(ssl) != 1) {
+            SSL_free(ssl);
+            return nullptr;
+        }
+        return ssl;
+    }
+
+    // 发送一个kv请求，读回一个完整的回复（按Content-length）
+    static std::string Roundtrip(SSL *ssl, const std::string &body) {
+        std::string req = "POST / HTTP/1.1\r\nConnection: keep-alive\r\nContent-Length: " +
+                          std::to_string(body.size()) + "\r\n\r\n" + body;
+        if (SSL_write(ssl, req.data(), static_cast<int>(req.size())) != static_cast<int>(req.size())) {
+            return "";
+        }
+        std::string resp;
+        char buf[4096];
+        while (true) {
+            size_t headEnd = resp.find("\r\n\r\n");
+            if (headEnd != std::string::npos) {
+                size_t pos = resp.find("Content-length: ");
+                size_t len = pos < headEnd ? strtoul(resp.c_str() + pos + 16, nullptr, 10) : 0;
+                if (resp.size() >= headEnd + 4 + len) {
+                    return resp;
+                }
+            }
+            int n = SSL_read(ssl, buf, sizeof(buf));
+            if (n <= 0) {
+                return resp;
+            }
+            resp.append(buf, n);
+        }
+    }
+
+    TestCert cert_;
+    std::unique_ptr<WebServer> server_;
+    std::thread loop_;
+    SSL_CTX *ctx_ = nullptr;
+};
+
+// 握手之后在同一个连接上发送多个请求，回复都是加密的；令牌用完之后回复429并关闭连接
+TEST_F(ServerTls_Test, test_https_roundtrip) {
+    int fd = -1;
+    SSL *ssl = Connect(&fd);
+    ASSERT_NE(ssl, nullptr);
+    std::string set = Roundtrip(ssl, "set tls 42");
+    EXPECT_EQ(set.compare(0, 15, "HTTP/1.1 200 OK"), 0) << set;
+    std::string get = Roundtrip(ssl, "get tls");
+    EXPECT_NE(get.find("\r\n\r\n42\n"), std::string::npos) << get;
+    std::string big(20000, 'v');
+    EXPECT_EQ(Roundtrip(ssl, "set big " + big).compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    std::string limited = Roundtrip(ssl, "get big");
+    EXPECT_EQ(limited.compare(0, 21, "HTTP/1.1 429 Too Many"), 0) << limited;
+    char c;
+    EXPECT_LE(SSL_read(ssl, &c, 1), 0);
+    SSL_free(ssl);
+    close(fd);
+}
+
+// 同一个IP只允许一个连接：HTTPS端口上多出来的连接在握手之前直接关闭
+TEST_F(ServerTls_Test, test_https_refuse) {
+    int first = -1;
+    SSL *ssl = Connect(&first);
+    ASSERT_NE(ssl, nullptr);
+    int second = -1;
+    SSL *refused = Connect(&second);
+    EXPECT_EQ(refused, nullptr);
+    if (refused) {
+        SSL_free(refused);
+    }
+    close(second);
+    // 第一个连接不受影响
+    std::string get = Roundtrip(ssl, "get none");
+    EXPECT_EQ(get.compare(0, 15, "HTTP/1.1 200 OK"), 0) << get;
+    SSL_free(ssl);
+    close(first);
+}
+
+#endif // HTTP_HAVE_TLS
@@ -1,11 +1,54 @@
 #include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
 #include "glog/logging.h"
 #include "Server/server.hpp"
 
+// 连上本机的port，发送req，读到对方关闭连接为止
+static std::string Roundtrip(int port, const std::string &req) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    std::string resp;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+        write(fd, req.data(), req.size()) == static_cast<ssize_t>(req.size())) {
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0) {
+            resp.append(buf, n);
+        }
+    }
+    close(fd);
+    return resp;
+}
+
+// 主循环放到单独的线程里跑，处理一个kv请求之后用Stop退出
 TEST(Server_Test, test_basic) {
     WebServer server(1316, 3, 60000, false,            /* 端口 ET模式 timeoutMs 优雅退出  */
                      3306, "root", "123456", "yourdb", /* Mysql配置 */
-                     12, 6, true, 1,
+                     12, 6, false, 1,
                      1024); /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
-    server.Start();
+    std::thread loop([&server] { server.Start(); });
+    std::string set = Roundtrip(1316, "POST / HTTP/1.1\r\nContent-Length: 8\r\n\r\nset k 42");
+    std::string get = Roundtrip(1316, "POST / HTTP/1.1\r\nContent-Length: 5\r\n\r\nget k");
+    server.Stop();
+    loop.join();
+    EXPECT_EQ(set.compare(0, 15, "HTTP/1.1 200 OK"), 0) << set;
+    EXPECT_NE(get.find("\r\n\r\n42\n"), std::string::npos) << get;
+}
+
+// Stop可以在其他线程中调用，主循环马上退出
+TEST(Server_Test, test_stop) {
+    WebServer server(18317, 3, 60000, false, 3306, "root", "123456", "yourdb", 2, 2, false, 1, 1024);
+    std::thread loop([&server] { server.Start(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto start = std::chrono::steady_clock::now();
+    server.Stop();
+    loop.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
 }
@@ -1,8 +1,32 @@
 #include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <filesystem>
 #include "glog/logging.h"
 #include "SkipList/kvstore.hpp"
 using namespace std;
 
 TEST(SkipList_Test, test_new) {
     
-}
\ No newline at end of file
+}
+// Dump之后Load回来，已经存在的key保留现在的值
+// STORE_FILE是相对路径，在临时目录中运行，不碰当前目录下真正的转储文件
+TEST(SkipList_Test, test_dump_load) {
+    char dir[] = "/tmp/skiplist_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    std::filesystem::path cwd = std::filesystem::current_path();
+    std::filesystem::current_path(dir);
+    KvStore old;
+    old.set("a", "1");
+    old.set("b", "2");
+    old.set("c:d", "3:4");
+    EXPECT_TRUE(old.Dump());
+    KvStore fresh;
+    fresh.set("b", "new");
+    fresh.Load();
+    std::filesystem::current_path(cwd);
+    std::filesystem::remove_all(dir);
+    EXPECT_EQ(fresh.get("a"), "1");
+    EXPECT_EQ(fresh.get("b"), "new");
+    EXPECT_EQ(fresh.get("c:d"), "3:4");
+}
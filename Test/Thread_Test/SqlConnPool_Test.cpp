@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "glog/logging.h"
+#include <chrono>
 #include "Pool/sqlconnRALL.hpp"
 
 int sqlPort = 3306;
@@ -12,6 +13,26 @@ int connPoolNum = 12;
 TEST(SqlConnPool_Test, test_basic) {
 
     SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
-    MYSQL **sqlconn;
-    SqlConnRAII sCR(sqlconn, SqlConnPool::Instance());
+    MYSQL *sqlconn = nullptr;
+    SqlConnRAII sCR(&sqlconn, SqlConnPool::Instance());
+}
+
+// 数据库连不上时GetConn不会排队等待，而是马上失败，由后台线程重试
+TEST(SqlConnPool_Test, test_fail_fast) {
+    SqlConnPool *pool = SqlConnPool::Instance();
+    pool->ClosePool();
+    pool->Init("127.0.0.1", 1, sqlUser, sqlPwd, dbName, 2, 0, 2000);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(pool->GetConn(), nullptr);
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1500));
+    SqlConnPool::Stats stats = pool->GetStats();
+    EXPECT_EQ(stats.gets, 4u);
+    EXPECT_EQ(stats.failFast, 4u);
+    EXPECT_EQ(stats.waits, 0u);
+    EXPECT_GE(stats.connectErrors, 1u);
+    EXPECT_EQ(stats.size, 0);
+    pool->ClosePool();
+    EXPECT_EQ(pool->GetConn(0), nullptr);
 }
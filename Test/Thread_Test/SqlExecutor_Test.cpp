@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <future>
+#include <thread>
+#include "glog/logging.h"
+#include "Pool/sqlexecutor.hpp"
+#include "Pool/sqlbatchinserter.hpp"
+
+// 任务在DB线程中执行，调用者不会被阻塞，完成之后由任务自己通知
+TEST(SqlExecutor_Test, test_submit) {
+    SqlExecutor::Instance()->Init(2);
+    const int N = 8;
+    std::vector<std::promise<std::thread::id>> done(N);
+    for (int i = 0; i < N; i++) {
+        SqlExecutor::Instance()->Submit([&done, i](MYSQL *) {
+            done[i].set_value(std::this_thread::get_id());
+        });
+    }
+    for (int i = 0; i < N; i++) {
+        auto future = done[i].get_future();
+        ASSERT_EQ(future.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+        EXPECT_NE(future.get(), std::this_thread::get_id());
+    }
+    // pending_在任务返回之后才减少，等一下
+    for (int i = 0; i < 100 && SqlExecutor::Instance()->Pending() > 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(SqlExecutor::Instance()->Pending(), 0);
+}
+
+// 超过maxRows的行会分成几批，拿不到连接时每一行都收到一次失败；析构时不用等窗口结束
+TEST(SqlExecutor_Test, test_batch_inserter) {
+    const int N = 10;
+    std::atomic<int> calls(0), failed(0);
+    auto start = std::chrono::steady_clock::now();
+    {
+        SqlBatchInserter inserter("user", {"username", "password"}, 4, 1000);
+        for (int i = 0; i < N; i++) {
+            inserter.Add({"name" + std::to_string(i), "pwd"}, [&](bool ok) {
+                calls++;
+                failed += !ok;
+            });
+        }
+    }
+    for (int i = 0; i < 1000 && calls < N; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(calls, N);
+    EXPECT_EQ(failed, N);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(900));
+}
+
+// 插入之前逐行检查，没通过的行直接失败，每一行都只回调一次
+TEST(SqlExecutor_Test, test_batch_inserter_check) {
+    const int N = 6;
+    std::atomic<int> calls(0), checked(0), rejected(0);
+    {
+        SqlBatchInserter inserter("user", {"username", "password"}, 4, 1,
+                                  [&](MYSQL *, const SqlBatchInserter::Row &row) {
+                                      checked++;
+                                      return row[0] != "dup";
+                                  });
+        for (int i = 0; i < N; i++) {
+            std::string name = i % 2 ? "dup" : "name" + std::to_string(i);
+            inserter.Add({name, "pwd"}, [&, name](bool ok) {
+                calls++;
+                rejected += (name == "dup" && !ok);
+            });
+        }
+    }
+    for (int i = 0; i < 1000 && calls < N; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(calls, N);
+    EXPECT_EQ(checked, N);
+    EXPECT_EQ(rejected, N / 2);
+}
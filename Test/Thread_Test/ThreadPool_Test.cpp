@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include "glog/logging.h"
 #include "Pool/threadpool.hpp"
+#include <atomic>
+#include <chrono>
 // #include <Thread/test1.hpp>
 
 // 测试基本功能，四种函数类型
@@ -25,3 +27,86 @@ TEST(ThreadPool_Test, test_basic) {
     void (*functionPointer)() = [] { std::cout << "Task 4 from function pointer" << std::endl; };
     myThreadPool.AddTask(functionPointer);
 }
+
+// 一整个interval中最短的排队时间超过target才算过载，队列空了马上恢复
+TEST(ThreadPool_Test, test_codel) {
+    const int64_t MS = 1000000;
+    CoDel codel(1 * MS, 10 * MS);
+    codel.OnDequeue(2 * MS, 0);
+    codel.OnDequeue(3 * MS, 5 * MS);
+    EXPECT_FALSE(codel.Overloaded());
+    codel.OnDequeue(2 * MS, 10 * MS);
+    EXPECT_TRUE(codel.Overloaded());
+    // 这个interval中有一次排队很短，说明积压消掉了
+    codel.OnDequeue(MS / 2, 15 * MS);
+    codel.OnDequeue(2 * MS, 20 * MS);
+    EXPECT_FALSE(codel.Overloaded());
+    codel.OnDequeue(2 * MS, 25 * MS);
+    codel.OnDequeue(2 * MS, 30 * MS);
+    EXPECT_TRUE(codel.Overloaded());
+    codel.OnIdle();
+    EXPECT_FALSE(codel.Overloaded());
+    // target为0时关闭
+    codel.SetTarget(0, 10 * MS);
+    codel.OnDequeue(100 * MS, 40 * MS);
+    codel.OnDequeue(100 * MS, 50 * MS);
+    EXPECT_FALSE(codel.Overloaded());
+}
+
+// 一个线程处理慢任务，积压之后ShouldShed，处理完之后恢复
+TEST(ThreadPool_Test, test_should_shed) {
+    ThreadPool pool(1);
+    pool.SetQueueTarget(1, 10);
+    EXPECT_FALSE(pool.ShouldShed());
+    std::atomic<int> done(0);
+    for (int i = 0; i < 30; i++) {
+        pool.AddTask([&done] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(3));
+            done++;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    EXPECT_TRUE(pool.ShouldShed());
+    while (done.load() < 30) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_FALSE(pool.ShouldShed());
+    EXPECT_EQ(pool.QueueSize(), 0u);
+}
+
+// 运行时调整线程数，调小之后多出来的线程退出，任务照常执行完
+TEST(ThreadPool_Test, test_resize) {
+    ThreadPool pool(2);
+    std::atomic<int> running(0);
+    std::atomic<int> maxRunning(0);
+    std::atomic<int> done(0);
+    auto task = [&] {
+        int now = ++running;
+        int prev = maxRunning.load();
+        while (now > prev && !maxRunning.compare_exchange_weak(prev, now)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        running--;
+        done++;
+    };
+    pool.Resize(4);
+    EXPECT_EQ(pool.ThreadCount(), 4u);
+    for (int i = 0; i < 8; i++) {
+        pool.AddTask(task);
+    }
+    while (done.load() < 8) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(maxRunning.load(), 4);
+
+    pool.Resize(1);
+    maxRunning = 0;
+    for (int i = 0; i < 4; i++) {
+        pool.AddTask(task);
+    }
+    while (done.load() < 12) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(maxRunning.load(), 1);
+}
@@ -14,3 +14,19 @@ TEST(HeapTimer_Test, test_basic) {
     sleep(3);
     ht.tick();
 }
+
+// 超时时间递减地加入，每个新节点都要上移到堆顶
+TEST(HeapTimer_Test, test_order) {
+    HeapTimer ht;
+    std::vector<int> fired;
+    for (int i = 0; i < 100; i++) {
+        ht.add(i, 1000 - i * 10, [&fired, i] { fired.push_back(i); });
+    }
+    // 把一个定时器调整得更早，它也要回到堆顶
+    ht.adjust(0, 0);
+    int next = ht.GetNextTick();
+    EXPECT_EQ(fired.size(), 1u);
+    EXPECT_EQ(fired[0], 0);
+    EXPECT_GT(next, 0);
+    EXPECT_LE(next, 1000 - 99 * 10);
+}
@@ -48,6 +48,8 @@ public:
 
     int GetNextTick();
 
+    size_t size() const { return heap_.size(); }
+
 private:
     void del_(size_t i);
     
@@ -1,16 +1,15 @@
 #include "Timer/heaptimer.hpp"
 
-// 当前节点上移，父节点是(i-1)/2
+// 当前节点上移，父节点是(i-1)/2，到了堆顶（i为0）就停止
 void HeapTimer::siftup_(size_t i) {
     assert(i >= 0 && i < heap_.size());
-    size_t j = (i - 1) / 2;
-    while (j >= 0) {
+    while (i > 0) {
+        size_t j = (i - 1) / 2;
         if (heap_[j] < heap_[i]) {
             break;
         }
         SwapNode_(i, j);
         i = j;
-        j = (i - 1) / 2;
     }
 }
 
@@ -93,12 +92,14 @@ void HeapTimer::del_(size_t index) {
     heap_.pop_back();
 }
 
-// 调整节点的超时时间
+// 调整节点的超时时间，新的时间可能更早，下移不动时再尝试上移
 void HeapTimer::adjust(int id, int timeout) {
     assert(!heap_.empty() && ref_.count(id) > 0);
-    heap_[ref_[id]].expires = Clock::now() + MS(timeout);
-    ;
-    siftdown_(ref_[id], heap_.size());
+    size_t i = ref_[id];
+    heap_[i].expires = Clock::now() + MS(timeout);
+    if (!siftdown_(i, heap_.size())) {
+        siftup_(i);
+    }
 }
 
 // 尝试执行超时事务
@@ -131,7 +132,7 @@ void HeapTimer::clear() {
 // 执行一个定时器事务，并且判断下一次需要执行tick需要等待多久
 int HeapTimer::GetNextTick() {
     tick();
-    size_t res = -1;
+    int64_t res = -1;
     if (!heap_.empty()) {
         res = std::chrono::duration_cast<MS>(heap_.front().expires - Clock::now()).count();
         if (res < 0) {
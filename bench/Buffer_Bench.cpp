@@ -0,0 +1,180 @@
+#include <benchmark/benchmark.h>
+#include <unistd.h>
+#include <vector>
+#include "Buffer/buffer.hpp"
+#include "Buffer/chainbuffer.hpp"
+#include "Http/httprequest.hpp"
+
+static const std::string kRequest = "GET /index.html HTTP/1.1\r\n"
+                                    "Host: localhost:1316\r\n"
+                                    "User-Agent: curl/7.88.1\r\n"
+                                    "Accept: */*\r\n"
+                                    "Connection: keep-alive\r\n"
+                                    "\r\n";
+
+// 解析器循环中的Buffer操作：Append、Peek、RetrieveUntil、ReadableBytes
+static void BM_BufferLineScan(benchmark::State &state) {
+    Buffer buff;
+    const char CRLF[] = "\r\n";
+    for (auto _ : state) {
+        buff.Append(kRequest);
+        while (buff.ReadableBytes()) {
+            const char *lineEnd = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
+            benchmark::DoNotOptimize(lineEnd);
+            buff.RetrieveUntil(lineEnd + 2);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * kRequest.size());
+}
+BENCHMARK(BM_BufferLineScan);
+
+// 完整的HttpRequest::parse
+static void BM_HttpRequestParse(benchmark::State &state) {
+    HttpRequest request(std::make_shared<KvStore>());
+    ChainBuffer buff;
+    for (auto _ : state) {
+        buff.Append(kRequest);
+        request.Init();
+        benchmark::DoNotOptimize(request.parse(buff));
+        buff.RetrieveAll();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HttpRequestParse);
+
+// 抓包得到的几类请求：浏览器的GET、表单登录、KV请求
+static const std::vector<std::pair<std::string, std::string>> kCorpus = {
+    {"browser",
+     "GET /picture.html HTTP/1.1\r\n"
+     "Host: 192.168.1.20:1316\r\n"
+     "Connection: keep-alive\r\n"
+     "Cache-Control: max-age=0\r\n"
+     "Upgrade-Insecure-Requests: 1\r\n"
+     "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) "
+     "Chrome/120.0.0.0 Safari/537.36\r\n"
+     "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,"
+     "image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+     "Referer: http://192.168.1.20:1316/\r\n"
+     "Accept-Encoding: gzip, deflate\r\n"
+     "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+     "\r\n"},
+    {"login",
+     "POST /login HTTP/1.1\r\n"
+     "Host: 192.168.1.20:1316\r\n"
+     "Connection: keep-alive\r\n"
+     "Content-Length: 29\r\n"
+     "Origin: http://192.168.1.20:1316\r\n"
+     "Content-Type: application/x-www-form-urlencoded\r\n"
+     "Referer: http://192.168.1.20:1316/login.html\r\n"
+     "\r\n"
+     "username=alice&password=12345"},
+    {"kv",
+     "POST / HTTP/1.1\r\n"
+     "Host: 127.0.0.1:1316\r\n"
+     "User-Agent: curl/7.88.1\r\n"
+     "Accept: */*\r\n"
+     "Content-Length: 17\r\n"
+     "Content-Type: text/plain\r\n"
+     "\r\n"
+     "set key42 value42"},
+};
+
+static void BM_HttpRequestParseCorpus(benchmark::State &state) {
+    const auto &item = kCorpus[state.range(0)];
+    state.SetLabel(item.first);
+    HttpRequest request(std::make_shared<KvStore>());
+    ChainBuffer buff;
+    for (auto _ : state) {
+        buff.Append(item.second);
+        request.Init();
+        benchmark::DoNotOptimize(request.parse(buff));
+        buff.RetrieveAll();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * item.second.size());
+}
+BENCHMARK(BM_HttpRequestParseCorpus)->DenseRange(0, 2);
+
+// Append不同大小的数据再取走，缓冲区不需要扩容
+static void BM_BufferAppend(benchmark::State &state) {
+    std::string data(state.range(0), 'x');
+    Buffer buff;
+    for (auto _ : state) {
+        buff.Append(data);
+        buff.RetrieveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_BufferAppend)->RangeMultiplier(16)->Range(16, 65536);
+
+// 前面已经读走的空间够用，MakeSpace_把未读的数据挪到开头
+static void BM_BufferMakeSpaceMove(benchmark::State &state) {
+    std::string data(800, 'x');
+    Buffer buff(1024);
+    for (auto _ : state) {
+        buff.Append(data);
+        buff.Retrieve(700);
+        buff.Append(data);
+        buff.RetrieveAll();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BufferMakeSpaceMove);
+
+// 空间不够，MakeSpace_扩容（每次都从一个空的Buffer开始）
+static void BM_BufferMakeSpaceGrow(benchmark::State &state) {
+    std::string data(state.range(0), 'x');
+    for (auto _ : state) {
+        Buffer buff(0);
+        for (int i = 0; i < 8; i++) {
+            buff.Append(data);
+        }
+        benchmark::DoNotOptimize(buff.Peek());
+    }
+    state.SetBytesProcessed(state.iterations() * data.size() * 8);
+}
+BENCHMARK(BM_BufferMakeSpaceGrow)->Arg(512)->Arg(8192);
+
+// 从管道中ReadFd，每次迭代先写入再读出，包括write的时间
+static void BM_BufferReadFd(benchmark::State &state) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        state.SkipWithError("pipe failed");
+        return;
+    }
+    std::string data(state.range(0), 'x');
+    Buffer buff;
+    int err = 0;
+    for (auto _ : state) {
+        ssize_t n = write(fds[1], data.data(), data.size());
+        benchmark::DoNotOptimize(n);
+        benchmark::DoNotOptimize(buff.ReadFd(fds[0], &err));
+        buff.RetrieveAll();
+    }
+    close(fds[0]);
+    close(fds[1]);
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_BufferReadFd)->Arg(128)->Arg(4096)->Arg(60000);
+
+// 同样的读法换成ChainBuffer：直接读进缓冲块，空闲块每个线程留一批，不用每次都向池里取
+static void BM_ChainBufferReadFd(benchmark::State &state) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        state.SkipWithError("pipe failed");
+        return;
+    }
+    std::string data(state.range(0), 'x');
+    ChainBuffer buff;
+    int err = 0;
+    for (auto _ : state) {
+        ssize_t n = write(fds[1], data.data(), data.size());
+        benchmark::DoNotOptimize(n);
+        benchmark::DoNotOptimize(buff.ReadFd(fds[0], &err));
+        buff.RetrieveAll();
+    }
+    close(fds[0]);
+    close(fds[1]);
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_ChainBufferReadFd)->Arg(128)->Arg(4096)->Arg(60000);
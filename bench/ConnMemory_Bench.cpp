@@ -0,0 +1,43 @@
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+#include <memory>
+#include <vector>
+#include "Http/httpconn.hpp"
+
+/*
+空闲连接的内存占用：创建N个HttpConn，统计进程RSS的增长
+结果中rss_kb是增长的总量，bytes_per_conn是平均每个连接的占用
+缓冲块从BufferPool懒加载之后，空闲连接不应该持有任何缓冲块
+*/
+static long RssKb() {
+    long pages = 0, rss = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (!fp) {
+        return 0;
+    }
+    if (fscanf(fp, "%ld %ld", &pages, &rss) != 2) {
+        rss = 0;
+    }
+    fclose(fp);
+    return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// 参数：连接数
+static void BM_IdleConnRss(benchmark::State &state) {
+    auto kv = std::make_shared<KvStore>();
+    const int n = static_cast<int>(state.range(0));
+    long grown = 0;
+    for (auto _ : state) {
+        std::vector<std::unique_ptr<HttpConn>> conns;
+        conns.reserve(n);
+        long before = RssKb();
+        for (int i = 0; i < n; i++) {
+            conns.emplace_back(new HttpConn(kv));
+        }
+        grown = RssKb() - before;
+        benchmark::DoNotOptimize(conns.data());
+    }
+    state.counters["rss_kb"] = static_cast<double>(grown);
+    state.counters["bytes_per_conn"] = grown * 1024.0 / n;
+}
+BENCHMARK(BM_IdleConnRss)->Arg(1000)->Arg(10000)->Arg(100000)->Iterations(1)->Unit(benchmark::kMillisecond);
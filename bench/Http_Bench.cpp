@@ -0,0 +1,96 @@
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+#include <thread>
+#include "loadgen.hpp"
+#include "Server/server.hpp"
+
+/*
+端到端的HTTP压测：进程内启动一个WebServer，用LoadGen从回环地址压测
+每个用例只跑一次，持续时间默认2秒，可以用环境变量HTTP_BENCH_MS修改
+结果中rps是每秒完成的请求数，p50/p99/p999是延迟的分位数（微秒）
+静态页面的目录和myServer一样是 当前目录的上一级/resources，需要在build目录中运行
+*/
+static const int PORT = 18316;
+
+// 所有用例共用一个服务器，第一次用到时启动，进程退出时停止
+class BenchServer {
+public:
+    static BenchServer &Instance() {
+        static BenchServer server;
+        return server;
+    }
+
+private:
+    BenchServer()
+        : server_(PORT, 3, 60000, false,             /* 端口 ET模式 timeoutMs 优雅退出  */
+                  3306, "root", "123456", "yourdb", /* Mysql配置 */
+                  4, 4, false, 1, 1024),            /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+          thread_([this] { server_.Start(); }) {}
+
+    ~BenchServer() {
+        server_.Stop();
+        thread_.join();
+    }
+
+    WebServer server_;
+    std::thread thread_;
+};
+
+static std::vector<std::string> MakeMix(bool kv, bool keepAlive) {
+    std::vector<std::string> requests;
+    if (!kv) {
+        requests.push_back(LoadGen::MakeRequest("/index.html", "", keepAlive));
+        return requests;
+    }
+    // 一半set一半get，键在一个小范围内循环
+    for (int i = 0; i < 64; i++) {
+        std::string key = "key" + std::to_string(i);
+        requests.push_back(LoadGen::MakeRequest("/", "set " + key + " value" + std::to_string(i),
+                                                keepAlive));
+        requests.push_back(LoadGen::MakeRequest("/", "get " + key, keepAlive));
+    }
+    return requests;
+}
+
+// 参数：连接数，流水线深度，是否长连接，是否KV请求，开环的请求速率（0为闭环）
+static void BM_Http(benchmark::State &state) {
+    BenchServer::Instance();
+    LoadGenConfig config;
+    config.port = PORT;
+    config.connections = static_cast<int>(state.range(0));
+    config.pipeline = static_cast<int>(state.range(1));
+    config.keepAlive = state.range(2) != 0;
+    config.requests = MakeMix(state.range(3) != 0, config.keepAlive);
+    config.rate = static_cast<double>(state.range(4));
+    config.threads = std::min(2, config.connections);
+    const char *ms = getenv("HTTP_BENCH_MS");
+    config.duration = std::chrono::milliseconds(ms ? atoi(ms) : 2000);
+
+    LoadGenResult result;
+    for (auto _ : state) {
+        result = LoadGen(config).Run();
+        state.SetIterationTime(result.seconds);
+    }
+    state.SetItemsProcessed(result.requests);
+    state.counters["rps"] = result.Rps();
+    state.counters["errors"] = static_cast<double>(result.errors);
+    state.counters["p50_us"] = result.latency.Percentile(0.5) / 1000.0;
+    state.counters["p99_us"] = result.latency.Percentile(0.99) / 1000.0;
+    state.counters["p999_us"] = result.latency.Percentile(0.999) / 1000.0;
+    state.counters["max_us"] = result.latency.Max() / 1000.0;
+}
+BENCHMARK(BM_Http)
+    ->ArgNames({"conns", "pipeline", "keepalive", "kv", "rate"})
+    // 闭环：长连接/短连接，静态页面/KV
+    ->Args({32, 1, 1, 0, 0})
+    ->Args({32, 1, 1, 1, 0})
+    ->Args({32, 1, 0, 0, 0})
+    ->Args({32, 1, 0, 1, 0})
+    // 闭环：流水线
+    ->Args({32, 8, 1, 1, 0})
+    // 开环：固定速率下的延迟
+    ->Args({32, 1, 1, 1, 1000})
+    ->Args({32, 1, 1, 1, 5000})
+    ->Iterations(1)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
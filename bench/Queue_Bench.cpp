@@ -0,0 +1,142 @@
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "Log/blockqueue.hpp"
+#include "Log/lockfreequeue.hpp"
+
+// 每次迭代由state.range(0)个生产者一共交给一个消费者ITEMS个数据，统计每秒传递的数据量
+static const int ITEMS = 100000;
+static const size_t CAPACITY = 1024;
+
+template <class Push, class Pop>
+static void RunTransfer(benchmark::State &state, Push push, Pop pop) {
+    int producers = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; p++) {
+            threads.emplace_back([&, p] {
+                for (int i = p; i < ITEMS; i += producers) {
+                    push(i);
+                }
+            });
+        }
+        long long sum = 0;
+        for (int n = 0; n < ITEMS;) {
+            n += pop(sum);
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * ITEMS);
+}
+
+static void BM_BlockDeque(benchmark::State &state) {
+    BlockDeque<int> queue(CAPACITY);
+    RunTransfer(
+        state, [&](int v) { queue.push_back(v); },
+        [&](long long &sum) {
+            int v = 0;
+            queue.pop(v);
+            sum += v;
+            return 1;
+        });
+}
+BENCHMARK(BM_BlockDeque)->Arg(1)->Arg(4)->UseRealTime();
+
+// 多个生产者和同样多的消费者同时竞争BlockDeque的锁
+static void BM_BlockDequeMpmc(benchmark::State &state) {
+    int threads = static_cast<int>(state.range(0));
+    BlockDeque<int> queue(CAPACITY);
+    for (auto _ : state) {
+        std::vector<std::thread> workers;
+        std::atomic<long long> sum(0);
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                for (int i = t; i < ITEMS; i += threads) {
+                    queue.push_back(i);
+                }
+            });
+            workers.emplace_back([&, t] {
+                long long local = 0;
+                int v = 0;
+                for (int i = t; i < ITEMS; i += threads) {
+                    queue.pop(v);
+                    local += v;
+                }
+                sum += local;
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        benchmark::DoNotOptimize(sum.load());
+    }
+    state.SetItemsProcessed(state.iterations() * ITEMS);
+}
+BENCHMARK(BM_BlockDequeMpmc)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+static void BM_SpscQueue(benchmark::State &state) {
+    SpscQueue<int> queue(CAPACITY);
+    RunTransfer(
+        state,
+        [&](int v) {
+            while (!queue.TryPush(v)) {
+                std::this_thread::yield();
+            }
+        },
+        [&](long long &sum) {
+            int n = static_cast<int>(queue.PopBatch([&](int &v) { sum += v; }, 64));
+            if (n == 0) {
+                std::this_thread::yield();
+            }
+            return n;
+        });
+}
+BENCHMARK(BM_SpscQueue)->Arg(1)->UseRealTime();
+
+static void BM_MpscQueue(benchmark::State &state) {
+    MpscQueue<int> queue(CAPACITY);
+    RunTransfer(
+        state,
+        [&](int v) {
+            while (!queue.TryPush(v)) {
+                std::this_thread::yield();
+            }
+        },
+        [&](long long &sum) {
+            int n = static_cast<int>(queue.PopBatch([&](int &v) { sum += v; }, 64));
+            if (n == 0) {
+                std::this_thread::yield();
+            }
+            return n;
+        });
+}
+BENCHMARK(BM_MpscQueue)->Arg(1)->Arg(4)->UseRealTime();
+
+// 带eventfd通知的MpscQueue，消费者没有数据时睡眠，对应Epoller的用法
+static void BM_MpscQueueNotify(benchmark::State &state) {
+    MpscQueue<int> queue(CAPACITY);
+    QueueNotifier notifier;
+    RunTransfer(
+        state,
+        [&](int v) {
+            while (!queue.TryPush(v)) {
+                std::this_thread::yield();
+            }
+            notifier.Notify();
+        },
+        [&](long long &sum) {
+            int n = static_cast<int>(queue.PopBatch([&](int &v) { sum += v; }, 64));
+            if (n == 0) {
+                notifier.Arm();
+                if (queue.Empty()) {
+                    notifier.Wait(1);
+                }
+            }
+            return n;
+        });
+}
+BENCHMARK(BM_MpscQueueNotify)->Arg(1)->Arg(4)->UseRealTime();
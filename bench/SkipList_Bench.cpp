@@ -0,0 +1,116 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include "SkipList/newskiplist.hpp"
+#include "SkipList/kvstore.hpp"
+
+// 表的大小从1K到10M，最大层数按log2(10M)取24；KvStore是服务器实际使用的配置（字符串键，最大层数5）
+static const int MAX_LEVEL = 24;
+
+// 值的类型只能是字符串（get_element找不到时返回"None"），和KvStore一样
+// 预先插入0..n-1的随机排列，同样大小的表在不同的用例之间复用
+static SkipList<int, std::string> &FilledList(int n) {
+    static std::map<int, std::unique_ptr<SkipList<int, std::string>>> lists;
+    auto &list = lists[n];
+    if (!list) {
+        list.reset(new SkipList<int, std::string>(MAX_LEVEL));
+        std::vector<int> keys(n);
+        for (int i = 0; i < n; i++) {
+            keys[i] = i;
+        }
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(n));
+        for (int key : keys) {
+            list->insert_element(key, "value");
+        }
+    }
+    return *list;
+}
+
+// 一次计时插入/删除BATCH个键，再在计时之外恢复原样，PauseTiming/ResumeTiming的开销分摊到每个键上可以忽略
+// 同一批的键取 (起点 + i * STRIDE) % n，STRIDE和10的幂互质，所以互不相同且分散在整个表里
+static const int BATCH = 256;
+static const int STRIDE = 7919;
+
+static void BatchKeys(std::mt19937 &rng, int n, int base, int *keys) {
+    int start = static_cast<int>(rng() % n);
+    for (int i = 0; i < BATCH; i++) {
+        keys[i] = base + static_cast<int>((start + static_cast<long long>(i) * STRIDE) % n);
+    }
+}
+
+// 表中已经有n个键，插入新的键（插入之后再删掉，表的大小不变）
+static void BM_SkipListInsert(benchmark::State &state) {
+    int n = static_cast<int>(state.range(0));
+    SkipList<int, std::string> &list = FilledList(n);
+    std::mt19937 rng(1);
+    int keys[BATCH];
+    BatchKeys(rng, n, n, keys);
+    for (auto _ : state) {
+        for (int key : keys) {
+            benchmark::DoNotOptimize(list.insert_element(key, "value"));
+        }
+        state.PauseTiming();
+        for (int key : keys) {
+            list.delete_element(key);
+        }
+        BatchKeys(rng, n, n, keys);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+static void BM_SkipListGet(benchmark::State &state) {
+    int n = static_cast<int>(state.range(0));
+    SkipList<int, std::string> &list = FilledList(n);
+    std::mt19937 rng(2);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(list.get_element(static_cast<int>(rng() % n)));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// 删除已有的键（删除之后再插回去，表的大小不变）
+static void BM_SkipListDelete(benchmark::State &state) {
+    int n = static_cast<int>(state.range(0));
+    SkipList<int, std::string> &list = FilledList(n);
+    std::mt19937 rng(3);
+    int keys[BATCH];
+    BatchKeys(rng, n, 0, keys);
+    for (auto _ : state) {
+        for (int key : keys) {
+            list.delete_element(key);
+        }
+        state.PauseTiming();
+        for (int key : keys) {
+            list.insert_element(key, "value");
+        }
+        BatchKeys(rng, n, 0, keys);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+BENCHMARK(BM_SkipListInsert)->RangeMultiplier(10)->Range(1000, 10000000);
+BENCHMARK(BM_SkipListGet)->RangeMultiplier(10)->Range(1000, 10000000);
+BENCHMARK(BM_SkipListDelete)->RangeMultiplier(10)->Range(1000, 10000000);
+
+// 服务器中的KV操作：先放入n个键，再随机set/get
+static void BM_KvStoreSetGet(benchmark::State &state) {
+    int n = static_cast<int>(state.range(0));
+    KvStore kv;
+    for (int i = 0; i < n; i++) {
+        kv.set("key" + std::to_string(i), "value");
+    }
+    std::mt19937 rng(4);
+    for (auto _ : state) {
+        std::string key = "key" + std::to_string(rng() % n);
+        if (rng() & 1) {
+            benchmark::DoNotOptimize(kv.set(key, "value"));
+        } else {
+            benchmark::DoNotOptimize(kv.get(key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_KvStoreSetGet)->RangeMultiplier(10)->Range(1000, 100000);
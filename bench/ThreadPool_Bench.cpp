@@ -0,0 +1,38 @@
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "Pool/threadpool.hpp"
+
+// 从AddTask到任务开始执行的延迟：每次只投递一个任务，等它执行之后再投递下一个
+static void BM_ThreadPoolDispatch(benchmark::State &state) {
+    ThreadPool pool(static_cast<size_t>(state.range(0)));
+    std::atomic<bool> done(false);
+    for (auto _ : state) {
+        done.store(false, std::memory_order_relaxed);
+        pool.AddTask([&done] { done.store(true, std::memory_order_release); });
+        while (!done.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadPoolDispatch)->Arg(1)->Arg(4)->UseRealTime();
+
+// 吞吐：一次投递TASKS个空任务，等全部执行完
+static void BM_ThreadPoolThroughput(benchmark::State &state) {
+    static const int TASKS = 10000;
+    ThreadPool pool(static_cast<size_t>(state.range(0)));
+    std::atomic<int> remaining(0);
+    for (auto _ : state) {
+        remaining.store(TASKS, std::memory_order_relaxed);
+        for (int i = 0; i < TASKS; i++) {
+            pool.AddTask([&remaining] { remaining.fetch_sub(1, std::memory_order_release); });
+        }
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * TASKS);
+}
+BENCHMARK(BM_ThreadPoolThroughput)->Arg(1)->Arg(4)->UseRealTime();
@@ -0,0 +1,53 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include "Timer/heaptimer.hpp"
+
+// 每次迭代加入n个定时器（id随机排列，超时时间随机），统计每个add的时间
+static void BM_HeapTimerAdd(benchmark::State &state) {
+    int n = static_cast<int>(state.range(0));
+    std::mt19937 rng(1);
+    HeapTimer timer;
+    for (auto _ : state) {
+        for (int i = 0; i < n; i++) {
+            timer.add(i, 60000 + static_cast<int>(rng() % 60000), [] {});
+        }
+        state.PauseTiming();
+        timer.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_HeapTimerAdd)->RangeMultiplier(10)->Range(100, 100000);
+
+// 堆中有n个定时器，随机挑一个延长超时时间，对应连接收到数据时的ExtentTime_
+static void BM_HeapTimerAdjust(benchmark::State &state) {
+    int n = static_cast<int>(state.range(0));
+    std::mt19937 rng(2);
+    HeapTimer timer;
+    for (int i = 0; i < n; i++) {
+        timer.add(i, 60000 + static_cast<int>(rng() % 60000), [] {});
+    }
+    for (auto _ : state) {
+        timer.adjust(static_cast<int>(rng() % n), 60000 + static_cast<int>(rng() % 60000));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HeapTimerAdjust)->RangeMultiplier(10)->Range(100, 100000);
+
+// 堆中有n个已经超时的定时器，一次tick全部取出并执行回调
+static void BM_HeapTimerTick(benchmark::State &state) {
+    int n = static_cast<int>(state.range(0));
+    HeapTimer timer;
+    long long fired = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (int i = 0; i < n; i++) {
+            timer.add(i, 0, [&fired] { fired++; });
+        }
+        state.ResumeTiming();
+        timer.tick();
+    }
+    benchmark::DoNotOptimize(fired);
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_HeapTimerTick)->RangeMultiplier(10)->Range(100, 100000);
@@ -0,0 +1,444 @@
+#ifndef BENCH_LOADGEN_H
+#define BENCH_LOADGEN_H
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+/*
+HTTP压测用的负载生成器，只给bench使用
+1. 每个线程有自己的epoll和一组连接，线程之间不共享任何东西，结束之后再合并结果
+2. 闭环：每个连接上保持pipeline个请求在途，收到一个回复就发下一个
+   开环：按固定速率发请求，延迟从“应该发出的时刻”开始算，连接忙的时候请求排队，不会漏掉排队的时间
+3. keepAlive关闭时每个连接只发一个请求，收到回复之后关闭并重新连接
+4. 请求从requests中轮流取，可以混合静态页面和KV请求
+*/
+
+// 对数线性分桶的延迟直方图（纳秒），每个2的幂区间分成32个子桶，相对误差在3%左右
+class LatencyHistogram {
+public:
+    LatencyHistogram() : buckets_(64 * SUB, 0), count_(0), max_(0) {}
+
+    void Record(uint64_t ns) {
+        buckets_[Index_(ns)]++;
+        count_++;
+        max_ = std::max(max_, ns);
+    }
+
+    void Merge(const LatencyHistogram &other) {
+        for (size_t i = 0; i < buckets_.size(); i++) {
+            buckets_[i] += other.buckets_[i];
+        }
+        count_ += other.count_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    // 返回q分位所在桶的上界，q在[0, 1]之间
+    uint64_t Percentile(double q) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(q * count_ + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets_.size(); i++) {
+            seen += buckets_[i];
+            if (seen >= target) {
+                return std::min(max_, Lower_(i + 1) - 1);
+            }
+        }
+        return max_;
+    }
+
+    uint64_t Count() const { return count_; }
+    uint64_t Max() const { return max_; }
+
+private:
+    static const int SUB_BITS = 5;
+    static const uint64_t SUB = 1 << SUB_BITS;
+
+    static size_t Index_(uint64_t v) {
+        if (v < SUB) {
+            return v;
+        }
+        int exp = 63 - __builtin_clzll(v);
+        return (exp - SUB_BITS + 1) * SUB + ((v >> (exp - SUB_BITS)) & (SUB - 1));
+    }
+
+    // 第i个桶的下界
+    static uint64_t Lower_(size_t i) {
+        if (i < SUB) {
+            return i;
+        }
+        size_t group = i / SUB;
+        uint64_t sub = i % SUB;
+        return (SUB + sub) << (group - 1);
+    }
+
+    std::vector<uint64_t> buckets_;
+    uint64_t count_;
+    uint64_t max_;
+};
+
+struct LoadGenConfig {
+    std::string host = "127.0.0.1";
+    int port = 1316;
+    int threads = 2;
+    int connections = 32; // 所有线程的连接总数
+    bool keepAlive = true;
+    int pipeline = 1;     // 每个连接上最多在途的请求数
+    double rate = 0;      // 开环时每秒的请求数（所有线程合计），0表示闭环
+    std::chrono::milliseconds duration{2000};
+    std::vector<std::string> requests;
+};
+
+struct LoadGenResult {
+    uint64_t requests = 0; // 收到200回复的请求
+    uint64_t errors = 0;   // 非200回复、连接失败、连接被关闭时在途的请求
+    double seconds = 0;
+    LatencyHistogram latency;
+
+    double Rps() const { return seconds > 0 ? requests / seconds : 0; }
+};
+
+class LoadGen {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit LoadGen(const LoadGenConfig &config) : config_(config) {}
+
+    LoadGenResult Run() {
+        int threads = std::max(1, config_.threads);
+        std::vector<LoadGenResult> results(threads);
+        std::vector<std::thread> workers;
+        Clock::time_point start = Clock::now();
+        Clock::time_point end = start + config_.duration;
+        for (int i = 0; i < threads; i++) {
+            int conns = config_.connections / threads + (i < config_.connections % threads);
+            workers.emplace_back([this, i, conns, threads, end, &results] {
+                Worker worker(config_, std::max(1, conns), i, threads);
+                worker.Run(end, &results[i]);
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        LoadGenResult total;
+        total.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        for (auto &result : results) {
+            total.requests += result.requests;
+            total.errors += result.errors;
+            total.latency.Merge(result.latency);
+        }
+        return total;
+    }
+
+    // 构造一个请求：body为空时是GET，否则是带Content-Length的POST
+    static std::string MakeRequest(const std::string &path, const std::string &body, bool keepAlive) {
+        std::string req = (body.empty() ? "GET " : "POST ") + path + " HTTP/1.1\r\n";
+        req += "Host: 127.0.0.1\r\n";
+        req += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+        if (!body.empty()) {
+            req += "Content-Type: text/plain\r\n";
+            req += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        }
+        return req + "\r\n" + body;
+    }
+
+private:
+    struct Conn {
+        int fd = -1;
+        bool connected = false;
+        std::string out;
+        size_t outPos = 0;
+        std::string in;
+        std::deque<Clock::time_point> inflight; // 在途请求的开始时间
+    };
+
+    class Worker {
+    public:
+        Worker(const LoadGenConfig &config, int conns, int index, int threads)
+            : config_(config), conns_(conns), next_(index), pipeline_(std::max(1, config.pipeline)),
+              epfd_(epoll_create1(EPOLL_CLOEXEC)) {
+            if (!config_.keepAlive) {
+                pipeline_ = 1;
+            }
+            if (config_.rate > 0) {
+                interval_ = std::chrono::nanoseconds(
+                    static_cast<int64_t>(1e9 * threads / config_.rate));
+            }
+            memset(&addr_, 0, sizeof(addr_));
+            addr_.sin_family = AF_INET;
+            addr_.sin_port = htons(config_.port);
+            inet_pton(AF_INET, config_.host.c_str(), &addr_.sin_addr);
+        }
+
+        ~Worker() {
+            for (auto &conn : conns_) {
+                if (conn.fd >= 0) {
+                    close(conn.fd);
+                }
+            }
+            close(epfd_);
+        }
+
+        void Run(Clock::time_point end, LoadGenResult *result) {
+            result_ = result;
+            for (size_t i = 0; i < conns_.size(); i++) {
+                Open_(i);
+            }
+            Clock::time_point nextSend = Clock::now();
+            epoll_event events[256];
+            while (true) {
+                Clock::time_point now = Clock::now();
+                if (now >= end) {
+                    break;
+                }
+                int timeoutMs = 100;
+                if (OpenLoop_()) {
+                    while (nextSend <= now) {
+                        backlog_.push_back(nextSend);
+                        nextSend += interval_;
+                    }
+                    Dispatch_();
+                    timeoutMs = static_cast<int>(
+                        std::chrono::duration_cast<std::chrono::milliseconds>(nextSend - now).count());
+                }
+                timeoutMs = std::min<int64_t>(
+                    timeoutMs,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(end - now).count() + 1);
+                int n = epoll_wait(epfd_, events, 256, std::max(timeoutMs, 0));
+                for (int i = 0; i < n; i++) {
+                    size_t idx = events[i].data.u64;
+                    if (events[i].events & EPOLLERR) {
+                        Reset_(idx);
+                        continue;
+                    }
+                    if (events[i].events & EPOLLOUT) {
+                        OnWritable_(idx);
+                    }
+                    // 对方关闭时也要先读完已经收到的回复
+                    if ((events[i].events & (EPOLLIN | EPOLLHUP)) && conns_[idx].fd >= 0) {
+                        OnReadable_(idx);
+                    }
+                }
+            }
+        }
+
+    private:
+        bool OpenLoop_() const { return config_.rate > 0; }
+
+        void Open_(size_t idx) {
+            Conn &conn = conns_[idx];
+            conn = Conn();
+            conn.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            int one = 1;
+            setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            int ret = connect(conn.fd, reinterpret_cast<sockaddr *>(&addr_), sizeof(addr_));
+            if (ret < 0 && errno != EINPROGRESS) {
+                result_->errors++;
+                close(conn.fd);
+                conn.fd = -1;
+                return;
+            }
+            epoll_event ev = {};
+            ev.events = EPOLLIN | EPOLLOUT;
+            ev.data.u64 = idx;
+            epoll_ctl(epfd_, EPOLL_CTL_ADD, conn.fd, &ev);
+        }
+
+        // 连接出错或者被对方关闭：在途的请求算作错误，重新连接
+        void Reset_(size_t idx) {
+            Conn &conn = conns_[idx];
+            result_->errors += conn.inflight.size();
+            if (!conn.connected && conn.inflight.empty()) {
+                result_->errors++;
+            }
+            Close_(idx);
+            Open_(idx);
+        }
+
+        void Close_(size_t idx) {
+            Conn &conn = conns_[idx];
+            if (conn.fd >= 0) {
+                epoll_ctl(epfd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+                close(conn.fd);
+                conn.fd = -1;
+            }
+        }
+
+        void SetWriteInterest_(size_t idx, bool on) {
+            epoll_event ev = {};
+            ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+            ev.data.u64 = idx;
+            epoll_ctl(epfd_, EPOLL_CTL_MOD, conns_[idx].fd, &ev);
+        }
+
+        bool HasRoom_(const Conn &conn) const {
+            return conn.fd >= 0 && conn.connected && static_cast<int>(conn.inflight.size()) < pipeline_;
+        }
+
+        void Send_(size_t idx, Clock::time_point start) {
+            Conn &conn = conns_[idx];
+            conn.out += config_.requests[next_++ % config_.requests.size()];
+            conn.inflight.push_back(start);
+            Flush_(idx);
+        }
+
+        void Flush_(size_t idx) {
+            Conn &conn = conns_[idx];
+            while (conn.outPos < conn.out.size()) {
+                ssize_t n = send(conn.fd, conn.out.data() + conn.outPos, conn.out.size() - conn.outPos,
+                                 MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EAGAIN) {
+                        SetWriteInterest_(idx, true);
+                    } else {
+                        Reset_(idx);
+                    }
+                    return;
+                }
+                conn.outPos += n;
+            }
+            conn.out.clear();
+            conn.outPos = 0;
+        }
+
+        // 闭环时把连接上的在途请求补满，开环时从排队的请求中取
+        void Fill_(size_t idx) {
+            if (OpenLoop_()) {
+                Dispatch_();
+                return;
+            }
+            while (HasRoom_(conns_[idx])) {
+                Send_(idx, Clock::now());
+            }
+        }
+
+        void Dispatch_() {
+            for (size_t i = 0; i < conns_.size() && !backlog_.empty(); i++) {
+                while (HasRoom_(conns_[i]) && !backlog_.empty()) {
+                    Clock::time_point start = backlog_.front();
+                    backlog_.pop_front();
+                    Send_(i, start);
+                }
+            }
+        }
+
+        void OnWritable_(size_t idx) {
+            Conn &conn = conns_[idx];
+            if (!conn.connected) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0) {
+                    Reset_(idx);
+                    return;
+                }
+                conn.connected = true;
+                SetWriteInterest_(idx, false);
+                Fill_(idx);
+                return;
+            }
+            SetWriteInterest_(idx, false);
+            Flush_(idx);
+        }
+
+        void OnReadable_(size_t idx) {
+            char buf[16 * 1024];
+            while (true) {
+                Conn &conn = conns_[idx];
+                ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+                if (n > 0) {
+                    conn.in.append(buf, n);
+                    continue;
+                }
+                if (n < 0 && errno == EAGAIN) {
+                    break;
+                }
+                // 对方关闭了连接，先把已经收到的回复处理完
+                if (!Parse_(idx)) {
+                    Reset_(idx);
+                }
+                return;
+            }
+            Parse_(idx);
+        }
+
+        // 从收到的数据中取出完整的回复，按顺序对应在途的请求，返回是否已经换了新的连接
+        bool Parse_(size_t idx) {
+            Conn &conn = conns_[idx];
+            size_t pos = 0;
+            while (!conn.inflight.empty()) {
+                size_t headerEnd = conn.in.find("\r\n\r\n", pos);
+                if (headerEnd == std::string::npos) {
+                    break;
+                }
+                size_t bodyLen = ContentLength_(conn.in, pos, headerEnd);
+                size_t total = headerEnd + 4 + bodyLen;
+                if (conn.in.size() < total) {
+                    break;
+                }
+                bool ok = conn.in.compare(pos, 12, "HTTP/1.1 200") == 0;
+                uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  Clock::now() - conn.inflight.front())
+                                  .count();
+                conn.inflight.pop_front();
+                if (ok) {
+                    result_->requests++;
+                    result_->latency.Record(ns);
+                } else {
+                    result_->errors++;
+                }
+                pos = total;
+            }
+            conn.in.erase(0, pos);
+            if (pos == 0) {
+                return false;
+            }
+            if (!config_.keepAlive) {
+                Close_(idx);
+                Open_(idx);
+                return true;
+            }
+            Fill_(idx);
+            return false;
+        }
+
+        static size_t ContentLength_(const std::string &in, size_t begin, size_t end) {
+            static const char NAME[] = "\r\ncontent-length:";
+            for (size_t i = begin; i + sizeof(NAME) - 1 <= end; i++) {
+                if (strncasecmp(in.data() + i, NAME, sizeof(NAME) - 1) == 0) {
+                    return strtoul(in.data() + i + sizeof(NAME) - 1, nullptr, 10);
+                }
+            }
+            return 0;
+        }
+
+        const LoadGenConfig &config_;
+        std::vector<Conn> conns_;
+        size_t next_;
+        int pipeline_;
+        int epfd_;
+        sockaddr_in addr_;
+        std::chrono::nanoseconds interval_{0};
+        std::deque<Clock::time_point> backlog_; // 开环时已经到了发送时间、还没有发出的请求
+        LoadGenResult *result_ = nullptr;
+    };
+
+    LoadGenConfig config_;
+};
+
+#endif // BENCH_LOADGEN_H
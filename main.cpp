@@ -1,10 +1,19 @@
 #include <iostream>
 #include "Server/server.hpp"
-int main() {
-    WebServer server(1316, 3, 60000, false,            /* 端口 ET模式 timeoutMs 优雅退出  */
-                     3306, "root", "123456", "yourdb", /* Mysql配置 */
-                     12, 6, true, 1,
-                     1024); /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+
+// 用法：myServer [-c server.ini] [--section.key=value ...]，没有指定的参数用ServerOptions中的默认值
+// 运行中修改配置文件之后 kill -HUP 可以重新加载线程数、超时、日志等级、缓存大小和限速
+int main(int argc, char *argv[]) {
+    Config config;
+    ServerOptions options;
+    std::string err;
+    if (!config.ParseArgs(argc, argv, &err) || !config.Load(&err) ||
+        !ServerOptions::FromConfig(config, &options, &err)) {
+        std::cerr << err << std::endl;
+        return 1;
+    }
+    WebServer server(options);
+    server.SetConfig(config);
     server.Start();
     return 0;
-}
\ No newline at end of file
+}